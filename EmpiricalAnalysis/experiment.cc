@@ -1,16 +1,17 @@
 ///////////////////////////////////////////////////////////////////////////////
 // experiment.cc
 //
-// Example code showing how to run an algorithm once and measure its elapsed
-// time precisely. You should modify this program to gather all of your
-// experimental data.
+// Runs each algorithm under the benchmark harness of bench.hh and prints
+// its output with the timing statistics. You should modify this program to
+// gather all of your experimental data. An optional argument names another
+// word list, such as one written by datagen.
 //
 ///////////////////////////////////////////////////////////////////////////////
 
 #include <iostream>
 
+#include "bench.hh"
 #include "project1.hh"
-#include "timer.hh"
 
 using namespace std;
 
@@ -18,11 +19,12 @@ void test_char_mode_alg(int n, const string_vector& words);
 void test_mirrored_alg(int n, const string_vector& words);
 void test_sub_str_trio_alg(int n, const string_vector& words);
 
-int main() {
+int main(int argc, char* argv[]) {
 
+  string path = (argc > 1) ? argv[1] : "words.txt";
   string_vector all_words;
-  if ( ! load_words(all_words, "words.txt") ) {
-    cerr << "error: cannot open \"words.txt\"" << endl;
+  if ( ! load_words(all_words, path) ) {
+    cerr << "error: cannot open \"" << path << "\"" << endl;
     return 1;
   }
   //modify accordingly for each experiment
@@ -34,45 +36,42 @@ int main() {
 
 //testing function for character mode algorithm
 //parameters: n represents number of words to use (input size), words is the collection of all words
-//output: prints given n value, character mode output, and elapsed time to the screen
+//output: prints given n value, character mode output, and timing statistics to the screen
 void test_char_mode_alg(int n, const string_vector& words) {
-  int test_num = n;
   string_vector n_words(words.begin(), words.begin() + n);
-  Timer timer;
   char output = character_mode(n_words);
-  double elapsed = timer.elapsed();
-  cout << "character_mode, "
-       << "n=" << n << ", "
-       << "output=\"" << output << "\", "
-       << "elapsed time=" << elapsed << " seconds" << endl;
+  BenchmarkResult result = benchmark("character_mode, n=" + to_string(n), [&]() {
+    do_not_optimize(character_mode(n_words));
+  });
+  cout << result << ", "
+       << "output=\"" << output << "\""
+       << endl;
 }
 
 //testing function for longest mirrored string algorithm
 //parameters: n represents number of words to use (input size), words is the collection of all words
-//output: prints given n value, longest mirrored string output, and elapsed time to the screen
+//output: prints given n value, longest mirrored string output, and timing statistics to the screen
 void test_mirrored_alg(int n, const string_vector& words) {
-  int test_num = n;
   string_vector n_words(words.begin(), words.begin() + n);
-  Timer timer;
   string output = longest_mirrored_string(n_words);
-  double elapsed = timer.elapsed();
-  cout << "longest_mirrored_string, "
-       << "n=" << n << ", "
-       << "output=\"" << output << "\", "
-       << "elapsed time=" << elapsed << " seconds" << endl;
+  BenchmarkResult result = benchmark("longest_mirrored_string, n=" + to_string(n), [&]() {
+    do_not_optimize(longest_mirrored_string(n_words));
+  });
+  cout << result << ", "
+       << "output=\"" << output << "\""
+       << endl;
 }
 
 //testing function for sub string trio algorithm
 //parameters: n represents number of words to use (input size), words is the collection of all words
-//output: prints given n value, sub string trio output, and elapsed time to the screen
+//output: prints given n value, sub string trio output, and timing statistics to the screen
 void test_sub_str_trio_alg(int n, const string_vector& words) {
-  int test_num = n;
   string_vector n_words(words.begin(), words.begin() + n);
-  Timer timer;
   string_vector output = longest_substring_trio(n_words);
-  double elapsed = timer.elapsed();
-  cout << "longest_substring_trio, "
-       << "n=" << n << ", "
-       << "output=\"" << output[0] << ", " << output[1] << ", " << output[2] << "\", "
-       << "elapsed time=" << elapsed << " seconds" << endl;
+  BenchmarkResult result = benchmark("longest_substring_trio, n=" + to_string(n), [&]() {
+    do_not_optimize(longest_substring_trio(n_words));
+  });
+  cout << result << ", "
+       << "output=\"" << output[0] << ", " << output[1] << ", " << output[2] << "\""
+       << endl;
 }
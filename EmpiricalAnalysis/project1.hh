@@ -14,6 +14,8 @@
 #include <string>
 #include <vector>
 
+#include "trace.hh"
+
 // Convenient typedef for a vector of strings.
 typedef std::vector<std::string> string_vector;
 
@@ -21,6 +23,7 @@ typedef std::vector<std::string> string_vector;
 // cleared, and then each word from the file is added to the
 // vector. Returns true on success or fale on I/O error.
 bool load_words(string_vector& words, const std::string& path) {
+  TRACE_SCOPE("load_words");
   std::ifstream words_file;
   words_file.open(path);
   std::string word;
@@ -49,7 +52,7 @@ bool is_mirrored(const std::string& string1, const std::string& string2) {
   int rev_i = string2.size() - 1;
   int i = 0;
 
-  if (string1 == string2 || string1 == "" || string2 == "") {
+  if (string1 == string2 || string1 == "" || string1.size() != string2.size()) {
     return false;
   }
   else {
@@ -112,7 +115,7 @@ std::string longest_mirrored_string(const string_vector& strings) {
   std::string best = "";
 	
   for (int i = 0; i < strings.size(); i++) {
-    for (int j = i + 1; j < strings.size() - i; j++) {
+    for (int j = i + 1; j < strings.size(); j++) {
       if (is_mirrored(strings[i], strings[j]) && strings[i].size() > best.size()) {
         best = strings[i];
       }
@@ -141,7 +144,7 @@ string_vector longest_substring_trio(const string_vector& strings) {
         abc_length = a.size() + b.size() + c.size();
         a_sub_b = is_substring(a, b);
         b_sub_c = is_substring(b, c);
-        if (a_sub_b && b_sub_c && (abc_length > best_length) && !(a == b || b == c)) {
+        if (a_sub_b && b_sub_c && (abc_length > best_length) && !(a.empty() || a == b || b == c)) {
           best_length = abc_length;
           trio[0] = a;
           trio[1] = b;
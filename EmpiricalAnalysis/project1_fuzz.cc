@@ -0,0 +1,146 @@
+///////////////////////////////////////////////////////////////////////////////
+// project1_fuzz.cc
+//
+// Differential fuzzing of project1.hh. Each brute-force algorithm is
+// checked against a reference written straight from its specification,
+// on small random word lists where mirrors, repeats and substrings are
+// common.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+#include "fuzz.hh"
+#include "project1.hh"
+
+using namespace std;
+
+const string ALPHABET = "abc";
+
+string_vector generate_words(FuzzRng& rng) {
+  return rng.words(10, ALPHABET, 0, 5);
+}
+
+// The mirror relation of is_mirrored(...): reverses that are not equal.
+bool reference_mirrored(const string& string1, const string& string2) {
+  return string1 != string2 && string(string2.rbegin(), string2.rend()) == string1;
+}
+
+// Length of a longest string whose mirror is also in the vector.
+size_t reference_longest_mirrored(const string_vector& words) {
+  set<string> present(words.begin(), words.end());
+  size_t best = 0;
+  for (const string& word : words) {
+    if (reference_mirrored(word, string(word.rbegin(), word.rend()))
+        && present.count(string(word.rbegin(), word.rend()))) {
+      best = max(best, word.size());
+    }
+  }
+  return best;
+}
+
+// Total length of a longest substring trio: for every middle string, the
+// longest other string inside it and the longest other string around it.
+size_t reference_longest_trio(const string_vector& words) {
+  size_t best = 0;
+  for (const string& b : words) {
+    long inner = -1, outer = -1;
+    for (const string& other : words) {
+      if (other.empty() || other == b) {
+        continue;
+      }
+      if (b.find(other) != string::npos) {
+        inner = max(inner, static_cast<long>(other.size()));
+      }
+      if (other.find(b) != string::npos) {
+        outer = max(outer, static_cast<long>(other.size()));
+      }
+    }
+    if (!b.empty() && inner >= 0 && outer >= 0) {
+      best = max(best, b.size() + inner + outer);
+    }
+  }
+  return best;
+}
+
+int main(int argc, char* argv[]) {
+  Fuzzer fuzzer(argc, argv, 1000);
+
+  fuzzer.check<string_vector>("is_mirrored",
+    [](FuzzRng& rng) {
+      return string_vector{ rng.string(ALPHABET, 0, 4), rng.string(ALPHABET, 0, 4) };
+    },
+    [](const string_vector& pair) -> string {
+      if (pair.size() != 2 || is_mirrored(pair[0], pair[1]) == reference_mirrored(pair[0], pair[1])) {
+        return "";
+      }
+      return "is_mirrored says " + string(is_mirrored(pair[0], pair[1]) ? "true" : "false");
+    },
+    shrink_strings,
+    describe_strings);
+
+  fuzzer.check<string_vector>("character_mode",
+    generate_words,
+    [](const string_vector& words) -> string {
+      map<char, int> counts;
+      for (const string& word : words) {
+        for (char letter : word) {
+          counts[letter]++;
+        }
+      }
+      if (counts.empty()) {
+        return "";
+      }
+      // map order is ascending, so the first of the most common wins ties
+      char expected = counts.begin()->first;
+      for (const auto& count : counts) {
+        if (count.second > counts[expected]) {
+          expected = count.first;
+        }
+      }
+      char mode = character_mode(words);
+      return (mode == expected) ? "" : string("mode '") + mode + "', expected '" + expected + "'";
+    },
+    shrink_strings,
+    describe_strings);
+
+  fuzzer.check<string_vector>("longest_mirrored_string",
+    generate_words,
+    [](const string_vector& words) -> string {
+      string result = longest_mirrored_string(words);
+      size_t expected = reference_longest_mirrored(words);
+      if (result.size() != expected) {
+        return "returned \"" + result + "\", expected length " + to_string(expected);
+      }
+      if (!result.empty() && find(words.begin(), words.end(), string(result.rbegin(), result.rend()))
+                             == words.end()) {
+        return "\"" + result + "\" has no mirror in the input";
+      }
+      return "";
+    },
+    shrink_strings,
+    describe_strings);
+
+  fuzzer.check<string_vector>("longest_substring_trio",
+    generate_words,
+    [](const string_vector& words) -> string {
+      string_vector trio = longest_substring_trio(words);
+      size_t total = trio[0].size() + trio[1].size() + trio[2].size();
+      size_t expected = reference_longest_trio(words);
+      if (total != expected) {
+        return "total length " + to_string(total) + ", expected " + to_string(expected);
+      }
+      if (total > 0 && !(trio[0] != trio[1] && trio[1] != trio[2] && !trio[0].empty()
+                         && is_substring(trio[0], trio[1]) && is_substring(trio[1], trio[2]))) {
+        return "returned " + describe_strings(trio) + ", which is not a trio";
+      }
+      return "";
+    },
+    shrink_strings,
+    describe_strings,
+    300);
+
+  return fuzzer.finish();
+}
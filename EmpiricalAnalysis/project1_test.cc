@@ -58,6 +58,7 @@ int main() {
 		     TEST_FALSE("false: 5 characters", is_mirrored("balki", "yrral"));
 		     TEST_FALSE("false: same string", is_mirrored("aaaaa", "aaaaa"));
 		     TEST_FALSE("false: empty string", is_mirrored("", ""));
+		     TEST_FALSE("false: different lengths", is_mirrored("ba", "abc"));
 		   });
 
   rubric.criterion("is_substring(...)", 1,
@@ -105,6 +106,7 @@ int main() {
 		     };
 		     string result = longest_mirrored_string(has_mirrored);
 		     TEST_TRUE("found", (result == "ferret") || (result == "terref"));
+		     TEST_EQUAL("found: last pair", 2, longest_mirrored_string({ "", "ca", "ac" }).size());
 		   });
   
   rubric.criterion("longest_substring_trio(...)", 2,
@@ -133,6 +135,9 @@ int main() {
 		     TEST_EQUAL("found: short trio", "boat", trio[1]);
 		     TEST_EQUAL("found: short trio", "boats", trio[2]);
 
+		     trio = longest_substring_trio({ "", "a", "ac" });
+		     TEST_TRUE("not found: empty string", trio[0].empty() && trio[1].empty() && trio[2].empty() );
+
 		     // total length 16
 		     has_trio.push_back("garage");
 		     has_trio.push_back("age");
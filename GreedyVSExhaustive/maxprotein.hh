@@ -19,6 +19,8 @@
 #include <string>
 #include <vector>
 
+#include "trace.hh"
+
 // One food item in the USDA database.
 class Food {
 private:
@@ -74,6 +76,7 @@ typedef std::vector<std::shared_ptr<Food>>FoodVector;
 // format. Foods that are missing fields such as the amount string are
 // skipped. Returns nullptr on I/O error.
 std::unique_ptr<FoodVector> load_usda_abbrev(const std::string& path) {
+  TRACE_SCOPE("load_usda_abbrev");
 
   std::unique_ptr<FoodVector> failure(nullptr);
   
@@ -91,6 +94,10 @@ std::unique_ptr<FoodVector> load_usda_abbrev(const std::string& path) {
     for (std::string field; std::getline(ss, field, '^'); ) {
       fields.push_back(field);
     }
+    // getline does not report an empty last field, as on lines ending in '^'
+    if (!line.empty() && line.back() == '^') {
+      fields.push_back("");
+    }
 
     if (fields.size() != 53) {
       return failure;
@@ -251,6 +258,7 @@ return S;
 //this function uses merge sort to sort V 
 std::unique_ptr<FoodVector> merge_sort(const FoodVector& V)
 {
+  TRACE_SCOPE("merge_sort");
   const int n = V.size();
   std::unique_ptr<FoodVector> m_V = std::unique_ptr<FoodVector>(new FoodVector);
   std::unique_ptr<FoodVector> L = std::unique_ptr<FoodVector>(new FoodVector);
@@ -0,0 +1,137 @@
+///////////////////////////////////////////////////////////////////////////////
+// maxprotein_fuzz.cc
+//
+// Differential fuzzing of maxprotein.hh on small random food lists.
+// exhaustive_max_protein is the oracle: a 0/1 knapsack over calories must
+// reach the same protein, and the greedy answer must fit the budget and
+// never beat it. merge_sort is checked against std::stable_sort.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+
+#include "fuzz.hh"
+#include "maxprotein.hh"
+
+using namespace std;
+
+// A fuzz case: (kcal, protein_g) for each food, and the calorie budget.
+struct FoodCase {
+  vector<pair<int, int>> foods;
+  int total_kcal;
+};
+
+FoodVector make_foods(const FoodCase& input) {
+  FoodVector foods;
+  for (size_t i = 0; i < input.foods.size(); i++) {
+    foods.push_back(shared_ptr<Food>(new Food("food " + to_string(i), "1 serving", 100,
+                                              input.foods[i].first, input.foods[i].second)));
+  }
+  return foods;
+}
+
+FoodCase generate_case(FuzzRng& rng) {
+  FoodCase input;
+  int n = rng.range(0, 10);
+  for (int i = 0; i < n; i++) {
+    // Few distinct values, so that ties are common.
+    input.foods.push_back(make_pair(rng.range(0, 12) * 5, rng.range(0, 8)));
+  }
+  input.total_kcal = rng.range(0, 150);
+  return input;
+}
+
+// Without each food; then with a smaller budget; then with each value
+// halved.
+vector<FoodCase> shrink_case(const FoodCase& input) {
+  vector<FoodCase> candidates;
+  for (size_t i = 0; i < input.foods.size(); i++) {
+    FoodCase smaller(input);
+    smaller.foods.erase(smaller.foods.begin() + i);
+    candidates.push_back(smaller);
+  }
+  if (input.total_kcal > 0) {
+    FoodCase smaller(input);
+    smaller.total_kcal /= 2;
+    candidates.push_back(smaller);
+    smaller.total_kcal = input.total_kcal - 1;
+    candidates.push_back(smaller);
+  }
+  for (size_t i = 0; i < input.foods.size(); i++) {
+    FoodCase smaller(input);
+    if (input.foods[i].first > 0) {
+      smaller.foods[i].first /= 2;
+      candidates.push_back(smaller);
+      smaller.foods[i].first = input.foods[i].first;
+    }
+    if (input.foods[i].second > 0) {
+      smaller.foods[i].second /= 2;
+      candidates.push_back(smaller);
+    }
+  }
+  return candidates;
+}
+
+string describe_case(const FoodCase& input) {
+  ostringstream out;
+  out << "total_kcal=" << input.total_kcal << ", foods (kcal, protein) =";
+  for (const auto& food : input.foods) {
+    out << " (" << food.first << ", " << food.second << ")";
+  }
+  return out.str();
+}
+
+// The most protein within total_kcal, by dynamic programming over calories.
+int knapsack_protein(const FoodCase& input) {
+  vector<int> best(input.total_kcal + 1, 0);
+  for (const auto& food : input.foods) {
+    for (int kcal = input.total_kcal; kcal >= food.first; kcal--) {
+      best[kcal] = max(best[kcal], best[kcal - food.first] + food.second);
+    }
+  }
+  return best[input.total_kcal];
+}
+
+int main(int argc, char* argv[]) {
+  Fuzzer fuzzer(argc, argv, 1000);
+
+  fuzzer.check<FoodCase>("merge_sort",
+    generate_case,
+    [](const FoodCase& input) -> string {
+      FoodVector foods = make_foods(input);
+      unique_ptr<FoodVector> sorted = merge_sort(foods);
+      FoodVector expected(foods);
+      stable_sort(expected.begin(), expected.end(),
+                  [](const shared_ptr<Food>& a, const shared_ptr<Food>& b) {
+                    return a->protein_g() < b->protein_g();
+                  });
+      return (*sorted == expected) ? "" : "not a stable sort by protein";
+    },
+    shrink_case,
+    describe_case);
+
+  fuzzer.check<FoodCase>("exhaustive and greedy max protein",
+    generate_case,
+    [](const FoodCase& input) -> string {
+      FoodVector foods = make_foods(input);
+      int exhaustive_kcal, exhaustive_protein, greedy_kcal, greedy_protein;
+      sum_food_vector(exhaustive_kcal, exhaustive_protein, *exhaustive_max_protein(foods, input.total_kcal));
+      sum_food_vector(greedy_kcal, greedy_protein, *greedy_max_protein(foods, input.total_kcal));
+      int expected = knapsack_protein(input);
+      ostringstream failure;
+      if (exhaustive_kcal > input.total_kcal || greedy_kcal > input.total_kcal) {
+        failure << "over budget: exhaustive " << exhaustive_kcal << " kcal, greedy " << greedy_kcal << " kcal";
+      }
+      else if (exhaustive_protein != expected) {
+        failure << "exhaustive protein " << exhaustive_protein << ", knapsack " << expected;
+      }
+      else if (greedy_protein > exhaustive_protein) {
+        failure << "greedy protein " << greedy_protein << " beats exhaustive " << exhaustive_protein;
+      }
+      return failure.str();
+    },
+    shrink_case,
+    describe_case);
+
+  return fuzzer.finish();
+}
@@ -1,115 +1,472 @@
+///////////////////////////////////////////////////////////////////////////////
+// maxprotein_main.cc
+//
+// Benchmarks the greedy and exhaustive algorithms over a sweep of input
+// sizes and calorie budgets, without prompting, so that sweeps can run
+// unattended:
+//
+//    ./experiment                                   the standard workload
+//    ./experiment --algorithm exhaustive --n 10:24:2 --format csv
+//    ./experiment --batch nightly.sweep --format json --output sweep.json
+//
+// Options:
+//
+//    --algorithm greedy|exhaustive|both   (default both)
+//    --n LIST          numbers of foods; default 1000 for greedy and 20
+//                      for exhaustive search
+//    --budget LIST     kcal budgets (default 2000)
+//    --repetitions R   most timed samples per point (default 15)
+//    --threads T       points run at once (default 1)
+//    --format text|json|csv
+//    --output PATH     write there instead of standard output
+//    --batch PATH      one sweep per line, see below
+//
+// A LIST is comma separated values or FIRST:LAST[:STEP] ranges, e.g.
+// "10:20:5,32". Every point of the sweep is each algorithm at each n and
+// budget. A batch file holds one sweep per line, written as the
+// --algorithm, --n, --budget and --repetitions options; the command line
+// supplies the defaults for what a line leaves out. Blank lines and lines
+// starting with '#' are skipped.
+//
+// Points run at once compete for the processor and the allocation
+// counters, so keep --threads at 1 when the figures are to be compared.
+// An optional last argument names another food table, such as one written
+// by datagen.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
+#include <thread>
 
-#include "timer.hh"
+#include "bench.hh"
 #include "maxprotein.hh"
 
 using namespace std;
 
-void time_greedy_alg(const FoodVector& foods, int greedy_n, int max_protein);
-void time_exhaust_alg(const FoodVector& foods, int exhaust_n, int max_protein);
-void get_experiment_values(int& n_value, int& max_protein, const string& purpose);
+// One sweep: the points are every algorithm at every n and budget.
+struct Sweep {
+  Sweep() : algorithms({ "greedy", "exhaustive" }), budgets(1, 2000), repetitions(15) { }
+
+  vector<string> algorithms;
+  vector<int> n;              // empty for each algorithm's default
+  vector<int> budgets;
+  int repetitions;
+};
+
+struct SweepPoint {
+  string algorithm;
+  int n;
+  int budget;
+  int repetitions;
+};
+
+struct SweepOutcome {
+  BenchmarkResult timing;
+  unique_ptr<FoodVector> results;
+  string error;
+};
+
+bool parse_list(const string& text, vector<int>& values);
+bool parse_sweep_option(const vector<string>& args, size_t& i, Sweep& sweep, string& error);
+bool load_batch(const string& path, const Sweep& defaults, vector<Sweep>& sweeps, string& error);
+void expand_sweep(const Sweep& sweep, vector<SweepPoint>& points);
+void run_point(const FoodVector& foods, const SweepPoint& point, SweepOutcome& outcome);
+void write_text(ostream& out, const vector<SweepPoint>& points, const vector<SweepOutcome>& outcomes);
+void write_json(ostream& out, const vector<SweepPoint>& points, const vector<SweepOutcome>& outcomes);
+void write_csv(ostream& out, const vector<SweepPoint>& points, const vector<SweepOutcome>& outcomes);
+
+int main(int argc, char* argv[]) {
+  vector<string> args(argv + 1, argv + argc);
+  Sweep defaults;
+  string batch_path, output_path, format = "text", path = "ABBREV.txt", error;
+  int threads = 1;
+  for (size_t i = 0; i < args.size(); i++) {
+    if (parse_sweep_option(args, i, defaults, error)) {
+      continue;
+    }
+    if (!error.empty()) {
+      cerr << "error: " << error << endl;
+      return 1;
+    }
+    bool has_value = i + 1 < args.size();
+    if (has_value && args[i] == "--threads") {
+      threads = atoi(args[++i].c_str());
+    } else if (has_value && args[i] == "--format") {
+      format = args[++i];
+    } else if (has_value && args[i] == "--output") {
+      output_path = args[++i];
+    } else if (has_value && args[i] == "--batch") {
+      batch_path = args[++i];
+    } else if (i + 1 == args.size() && args[i].compare(0, 2, "--") != 0) {
+      path = args[i];
+    } else {
+      cerr << "usage: " << argv[0]
+           << " [--algorithm greedy|exhaustive|both] [--n LIST] [--budget LIST]"
+           << " [--repetitions R] [--threads T] [--format text|json|csv]"
+           << " [--output PATH] [--batch PATH] [FOODS]" << endl;
+      return 1;
+    }
+  }
+  if (threads < 1) {
+    cerr << "error: --threads must be at least 1" << endl;
+    return 1;
+  }
+  if (format != "text" && format != "json" && format != "csv") {
+    cerr << "error: unknown format \"" << format << "\"" << endl;
+    return 1;
+  }
+
+  vector<Sweep> sweeps;
+  if (batch_path.empty()) {
+    sweeps.push_back(defaults);
+  } else if (!load_batch(batch_path, defaults, sweeps, error)) {
+    cerr << "error: " << error << endl;
+    return 1;
+  }
+  vector<SweepPoint> points;
+  for (const Sweep& sweep : sweeps) {
+    expand_sweep(sweep, points);
+  }
+  for (const SweepPoint& point : points) {
+    // The exhaustive search enumerates subsets in a 64-bit mask.
+    if (point.algorithm == "exhaustive" && point.n >= 64) {
+      cerr << "error: exhaustive search takes fewer than 64 foods, not " << point.n << endl;
+      return 1;
+    }
+  }
+
+  unique_ptr<FoodVector> all_foods = load_usda_abbrev(path);
+  if (!all_foods) {
+    cerr << "error: cannot load \"" << path << "\"" << endl;
+    return 1;
+  }
 
-int main() {
-  int greedy_n;
-  int greedy_protein;
-  int exhaust_n;
-  int exhaust_protein;
-  unique_ptr<FoodVector> all_foods = load_usda_abbrev("ABBREV.txt");
+  ofstream file;
+  if (!output_path.empty()) {
+    file.open(output_path);
+    if (!file) {
+      cerr << "error: cannot open \"" << output_path << "\"" << endl;
+      return 1;
+    }
+  }
+  ostream& out = output_path.empty() ? cout : file;
 
-  get_experiment_values(greedy_n, greedy_protein, "greedy algorithm");
-  time_greedy_alg(*all_foods, greedy_n, greedy_protein);
-  get_experiment_values(exhaust_n, exhaust_protein, "exhaustive algorithm");
-  time_exhaust_alg(*all_foods, exhaust_n, exhaust_protein);
+  // Workers take the next point until none are left.
+  vector<SweepOutcome> outcomes(points.size());
+  atomic<size_t> next(0);
+  auto work = [&]() {
+    for (size_t i = next++; i < points.size(); i = next++) {
+      run_point(*all_foods, points[i], outcomes[i]);
+    }
+  };
+  vector<thread> workers;
+  for (int t = 1; t < threads; t++) {
+    workers.push_back(thread(work));
+  }
+  work();
+  for (thread& worker : workers) {
+    worker.join();
+  }
 
+  if (format == "json") {
+    write_json(out, points, outcomes);
+  } else if (format == "csv") {
+    write_csv(out, points, outcomes);
+  } else {
+    write_text(out, points, outcomes);
+  }
+  out.flush();
+  if (!out) {
+    cerr << "error: cannot write \"" << output_path << "\"" << endl;
+    return 1;
+  }
+  for (const SweepOutcome& outcome : outcomes) {
+    if (!outcome.error.empty()) {
+      return 1;
+    }
+  }
   return 0;
 }
 
-//time_greedy_alg
-//parameters: foods is the vector of all foods available, greedy_n is the desired n value, max_protein
-//            is the max protein value desired
-//returns: none
-//this function will time the greedy algorithm with the desired values and time it, while printing the result
-//afterwards
-void time_greedy_alg(const FoodVector& foods, int greedy_n, int max_protein) {
-  unique_ptr<FoodVector> greedy_foods = filter_food_vector(foods, 1, 2000, greedy_n);
-  unique_ptr<FoodVector> results;
-  double elapsed;
-  
-  cout << "Beginning greedy algorithm experiment. . . " << endl;
+//parse_list
+//parameters: text is a list such as "10:20:5,32", values receives its values in order
+//returns: false when the list is malformed or a range is empty
+//this function will expand comma separated values and FIRST:LAST[:STEP] ranges
+bool parse_list(const string& text, vector<int>& values) {
+  values.clear();
+  stringstream items(text);
+  string item;
+  while (getline(items, item, ',')) {
+    int first, last, step = 1;
+    char colon1 = 0, colon2 = 0;
+    stringstream range(item);
+    range >> first;
+    if (!range) {
+      return false;
+    }
+    last = first;
+    if (range >> colon1) {
+      if (colon1 != ':' || !(range >> last)) {
+        return false;
+      }
+      if (range >> colon2 && (colon2 != ':' || !(range >> step))) {
+        return false;
+      }
+    }
+    if (!range.eof() || step < 1 || last < first) {
+      return false;
+    }
+    for (int value = first; value <= last; value += step) {
+      values.push_back(value);
+    }
+  }
+  return !values.empty();
+}
 
-  Timer timer;
-  results = greedy_max_protein(*greedy_foods, max_protein);
-  elapsed = timer.elapsed();
+//parse_sweep_option
+//parameters: args are the words of a command line or batch line, i is the index of the option,
+//            sweep receives its value, error explains why a sweep option was rejected
+//returns: true when args[i] was a sweep option; i is then left on its value
+//this function will parse the options that a batch file line may also give
+bool parse_sweep_option(const vector<string>& args, size_t& i, Sweep& sweep, string& error) {
+  const string& option = args[i];
+  if (option != "--algorithm" && option != "--n" && option != "--budget" && option != "--repetitions") {
+    return false;
+  }
+  if (i + 1 == args.size()) {
+    error = option + " needs a value";
+    return false;
+  }
+  const string& value = args[++i];
+  vector<int> values;
+  if (option == "--algorithm") {
+    if (value == "both") {
+      sweep.algorithms = { "greedy", "exhaustive" };
+    } else if (value == "greedy" || value == "exhaustive") {
+      sweep.algorithms = { value };
+    } else {
+      error = "unknown algorithm \"" + value + "\"";
+      return false;
+    }
+  } else if (!parse_list(value, values)) {
+    error = "bad " + option + " \"" + value + "\"";
+    return false;
+  } else if (option == "--n") {
+    if (*min_element(values.begin(), values.end()) < 1) {
+      error = "--n values must be at least 1";
+      return false;
+    }
+    sweep.n = values;
+  } else if (option == "--budget") {
+    if (*min_element(values.begin(), values.end()) < 0) {
+      error = "--budget values must be at least 0";
+      return false;
+    }
+    sweep.budgets = values;
+  } else {
+    if (values.size() != 1 || values[0] < 1) {
+      error = "--repetitions must be one value of at least 1";
+      return false;
+    }
+    sweep.repetitions = values[0];
+  }
+  return true;
+}
 
-  cout << "Greedy algorithm experiment completed, time elapsed: " << elapsed << endl;
-  cout << "Results found:" << endl;
-  print_food_vector(*results);
+//load_batch
+//parameters: path names the batch file, defaults are the sweep options of the command line,
+//            sweeps receives one sweep per line, error explains a failure
+//returns: false on I/O error or a bad line
+//this function will read a batch file as described at the top of this file
+bool load_batch(const string& path, const Sweep& defaults, vector<Sweep>& sweeps, string& error) {
+  ifstream f(path);
+  if (!f) {
+    error = "cannot open \"" + path + "\"";
+    return false;
+  }
+  string line;
+  for (int number = 1; getline(f, line); number++) {
+    stringstream words(line);
+    vector<string> args;
+    string word;
+    while (words >> word) {
+      args.push_back(word);
+    }
+    if (args.empty() || args[0][0] == '#') {
+      continue;
+    }
+    Sweep sweep = defaults;
+    for (size_t i = 0; i < args.size(); i++) {
+      if (!parse_sweep_option(args, i, sweep, error)) {
+        if (error.empty()) {
+          error = "unknown option \"" + args[i] + "\"";
+        }
+        error = path + ":" + to_string(number) + ": " + error;
+        return false;
+      }
+    }
+    sweeps.push_back(sweep);
+  }
+  if (sweeps.empty()) {
+    error = "no sweeps in \"" + path + "\"";
+    return false;
+  }
+  return true;
 }
 
-//time_exhaust_alg
-//parameters: foods is the vector of all foods available, exhaust_n is the desired n value, max_protein
-//            is the desired max protein value
+//expand_sweep
+//parameters: sweep is a parsed sweep, points receives its points
 //returns: none
-//this function will time the exhaustive algorithm with the desired values and time it,
-//while printing the result afterwards
-void time_exhaust_alg(const FoodVector& foods, int exhaust_n, int max_protein) {
-  unique_ptr<FoodVector> exhaust_foods = filter_food_vector(foods, 1, 2000, exhaust_n);
-  unique_ptr<FoodVector> results;
-  double elapsed;
-  
-  cout << "Beginning Exhaustive algorithm experiment. . . " << endl;
+//this function will append every algorithm, n and budget combination of the sweep
+void expand_sweep(const Sweep& sweep, vector<SweepPoint>& points) {
+  for (const string& algorithm : sweep.algorithms) {
+    vector<int> n = sweep.n;
+    if (n.empty()) {
+      n.push_back((algorithm == "greedy") ? 1000 : 20);
+    }
+    for (int size : n) {
+      for (int budget : sweep.budgets) {
+        SweepPoint point = { algorithm, size, budget, sweep.repetitions };
+        points.push_back(point);
+      }
+    }
+  }
+}
+
+//run_point
+//parameters: foods is the vector of all foods available, point is the algorithm and values to use,
+//            outcome receives the result and timing statistics, or an error
+//returns: none
+//this function will run the algorithm once for its result, then benchmark it
+void run_point(const FoodVector& foods, const SweepPoint& point, SweepOutcome& outcome) {
+  unique_ptr<FoodVector> input = filter_food_vector(foods, 1, 2000, point.n);
+  if (static_cast<int>(input->size()) < point.n) {
+    outcome.error = "only " + to_string(input->size()) + " foods qualify";
+    return;
+  }
+  bool greedy = point.algorithm == "greedy";
+  auto solve = [&]() {
+    return greedy ? greedy_max_protein(*input, point.budget)
+                  : exhaustive_max_protein(*input, point.budget);
+  };
+  BenchmarkOptions options;
+  options.samples = point.repetitions;
+  options.min_samples = min(options.min_samples, point.repetitions);
+  outcome.results = solve();
+  outcome.timing = benchmark(point.algorithm + "_max_protein, n=" + to_string(point.n)
+                             + ", kcal=" + to_string(point.budget),
+                             [&]() { do_not_optimize(solve()); },
+                             options);
+}
+
+//write_text
+//parameters: out is the stream to write to, points and outcomes are the sweep in order
+//returns: none
+//this function will print each point's timing statistics followed by the foods it chose
+void write_text(ostream& out, const vector<SweepPoint>& points, const vector<SweepOutcome>& outcomes) {
+  for (size_t i = 0; i < points.size(); i++) {
+    if (!outcomes[i].error.empty()) {
+      out << points[i].algorithm << ", n=" << points[i].n << ": error: " << outcomes[i].error << endl;
+      continue;
+    }
+    out << outcomes[i].timing << endl;
+    out << "Results found:" << endl;
+    for (auto& food : *outcomes[i].results) {
+      out << food->description()
+          << " (100 g where each " << food->amount()
+          << " is " << food->amount_g() << " g)"
+          << " kcal=" << food->kcal()
+          << " protein=" << food->protein_g() << " g"
+          << endl;
+    }
+    int total_kcal, total_protein_g;
+    sum_food_vector(total_kcal, total_protein_g, *outcomes[i].results);
+    out << "total kcal=" << total_kcal << " total_protein=" << total_protein_g << " g" << endl;
+  }
+}
 
-  Timer timer;
-  results = exhaustive_max_protein(*exhaust_foods, max_protein);
-  elapsed = timer.elapsed();
+// The columns of the JSON and CSV output, in order.
+const char* SWEEP_FIELDS[] = {
+  "algorithm", "n", "budget", "foods", "kcal", "protein_g",
+  "median_s", "min_s", "mad_s", "ci_low_s", "ci_high_s", "samples", "iterations",
+  "allocations_per_call", "bytes_per_call", "peak_bytes", "max_rss_bytes", "error"
+};
+const int SWEEP_FIELD_COUNT = sizeof(SWEEP_FIELDS) / sizeof(SWEEP_FIELDS[0]);
 
-  cout << "Exhaustive algorithm experiment completed, time elapsed: " << elapsed << endl;
-  cout << "Results found:" << endl;
-  print_food_vector(*results);
+//sweep_values
+//parameters: point and outcome are one point of the sweep
+//returns: its values in the order of SWEEP_FIELDS, numbers written out and strings left bare
+//this function will format one row of the machine-readable output
+vector<string> sweep_values(const SweepPoint& point, const SweepOutcome& outcome) {
+  vector<string> values = { point.algorithm, to_string(point.n), to_string(point.budget) };
+  if (!outcome.error.empty()) {
+    values.resize(SWEEP_FIELD_COUNT - 1);
+    values.push_back(outcome.error);
+    return values;
+  }
+  int total_kcal, total_protein_g;
+  sum_food_vector(total_kcal, total_protein_g, *outcome.results);
+  const BenchmarkResult& timing = outcome.timing;
+  double numbers[] = { timing.median, timing.min, timing.mad, timing.ci_low, timing.ci_high,
+                       static_cast<double>(timing.samples), static_cast<double>(timing.iterations),
+                       timing.allocations, timing.allocated_bytes,
+                       static_cast<double>(timing.peak_bytes), static_cast<double>(timing.peak_rss) };
+  values.push_back(to_string(outcome.results->size()));
+  values.push_back(to_string(total_kcal));
+  values.push_back(to_string(total_protein_g));
+  for (double number : numbers) {
+    ostringstream text;
+    text << setprecision(9) << number;
+    values.push_back(text.str());
+  }
+  values.push_back("");
+  return values;
 }
 
-//get_experiment_values
-//parameters: n_value is an int to store n value input, max_protein is an int to store max protein
-//            input, purpose is a string for defining the input's purpose
+//write_json
+//parameters: out is the stream to write to, points and outcomes are the sweep in order
 //returns: none
-//this function will get values for the experiment and use a given string to specify which
-//experiment the input is for
-void get_experiment_values(int& n_value, int& max_protein, const string& purpose) {
-    bool test;
-
-    do {
-      cout << "enter n value for " << purpose << ":";
-      cin >> n_value;
-      if (cin.fail()) {
-        cin.clear();
-        cin.ignore(1000, '\n');
-        cout << endl << "Error: integer values only" << endl;
-        test = false;
+//this function will write the sweep as a JSON array with one object per point
+void write_json(ostream& out, const vector<SweepPoint>& points, const vector<SweepOutcome>& outcomes) {
+  out << "[" << endl;
+  for (size_t i = 0; i < points.size(); i++) {
+    vector<string> values = sweep_values(points[i], outcomes[i]);
+    out << "  {";
+    for (int f = 0; f < SWEEP_FIELD_COUNT; f++) {
+      // The algorithm and error are the only strings, and hold no quotes.
+      bool text = f == 0 || f == SWEEP_FIELD_COUNT - 1;
+      string value = values[f];
+      if (value.empty()) {
+        value = "null";
+      } else if (text) {
+        value = "\"" + value + "\"";
       }
-      else if (n_value < 1) {
-        cout << endl << "Error: positive integer values >= 1 only" << endl;
-        test = false;
-      }
-      else {
-        test = true;
-      }
-    }while(!test);
-
-    do {
-      cout << "enter max kcal value for " << purpose << ":";
-      cin >> max_protein;
-      if (cin.fail()) {
-        cin.clear();
-        cin.ignore(1000, '\n');
-        cout << endl << "Error: integer values only" << endl;
-        test = false;
-      }
-      else if (max_protein < 0) {
-        cout << endl << "Error: positive integer values >= 0 only" << endl;
-        test = false;
-      }
-      else {
-        test = true;
-      }
-    }while(!test);
+      out << (f ? ", " : "") << "\"" << SWEEP_FIELDS[f] << "\": " << value;
+    }
+    out << "}" << (i + 1 < points.size() ? "," : "") << endl;
+  }
+  out << "]" << endl;
+}
+
+//write_csv
+//parameters: out is the stream to write to, points and outcomes are the sweep in order
+//returns: none
+//this function will write the sweep as CSV with a header row and one row per point
+void write_csv(ostream& out, const vector<SweepPoint>& points, const vector<SweepOutcome>& outcomes) {
+  for (int f = 0; f < SWEEP_FIELD_COUNT; f++) {
+    out << (f ? "," : "") << SWEEP_FIELDS[f];
+  }
+  out << endl;
+  for (size_t i = 0; i < points.size(); i++) {
+    vector<string> values = sweep_values(points[i], outcomes[i]);
+    for (int f = 0; f < SWEEP_FIELD_COUNT; f++) {
+      out << (f ? "," : "") << values[f];
+    }
+    out << endl;
+  }
 }
@@ -7,8 +7,11 @@
 
 
 #include <cassert>
+#include <cstdio>
+#include <fstream>
 #include <sstream>
 
+#include "datagen.hh"
 #include "maxprotein.hh"
 #include "rubrictest.hh"
 
@@ -30,6 +33,49 @@ int main() {
 		     TEST_EQUAL("size", 8490, all_foods->size());	
 		   });
   
+  rubric.criterion("load_usda_abbrev empty last field", 1,
+		   [&]() {
+		     // std::getline does not report the empty field after a
+		     // trailing '^', which left these lines one field short.
+		     std::ifstream in("ABBREV.txt");
+		     std::ofstream out("abbrev_test_foods.txt");
+		     int trailing = 0;
+		     for (std::string line; std::getline(in, line); ) {
+		       if (!line.empty() && line.back() == '^') {
+			 out << line << "\n";
+			 trailing++;
+		       }
+		     }
+		     out.close();
+		     TEST_EQUAL("lines ending in '^'", 50, trailing);
+		     auto foods = load_usda_abbrev("abbrev_test_foods.txt");
+		     std::remove("abbrev_test_foods.txt");
+		     TEST_TRUE("loads", foods);
+		     // 12 of them have no amount, and are skipped like any other.
+		     TEST_EQUAL("size", 38, foods ? foods->size() : 0);
+		   });
+
+  rubric.criterion("synthetic food tables", 1,
+		   [&]() {
+		     std::ostringstream first, again, other;
+		     write_foods(first, 500, 1);
+		     write_foods(again, 500, 1);
+		     write_foods(other, 500, 2);
+		     TEST_TRUE("same seed, same table", first.str() == again.str());
+		     TEST_TRUE("new seed, new table", first.str() != other.str());
+		     {
+		       std::ofstream out("datagen_test_foods.txt");
+		       out << first.str();
+		     }
+		     auto synthetic = load_usda_abbrev("datagen_test_foods.txt");
+		     std::remove("datagen_test_foods.txt");
+		     TEST_TRUE("loads", synthetic);
+		     TEST_EQUAL("size", 500, synthetic->size());
+		     for (auto& food : *synthetic) {
+		       TEST_TRUE("protein calories", 4 * food->protein_g() <= food->kcal() + 4);
+		     }
+		   });
+
   rubric.criterion("filter_food_vector", 2,
 		   [&]() {
 		     auto three = filter_food_vector(*all_foods, 1, 2000, 3),
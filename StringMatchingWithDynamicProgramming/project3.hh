@@ -12,6 +12,7 @@
 #include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
 #include <map>
@@ -21,66 +22,55 @@
 #include <string>
 #include <vector>
 
-// Simple structure for a single protein
-struct Protein {
-	Protein() {
-		description = "";
-		sequence = "";
-	}
-	Protein(std::string desc, std::string seq) {
-		description = desc;
-		sequence = seq;
-	}
-	std::string		description;
-	std::string 	sequence;
-};
-
-// Alias for a vector of shared pointers to Protein objects.
-typedef std::vector<std::shared_ptr<Protein>> ProteinVector;
-
+#include "alignment_context.hh"
+#include "fasta.hh"
+#include "kmer_index.hh"
+#include "residues.hh"
+#include "result_cache.hh"
+#include "sequence_database.hh"
+#include "trace.hh"
 
 // -------------------------------------------------------------------------
-// Load all the proteins from a standard FASTA format file with one line
-// per sequence (multi-line sequences are not allowed).
-// Returns false on I/O error.
+// longest_common_subsequence_kernel
+// parameters: two arrays of n and m residues, either raw characters or
+//             residue codes
+// returns: the length of their longest common subsequence
+// this is the dynamic programming table shared by the
+// dynamicprogramming_longest_common_subsequence overloads
 // -------------------------------------------------------------------------
-bool load_proteins(ProteinVector & proteins, const std::string& path) 
+template <typename Residue>
+int longest_common_subsequence_kernel(const Residue * string1, int n,
+                                      const Residue * string2, int m)
 {
-  //std::cout << "Loading proteins from [" << path << "]" << std::endl;
-  proteins.clear();
-  std::ifstream ifs(path.c_str());
-  if (!ifs.is_open() || !ifs.good()) {
-    std::cout << "Failed to open [" << path << "]" << std::endl;
-    return false;
-  }
-  int proteinsLoaded = 0;
-  bool have_description = false;
-  std::shared_ptr<Protein> newProtein = nullptr;
-  while (!ifs.eof()) {
-    std::string lineBuffer;
-    std::getline(ifs, lineBuffer);
-    if (ifs.eof()) {
-      break;
-    }
-    if (lineBuffer.size() == 0) {
-		continue;
-	}
-    if (lineBuffer[0] == '>') {
-		newProtein = std::shared_ptr<Protein>(new Protein);
-		newProtein->description = lineBuffer.substr(1);
-        have_description = true;
-    } else if (have_description) {
-		newProtein->sequence = lineBuffer;
-	    proteins.push_back(newProtein);
-        proteinsLoaded++;
-        have_description = false;
-    }
+  TRACE_SCOPE("dp fill");
+  // D is (n + 1) x (m + 1), row by row, in this thread's scratch arena
+  AlignmentContext::Frame frame(AlignmentContext::for_thread());
+  const int cols = m + 1;
+  int * D = frame.allocate<int>((n + 1) * cols);
+  int up;
+  int left;
+  int diag;
+
+  for (int i = 0; i <= n; i++) {
+    D[i * cols] = 0;
+  }
+  for (int j = 0; j <= m; j++) {
+    D[j] = 0;
   }
 
-	ifs.close();
-  //std::cout << "Loaded " << proteinsLoaded << " proteins from [" << path << "]" << std::endl;
+  for (int i = 1; i <= n; i++) {
+    for (int j = 1; j <= m; j++) {
+      up = D[(i - 1) * cols + j];
+      left = D[i * cols + j - 1];
+      diag = D[(i - 1) * cols + j - 1];
+      if (string1[i - 1] == string2[j - 1]) {
+        diag += 1;
+      }
+      D[i * cols + j] = std::max(std::max(up, left), diag);
+    }
+  }
 
-  return true;
+  return D[n * cols + m];
 }
 
 // -------------------------------------------------------------------------
@@ -94,33 +84,133 @@ bool load_proteins(ProteinVector & proteins, const std::string& path)
 int dynamicprogramming_longest_common_subsequence(const std::string & string1, 
 												  const std::string & string2)
 {
-  int n = string1.size();
-  int m = string2.size();
-  std::vector<std::vector<int>> D(n + 1, std::vector<int>(m+1));
-  int up;
-  int left;
-  int diag;
+  return longest_common_subsequence_kernel(string1.data(), string1.size(),
+                                           string2.data(), string2.size());
+}
 
-  for (int i = 0; i <= n; i++) {
-    D[i][0] = 0;
-  }
-  for (int j = 0; j <= m; j++) {
-    D[0][j] = 0;
-  }
+// -------------------------------------------------------------------------
+// dynamicprogramming_longest_common_subsequence
+// parameters: two packed sequences
+// returns: an int representing the longest common subsequence between the two
+//          sequences
+// same as above, but compares residue codes; letters are case-folded and
+// every non-residue character counts as the same symbol
+// -------------------------------------------------------------------------
+int dynamicprogramming_longest_common_subsequence(const PackedSequence & sequence1,
+												  const PackedSequence & sequence2)
+{
+  std::vector<uint8_t> codes1 = sequence1.codes();
+  std::vector<uint8_t> codes2 = sequence2.codes();
+  return longest_common_subsequence_kernel(codes1.data(), codes1.size(),
+                                           codes2.data(), codes2.size());
+}
 
+// -------------------------------------------------------------------------
+// banded_longest_common_subsequence_pass
+// parameters: two arrays of n and m residues, the band half-width w, and
+//             where to store the band-edge ceiling
+// returns: the best score of a path that stays within w cells of the main
+//          diagonal, never more than the true longest common subsequence
+// only cells with |i - j| <= w are evaluated; row i keeps cell (i, j) at
+// position j - i + w, and the one slot past the band always reads as zero.
+// A path that leaves the band does so with a gap step off an edge cell, and
+// everything before that step stays inside the band, so it scores at most
+// that edge cell's banded score plus the residues left on the shorter side
+// after the step; outside receives the best such bound over all the edge
+// cells, or -1 when the band covers every cell
+// -------------------------------------------------------------------------
+template <typename Residue>
+int banded_longest_common_subsequence_pass(const Residue * string1, int n,
+                                           const Residue * string2, int m,
+                                           int w, int & outside)
+{
+  TRACE_SCOPE("dp fill");
+  AlignmentContext::Frame frame(AlignmentContext::for_thread());
+  int * prev = frame.allocate<int>(2 * w + 2);
+  int * cur = frame.allocate<int>(2 * w + 2);
+  std::fill(prev, prev + 2 * w + 2, 0);
+
+  // Row 0 is all zeros; its edge cell (0, w) can step right out of the band.
+  outside = (w + 1 <= m) ? std::min(n, m - w - 1) : -1;
   for (int i = 1; i <= n; i++) {
-    for (int j = 1; j <= m; j++) {
-      up = D[i - 1][j];
-      left = D[i][j - 1];
-      diag = D[i -1][j - 1];
+    int lo = std::max(1, i - w);
+    int hi = std::min(m, i + w);
+    std::fill(cur, cur + 2 * w + 2, 0);
+    for (int j = lo; j <= hi; j++) {
+      int k = j - i + w;
+      int up = prev[k + 1];
+      int left = (k > 0) ? cur[k - 1] : 0;
+      int diag = prev[k];
       if (string1[i - 1] == string2[j - 1]) {
         diag += 1;
       }
-      D[i][j] = std::max(std::max(up, left), diag);
+      cur[k] = std::max(std::max(up, left), diag);
+    }
+    // Upper edge (i, i + w) steps right; lower edge (i, i - w) steps down.
+    if (i + w + 1 <= m) {
+      outside = std::max(outside, cur[2 * w] + std::min(n - i, m - i - w - 1));
+    }
+    if (i - w >= 0 && i + 1 <= n) {
+      outside = std::max(outside, cur[0] + std::min(n - i - 1, m - i + w));
+    }
+    std::swap(prev, cur);
+  }
+  // Column 0 is all zeros too; its edge cell (w, 0) is handled above when
+  // w >= 1, and is cell (0, 0) of row 0 when w == 0.
+  if (w == 0 && n >= 1) {
+    outside = std::max(outside, std::min(n - 1, m));
+  }
+
+  return (n == 0 || m == 0) ? 0 : prev[m - n + w];
+}
+
+// -------------------------------------------------------------------------
+// dynamicprogramming_longest_common_subsequence_banded
+// parameters: two strings representing sequences, the starting band
+//             half-width, and optionally where to store the width that was
+//             finally used
+// returns: an int representing the longest common subsequence between the two
+//          sequences
+// this function only fills cells within band_width of the diagonal, which
+// takes O((n + m) * band_width) time. When the banded result is below the
+// band-edge ceiling of the pass, some path leaving the band might beat it,
+// so the band is widened and the pass repeated, which keeps the answer
+// exact. The band at least doubles, and goes straight to the width at
+// which the score found so far certifies itself when that is wider.
+// Dissimilar strings need a band covering most of the table, so once a
+// pass would fill half the cells of the full table, the full table is
+// filled instead and final_width is max(n, m)
+// -------------------------------------------------------------------------
+int dynamicprogramming_longest_common_subsequence_banded(const std::string & string1,
+                                                         const std::string & string2,
+                                                         int band_width,
+                                                         int * final_width = nullptr)
+{
+  int n = string1.size();
+  int m = string2.size();
+  int w = std::max(band_width, std::abs(n - m));
+  int score;
+
+  while (true) {
+    if (w < std::max(n, m) && 2 * (2 * w + 1) >= m) {
+      w = std::max(n, m);
+      score = longest_common_subsequence_kernel(string1.data(), n, string2.data(), m);
+      break;
     }
+    int outside;
+    score = banded_longest_common_subsequence_pass(string1.data(), n, string2.data(), m, w, outside);
+    if (w >= std::max(n, m) || score >= outside) {
+      break;
+    }
+    // A path more than w cells off the diagonal has at most max(n, m) - w - 1
+    // matches, so a band that wide certifies the current score outright.
+    w = std::max(2 * w + 1, std::max(n, m) - score - 1);
   }
 
-  return D[n][m];
+  if (final_width != nullptr) {
+    *final_width = w;
+  }
+  return score;
 }
 
 // -------------------------------------------------------------------------
@@ -247,4 +337,151 @@ int best_i = 0;
 //	return best_protein;
 }
 
+// What dynamicprogramming_best_of returns when there are no candidates.
+const size_t NO_MATCH = static_cast<size_t>(-1);
 
+// -------------------------------------------------------------------------
+// dynamicprogramming_best_of
+// parameters: proteins is a vector of protein objects, candidates lists the
+//             positions to check, string1 is a string representing a
+//             sequence to match
+// returns: the position of the best match among the candidates, the first
+//          one checked on ties, or NO_MATCH when there are no candidates
+// -------------------------------------------------------------------------
+size_t dynamicprogramming_best_of(ProteinVector & proteins,
+                                  const std::vector<uint32_t> & candidates,
+                                  const std::string & string1)
+{
+  if (candidates.empty()) {
+    return NO_MATCH;
+  }
+  size_t best_i = candidates[0];
+  int best_score = 0;
+  for (size_t c = 0; c < candidates.size(); c++) {
+    int score = dynamicprogramming_longest_common_subsequence(proteins[candidates[c]]->sequence, string1);
+    if (score > best_score) {
+      best_score = score;
+      best_i = candidates[c];
+    }
+  }
+  return best_i;
+}
+
+// -------------------------------------------------------------------------
+// dynamicprogramming_best_match
+// parameters: proteins is a vector of protein objects, string1 is a string
+//             representing a sequence to match, index is a k-mer index built
+//             over proteins, top_k is how many candidates to check, exact
+//             forces a scan of every protein
+// returns: a shared_ptr to the best match among the top_k proteins sharing
+//          the most k-mers with string1, nullptr for an empty database
+// the shortlist is checked in database order so ties resolve the same way as
+// the full scan; when no protein shares a k-mer this falls back to a full
+// scan
+// -------------------------------------------------------------------------
+std::shared_ptr<Protein> dynamicprogramming_best_match(ProteinVector & proteins,
+                                                       const std::string & string1,
+                                                       const KmerIndex & index,
+                                                       size_t top_k,
+                                                       bool exact = false)
+{
+  assert(index.size() == proteins.size());
+  if (proteins.empty()) {
+    return nullptr;
+  }
+  std::vector<uint32_t> shortlist;
+  if (!exact) {
+    shortlist = index.candidates(string1, top_k);
+  }
+  if (shortlist.empty()) {
+    return dynamicprogramming_best_match(proteins, string1);
+  }
+  std::sort(shortlist.begin(), shortlist.end());
+  return proteins[dynamicprogramming_best_of(proteins, shortlist, string1)];
+}
+
+// -------------------------------------------------------------------------
+// dynamicprogramming_best_of
+// parameters: database is a sequence database, candidates lists the
+//             positions to check, string1 is a string representing a
+//             sequence to match
+// returns: the position of the best match among the candidates, as above
+// each candidate's characters are compared where the database keeps them,
+// without copying them out
+// -------------------------------------------------------------------------
+size_t dynamicprogramming_best_of(const SequenceDatabase & database,
+                                  const std::vector<uint32_t> & candidates,
+                                  const std::string & string1)
+{
+  if (candidates.empty()) {
+    return NO_MATCH;
+  }
+  size_t best_i = candidates[0];
+  int best_score = 0;
+  for (size_t c = 0; c < candidates.size(); c++) {
+    int score = longest_common_subsequence_kernel(database.sequence_data(candidates[c]),
+                                                  database.length(candidates[c]),
+                                                  string1.data(), string1.size());
+    if (score > best_score) {
+      best_score = score;
+      best_i = candidates[c];
+    }
+  }
+  return best_i;
+}
+
+// -------------------------------------------------------------------------
+// dynamicprogramming_best_match
+// parameters: database is a sequence database, string1 is a string
+//             representing a sequence to match, top_k is how many candidates
+//             to check, k is the k-mer length
+// returns: a shared_ptr to the best match among the top_k proteins sharing
+//          the most k-mers with string1, nullptr for an empty database
+// the same seeded search as above, on the k-mer index the database keeps, so
+// the index is built on the first query and reused by the rest; only the
+// winner is copied out of the database
+// -------------------------------------------------------------------------
+std::shared_ptr<Protein> dynamicprogramming_best_match(SequenceDatabase & database,
+                                                       const std::string & string1,
+                                                       size_t top_k,
+                                                       int k = 3)
+{
+  std::vector<uint32_t> shortlist = database.kmer_index(k).candidates(string1, top_k);
+  if (shortlist.empty()) {
+    shortlist.resize(database.size());
+    for (size_t i = 0; i < database.size(); i++) {
+      shortlist[i] = i;
+    }
+  }
+  std::sort(shortlist.begin(), shortlist.end());
+  size_t best = dynamicprogramming_best_of(database, shortlist, string1);
+  return (best == NO_MATCH) ? nullptr : database.protein(best);
+}
+
+// -------------------------------------------------------------------------
+// dynamicprogramming_best_match
+// parameters: database is a sequence database, string1 is a string
+//             representing a sequence to match, cache holds earlier results
+// returns: a shared_ptr to the best match produced by a dynamic programming
+//          algorithm, nullptr for an empty database
+// a query already answered against the same version of the same database
+// comes straight from the cache; otherwise every protein is scanned and the
+// answer is added to the cache
+// -------------------------------------------------------------------------
+std::shared_ptr<Protein> dynamicprogramming_best_match(const SequenceDatabase & database,
+                                                       const std::string & string1,
+                                                       ResultCache & cache)
+{
+  ResultCacheKey key = { string1, RESULT_LONGEST_COMMON_SUBSEQUENCE, 0,
+                         database.id(), database.version() };
+  CachedMatch result;
+  if (!cache.find(key, result)) {
+    std::vector<uint32_t> everything(database.size());
+    for (size_t i = 0; i < everything.size(); i++) {
+      everything[i] = i;
+    }
+    result.protein = dynamicprogramming_best_of(database, everything, string1);
+    cache.insert(key, result);
+  }
+  return (result.protein == NO_MATCH) ? nullptr : database.protein(result.protein);
+}
@@ -0,0 +1,114 @@
+///////////////////////////////////////////////////////////////////////////////
+// project3_fuzz.cc
+//
+// Differential fuzzing of the dynamic programming engines of project3.hh
+// against the exhaustive searches, on inputs small enough for those.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "fuzz.hh"
+#include "project3.hh"
+
+typedef std::vector<std::string> string_vector;
+
+// Few distinct letters, so that random sequences share subsequences.
+const std::string ALPHABET = "ACDKW";
+
+// The proteins of a fuzz case: every string but the last, which is the query.
+ProteinVector fuzz_database(const string_vector & input)
+{
+	ProteinVector proteins;
+	for (size_t i = 0; i + 1 < input.size(); i++) {
+		proteins.push_back(std::shared_ptr<Protein>(new Protein("p" + std::to_string(i), input[i])));
+	}
+	return proteins;
+}
+
+int main(int argc, char * argv[]) {
+	Fuzzer fuzzer(argc, argv);
+
+	fuzzer.check<string_vector>("longest common subsequence",
+		[](FuzzRng & rng) {
+			string_vector pair;
+			pair.push_back(rng.string(ALPHABET, 0, 9));
+			pair.push_back(rng.string(ALPHABET, 0, 9));
+			return pair;
+		},
+		[](const string_vector & pair) -> std::string {
+			if (pair.size() != 2) {
+				return "";
+			}
+			int expected = exhaustive_longest_common_subsequence(pair[0], pair[1]);
+			std::ostringstream failure;
+			int dp = dynamicprogramming_longest_common_subsequence(pair[0], pair[1]);
+			int packed = dynamicprogramming_longest_common_subsequence(PackedSequence(pair[0]),
+			                                                           PackedSequence(pair[1]));
+			if (dp != expected || packed != expected) {
+				failure << "exhaustive " << expected << ", dp " << dp << ", packed " << packed;
+			}
+			for (int w = 0; w <= 3 && failure.str().empty(); w++) {
+				int banded = dynamicprogramming_longest_common_subsequence_banded(pair[0], pair[1], w);
+				if (banded != expected) {
+					failure << "exhaustive " << expected << ", banded from width " << w << " " << banded;
+				}
+			}
+			return failure.str();
+		},
+		[](const string_vector & pair) {
+			// Keep the pair, only shorten its strings.
+			std::vector<string_vector> candidates;
+			for (const string_vector & smaller : shrink_strings(pair)) {
+				if (smaller.size() == 2) {
+					candidates.push_back(smaller);
+				}
+			}
+			return candidates;
+		},
+		describe_strings);
+
+	fuzzer.check<string_vector>("best match",
+		[](FuzzRng & rng) {
+			string_vector input = rng.words(6, ALPHABET, 0, 8);
+			input.push_back(rng.string(ALPHABET, 1, 6));
+			return input;
+		},
+		[](const string_vector & input) -> std::string {
+			if (input.size() < 2 || input.back().empty()) {
+				return "";
+			}
+			ProteinVector proteins = fuzz_database(input);
+			const std::string & query = input.back();
+			std::shared_ptr<Protein> expected = exhaustive_best_match(proteins, query);
+			KmerIndex index(2);
+			build_kmer_index(index, proteins);
+			SequenceDatabase database(proteins);
+			ResultCache cache;
+			std::shared_ptr<Protein> engines[] = {
+				dynamicprogramming_best_match(proteins, query),
+				dynamicprogramming_best_match(proteins, query, index, proteins.size(), true),
+				dynamicprogramming_best_match(database, query, cache),
+				dynamicprogramming_best_match(database, query, cache)
+			};
+			const char * names[] = { "full scan", "exact seeded", "cache miss", "cache hit" };
+			for (int e = 0; e < 4; e++) {
+				if (engines[e]->description != expected->description) {
+					return std::string(names[e]) + " chose " + engines[e]->description
+						+ ", exhaustive chose " + expected->description;
+				}
+			}
+			std::vector<uint32_t> everything(proteins.size());
+			for (size_t i = 0; i < everything.size(); i++) {
+				everything[i] = i;
+			}
+			size_t best = dynamicprogramming_best_of(database, everything, query);
+			if (database.description(best) != expected->description) {
+				return "database scan chose " + database.description(best)
+					+ ", exhaustive chose " + expected->description;
+			}
+			return "";
+		},
+		shrink_strings,
+		describe_strings);
+
+	return fuzzer.finish();
+}
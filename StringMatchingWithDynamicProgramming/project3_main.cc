@@ -1,11 +1,22 @@
-
+#include "bench.hh"
 #include "project3.hh"
-#include "timer.hh"
 
-int main() {
-	ProteinVector proteins;
-	auto load_successful = load_proteins(proteins, "proteins.txt");
-	assert( load_successful );
+// An optional argument names another FASTA database, such as one written
+// by datagen.
+int main(int argc, char * argv[]) {
+	SequenceDatabase database;
+	const char * path = (argc > 1) ? argv[1] : "proteins.txt";
+	if (!database.load(path)) {
+		std::cerr << "error: cannot load \"" << path << "\"" << std::endl;
+		return 1;
+	}
+	if (database.empty()) {
+		std::cerr << "error: no proteins in \"" << path << "\"" << std::endl;
+		return 1;
+	}
+	// The engines that take a ProteinVector get their own copy of the
+	// proteins; the database searches read the database's arena.
+	ProteinVector proteins = database.to_protein_vector();
 
 	std::vector<std::string> testProteins;
 	testProteins.push_back("QSDITV");
@@ -14,26 +25,125 @@ int main() {
 	testProteins.push_back("AYKDIRNLX");
 	testProteins.push_back("BQSITVARGL");
 
+	// Every search runs under the benchmark harness, which keeps the answer
+	// of the last call; the exhaustive searches take longer than the budget,
+	// so they are run just once.
+	BenchmarkOptions options;
+	options.time_budget = 0.5;
+
 	std::cout << "------------------- Exhaustive Method --------------------" << std::endl;
 	for (int i = 0; i < testProteins.size(); i++) {
 		std::string searchString = 	testProteins[i];
-		Timer timer;
-		std::shared_ptr<Protein> best_protein = exhaustive_best_match(proteins, searchString);
+		std::shared_ptr<Protein> best_protein;
+		BenchmarkResult timing = benchmark("exhaustive_best_match", [&]() {
+			best_protein = exhaustive_best_match(proteins, searchString);
+		}, options);
 		std::cout << "String to Match = " << testProteins[i] << std::endl;
 		std::cout << best_protein->description << std::endl;
-		std::cout << timer.elapsed() << std::endl;
+		std::cout << timing << std::endl;
 	}
 
 	std::cout << "------------------- Dynamic Programming ------------------" << std::endl;
 	for (int i = 0; i < testProteins.size(); i++) {
 		std::string searchString = 	testProteins[i];
-		Timer timer;
+		std::shared_ptr<Protein> best_protein;
+		BenchmarkResult timing = benchmark("dynamicprogramming_best_match", [&]() {
+			best_protein = dynamicprogramming_best_match(proteins, searchString);
+		}, options);
+		std::cout << "String to Match = " << testProteins[i] << std::endl;
+		std::cout << best_protein->description << std::endl;
+		std::cout << timing << std::endl;
+	}
+
+	// The searches share the database's own index, built on the first one.
+	KmerIndex index(2);
+	std::cout << "------------------- K-mer Seeded (k=2, top 100) ----------" << std::endl;
+	std::cout << benchmark("build_kmer_index", [&]() {
+		build_kmer_index(index, proteins);
+	}, options) << std::endl;
+	for (int i = 0; i < testProteins.size(); i++) {
+		std::string searchString = 	testProteins[i];
+		std::shared_ptr<Protein> best_protein;
+		BenchmarkResult timing = benchmark("seeded dynamicprogramming_best_match", [&]() {
+			best_protein = dynamicprogramming_best_match(database, searchString, 100, 2);
+		}, options);
 		std::cout << "String to Match = " << testProteins[i] << std::endl;
-		std::shared_ptr<Protein> best_protein = dynamicprogramming_best_match(proteins, searchString);
 		std::cout << best_protein->description << std::endl;
-		std::cout << timer.elapsed() << std::endl;
+		std::cout << timing << std::endl;
+	}
+
+	// A miss is timed against a cache that starts empty every call, a hit
+	// against one that already holds the answer.
+	ResultCache cache;
+	std::cout << "------------------- Cached (miss, then hit) --------------" << std::endl;
+	for (int i = 0; i < testProteins.size(); i++) {
+		std::shared_ptr<Protein> best_protein = dynamicprogramming_best_match(database, testProteins[i], cache);
+		std::cout << "String to Match = " << testProteins[i] << std::endl;
+		std::cout << best_protein->description << std::endl;
+		std::cout << benchmark("miss", [&]() {
+			ResultCache empty;
+			do_not_optimize(dynamicprogramming_best_match(database, testProteins[i], empty));
+		}, options) << std::endl;
+		std::cout << benchmark("hit", [&]() {
+			do_not_optimize(dynamicprogramming_best_match(database, testProteins[i], cache));
+		}, options) << std::endl;
+	}
+	std::cout << "cache hits " << cache.hits() << ", misses " << cache.misses() << std::endl;
+
+	// Banded LCS against the full table on two kinds of pairs of 500 residue
+	// strings, each made of 50 proteins in a row: a string with a
+	// near-identical copy (a substitution every 50 residues and one deletion
+	// in the middle), which the starting band certifies, and a string with
+	// the next one, which shares no more than chance and which the band
+	// cannot certify.
+	std::cout << "------------------- Banded LCS (w=4) vs Full -------------" << std::endl;
+	std::vector<std::string> runs(1);
+	for (size_t i = 0; i < database.size(); i++) {
+		runs.back() += database.sequence(i);
+		if (runs.back().size() >= 500) {
+			runs.back().resize(500);
+			runs.push_back("");
+		}
+	}
+	runs.pop_back();
+	std::vector<std::string> originals, mutations, neighbours;
+	for (size_t i = 0; i + 1 < runs.size() && originals.size() < 20; i++) {
+		const std::string & original = runs[i];
+		std::string mutated = original;
+		for (size_t k = 25; k < mutated.size(); k += 50) {
+			mutated[k] = (mutated[k] == 'W') ? 'A' : 'W';
+		}
+		mutated.erase(mutated.size() / 2, 1);
+		originals.push_back(original);
+		mutations.push_back(mutated);
+		neighbours.push_back(runs[i + 1]);
+	}
+	const std::vector<std::string> * partners[] = { &mutations, &neighbours };
+	const char * kinds[] = { "near-identical", "dissimilar" };
+	for (int kind = 0; kind < 2; kind++) {
+		const std::vector<std::string> & others = *partners[kind];
+		int mismatches = 0;
+		int widest = 0;
+		for (size_t p = 0; p < originals.size(); p++) {
+			int width;
+			int full = dynamicprogramming_longest_common_subsequence(originals[p], others[p]);
+			int banded = dynamicprogramming_longest_common_subsequence_banded(originals[p], others[p], 4, &width);
+			widest = std::max(widest, width);
+			mismatches += (full != banded);
+		}
+		std::cout << kinds[kind] << ": " << originals.size() << " pairs, widest band " << widest
+				  << ", score mismatches " << mismatches << std::endl;
+		std::cout << benchmark("full", [&]() {
+			for (size_t p = 0; p < originals.size(); p++) {
+				do_not_optimize(dynamicprogramming_longest_common_subsequence(originals[p], others[p]));
+			}
+		}, options) << std::endl;
+		std::cout << benchmark("banded", [&]() {
+			for (size_t p = 0; p < originals.size(); p++) {
+				do_not_optimize(dynamicprogramming_longest_common_subsequence_banded(originals[p], others[p], 4));
+			}
+		}, options) << std::endl;
 	}
 
   return 0;
 }
-
@@ -7,6 +7,8 @@
 
 
 #include <cassert>
+#include <cstdio>
+#include <fstream>
 #include <sstream>
 
 #include "project3.hh"
@@ -23,6 +25,24 @@ int main() {
   rubric.criterion("load_protein still works", 1, [&]() {
 		     TEST_EQUAL("size", 2000, proteins.size());
 		   });
+
+  rubric.criterion("load_proteins multi-line FASTA", 1, [&]() {
+		     const char * path = "multiline_test.fasta";
+		     std::ofstream ofs(path);
+		     ofs << ">first protein\r\nMMRG\nFKQR\n\nLIKK\n"
+		         << ">empty record\n"
+		         << ";comment line\n"
+		         << ">second protein\nAVPS AATT\nST";
+		     ofs.close();
+		     ProteinVector multi;
+		     TEST_TRUE("loaded", load_proteins(multi, path));
+		     std::remove(path);
+		     TEST_EQUAL("size", 2, multi.size());
+		     TEST_EQUAL("description 1", "first protein", multi[0]->description);
+		     TEST_EQUAL("sequence 1", "MMRGFKQRLIKK", multi[0]->sequence);
+		     TEST_EQUAL("description 2", "second protein", multi[1]->description);
+		     TEST_EQUAL("sequence 2", "AVPSAATTST", multi[1]->sequence);
+		   });
   
   rubric.criterion("dynamic programming simple cases", 2,
 		   [&]() {
@@ -105,6 +125,72 @@ int main() {
 		   });
   
 
+  rubric.criterion("packed residues", 2,
+		   [&]() {
+		     PackedSequence packed("MMRGFKQRLIKKTTGSSSSSAVPSaattst*X");
+		     TEST_EQUAL("size", 32, packed.size());
+		     TEST_EQUAL("round trip", "MMRGFKQRLIKKTTGSSSSSAVPSAATTST*X", packed.str());
+		     TEST_EQUAL("code", residue_code('K'), packed[11]);
+		     TEST_EQUAL("unknown", RESIDUE_UNKNOWN, residue_code('#'));
+		     SequenceArena arena;
+		     TEST_TRUE("loaded", load_proteins(arena, "proteins.txt"));
+		     size_t unpacked_bytes = arena.residue_bytes();
+		     std::string first = arena.sequence(0), last = arena.sequence(arena.size() - 1);
+		     arena.pack();
+		     TEST_TRUE("packed", arena.is_packed());
+		     TEST_LT("smaller", arena.residue_bytes(), unpacked_bytes * 7 / 10);
+		     TEST_EQUAL("first", first, arena.sequence(0));
+		     TEST_EQUAL("last", last, arena.sequence(arena.size() - 1));
+		   });
+
+  rubric.criterion("dynamic programming on packed sequences", 2,
+		   [&]() {
+		     for (int i = 0; i + 1 < 40; i++) {
+		       const std::string & a = proteins[i]->sequence;
+		       const std::string & b = proteins[i + 1]->sequence;
+		       TEST_EQUAL("same as characters",
+		                  dynamicprogramming_longest_common_subsequence(a, b),
+		                  dynamicprogramming_longest_common_subsequence(PackedSequence(a),
+		                                                                PackedSequence(b)));
+		     }
+		   });
+
+  rubric.criterion("banded dynamic programming", 2,
+		   [&]() {
+		     int width = -1;
+		     auto soln = dynamicprogramming_longest_common_subsequence_banded("", "", 0);
+		     TEST_EQUAL("empty", 0, soln);
+		     soln = dynamicprogramming_longest_common_subsequence_banded("ABC", "AC", 0);
+		     TEST_EQUAL("deletion B", 2, soln);
+		     soln = dynamicprogramming_longest_common_subsequence_banded("ABCDEFGHIJ", "ABCDXFGHIJ", 1, &width);
+		     TEST_EQUAL("substitution", 9, soln);
+		     TEST_EQUAL("band kept", 1, width);
+		     soln = dynamicprogramming_longest_common_subsequence_banded("ABCDEFGH", "EFGHABCD", 0, &width);
+		     TEST_EQUAL("rotation", 4, soln);
+		     TEST_GE("band widened", width, 4);
+		     std::string original, other;
+		     for (int i = 0; i < 20; i++) {
+		       original += proteins[i]->sequence;
+		       other += proteins[i + 20]->sequence;
+		     }
+		     std::string indel = original;
+		     indel.erase(indel.size() / 2, 1);
+		     soln = dynamicprogramming_longest_common_subsequence_banded(original, indel, 4, &width);
+		     TEST_EQUAL("one deletion", original.size() - 1, soln);
+		     TEST_EQUAL("one deletion band kept", 4, width);
+		     soln = dynamicprogramming_longest_common_subsequence_banded(original, other, 4, &width);
+		     TEST_EQUAL("dissimilar", dynamicprogramming_longest_common_subsequence(original, other), soln);
+		     TEST_EQUAL("dissimilar fills the full table",
+		                static_cast<int>(std::max(original.size(), other.size())), width);
+		     for (int i = 0; i + 1 < 60; i++) {
+		       const std::string & a = proteins[i]->sequence;
+		       std::string b = proteins[i + 1]->sequence.substr(i % 4);
+		       TEST_EQUAL("same as full table",
+		                  dynamicprogramming_longest_common_subsequence(a, b),
+		                  dynamicprogramming_longest_common_subsequence_banded(a, b, i % 3));
+		     }
+		   });
+
   ProteinVector trivial_proteins;
   trivial_proteins.push_back(std::shared_ptr<Protein>(new Protein("Dummy1", "ABCDE")));
   trivial_proteins.push_back(std::shared_ptr<Protein>(new Protein("Dummy2", "FGHIJ")));
@@ -138,6 +224,149 @@ int main() {
 		     TEST_EQUAL("VWX", "UVWXY", best_protein->sequence);
 		   });
 
+  KmerIndex trivial_index(2);
+  build_kmer_index(trivial_index, trivial_proteins);
+
+  rubric.criterion("k-mer seeded best_match", 2,
+		   [&]() {
+		     auto shortlist = trivial_index.candidates("KLMN", 10);
+		     TEST_EQUAL("one candidate", 1, shortlist.size());
+		     TEST_EQUAL("KLMNO", 2, shortlist[0]);
+		     auto best_protein = dynamicprogramming_best_match(trivial_proteins, "ABXDE", trivial_index, 1);
+		     TEST_EQUAL("ABXDE", "ABCDE", best_protein->sequence);
+		     best_protein = dynamicprogramming_best_match(trivial_proteins, "LHIJ", trivial_index, 1);
+		     TEST_EQUAL("KLHIJ", "FGHIJ", best_protein->sequence);
+		     best_protein = dynamicprogramming_best_match(trivial_proteins, "VAX", trivial_index, 1);
+		     TEST_EQUAL("no seed falls back", "UVWXY", best_protein->sequence);
+		     best_protein = dynamicprogramming_best_match(trivial_proteins, "VWX", trivial_index, 1, true);
+		     TEST_EQUAL("exact", "UVWXY", best_protein->sequence);
+		     TEST_EQUAL("no candidates", NO_MATCH,
+		                dynamicprogramming_best_of(trivial_proteins, std::vector<uint32_t>(), "ABXDE"));
+		     ProteinVector none;
+		     KmerIndex empty_index(3);
+		     empty_index.build();
+		     TEST_TRUE("empty database", dynamicprogramming_best_match(none, "ABXDE", empty_index, 1) == nullptr);
+		     ResultCache cache;
+		     TEST_TRUE("empty database cached",
+		               dynamicprogramming_best_match(SequenceDatabase(), "ABXDE", cache) == nullptr);
+		   });
+
+  rubric.criterion("best_match result cache", 2,
+		   [&]() {
+		     SequenceDatabase trivial(trivial_proteins);
+		     ResultCache cache;
+		     auto best_protein = dynamicprogramming_best_match(trivial, "ABXDE", cache);
+		     TEST_EQUAL("ABXDE", "ABCDE", best_protein->sequence);
+		     best_protein = dynamicprogramming_best_match(trivial, "ABXDE", cache);
+		     TEST_EQUAL("ABXDE again", "ABCDE", best_protein->sequence);
+		     best_protein = dynamicprogramming_best_match(trivial, "VWX", cache);
+		     TEST_EQUAL("VWX", "UVWXY", best_protein->sequence);
+		     TEST_EQUAL("hits", 1, cache.hits());
+		     TEST_EQUAL("misses", 2, cache.misses());
+		     TEST_EQUAL("entries", 2, cache.size());
+
+		     // Other databases come and go without touching its entries.
+		     ProteinVector unrelated;
+		     TEST_TRUE("unrelated load", load_proteins(unrelated, "proteins.txt"));
+		     SequenceDatabase other(trivial_proteins);
+		     other.changed();
+		     dynamicprogramming_best_match(other, "ABXDE", cache);
+		     dynamicprogramming_best_match(trivial, "ABXDE", cache);
+		     TEST_EQUAL("other databases kept apart", 3, cache.misses());
+		     TEST_EQUAL("still a hit", 2, cache.hits());
+		     TEST_EQUAL("nothing invalidated", 0, cache.invalidations());
+
+		     trivial.changed();
+		     best_protein = dynamicprogramming_best_match(trivial, "ABXDE", cache);
+		     TEST_EQUAL("change invalidates", 4, cache.misses());
+		     TEST_EQUAL("invalidations", 1, cache.invalidations());
+		     TEST_EQUAL("only its own entries", 2, cache.size());
+
+		     ResultCache small(2 * ResultCache::ENTRY_OVERHEAD + 16);
+		     dynamicprogramming_best_match(trivial, "ABXDE", small);
+		     dynamicprogramming_best_match(trivial, "KLMN", small);
+		     dynamicprogramming_best_match(trivial, "ABXDE", small);
+		     dynamicprogramming_best_match(trivial, "VWX", small);
+		     TEST_EQUAL("evicted", 1, small.evictions());
+		     TEST_LE("budget", small.bytes(), small.memory_budget());
+		     dynamicprogramming_best_match(trivial, "ABXDE", small);
+		     TEST_EQUAL("recently used kept", 2, small.hits());
+		   });
+
+  rubric.criterion("sequence database", 1,
+		   [&]() {
+		     SequenceDatabase database(trivial_proteins);
+		     TEST_EQUAL("size", trivial_proteins.size(), database.size());
+		     const KmerIndex & index = database.kmer_index(2);
+		     TEST_TRUE("index built once", &index == &database.kmer_index(2));
+		     TEST_EQUAL("indexes every protein", database.size(), index.size());
+		     auto best_protein = dynamicprogramming_best_match(database, "ABXDE", 1, 2);
+		     TEST_EQUAL("seeded", "ABCDE", best_protein->sequence);
+		     SequenceDatabase nothing;
+		     TEST_TRUE("empty database", dynamicprogramming_best_match(nothing, "ABXDE", 1, 2) == nullptr);
+		     uint8_t codes[5];
+		     database.codes(4, codes);
+		     TEST_EQUAL("codes", residue_code('U'), codes[0]);
+		     TEST_EQUAL("offsets", 20, database.offset(4));
+		     TEST_EQUAL("residues", 25, database.residue_count());
+		     TEST_TRUE("characters kept next to the codes",
+		               database.residue_bytes() >= 25 + 3 * sizeof(uint64_t));
+
+		     std::string path = "sequence_database_test.txt";
+		     TEST_TRUE("saved", database.save(path));
+		     SequenceDatabase reloaded;
+		     TEST_TRUE("loaded", reloaded.load(path));
+		     std::remove(path.c_str());
+		     TEST_EQUAL("round trip", database.size(), reloaded.size());
+		     for (size_t i = 0; i < database.size(); i++) {
+		       TEST_EQUAL("descriptions", database[i]->description, reloaded[i]->description);
+		       TEST_EQUAL("sequences", database[i]->sequence, reloaded[i]->sequence);
+		     }
+
+		     // Lower case and characters that are not residues survive a
+		     // load and save unchanged, and are compared as they are.
+		     std::string contents = ">lower case\nmkvlaxx-ab\n>Odd ONES\nMK-x-#VL\n";
+		     {
+		       std::ofstream out(path.c_str(), std::ios::binary);
+		       out << contents;
+		     }
+		     SequenceDatabase odd;
+		     TEST_TRUE("loaded odd", odd.load(path));
+		     std::string saved_path = "sequence_database_saved.txt";
+		     TEST_TRUE("saved odd", odd.save(saved_path));
+		     std::ifstream in(saved_path.c_str(), std::ios::binary);
+		     std::stringstream saved;
+		     saved << in.rdbuf();
+		     in.close();
+		     std::remove(path.c_str());
+		     std::remove(saved_path.c_str());
+		     TEST_EQUAL("saved unchanged", contents, saved.str());
+		     TEST_EQUAL("case kept", "mkvlaxx-ab", odd.sequence(0));
+		     ProteinVector odd_proteins = odd.to_protein_vector();
+		     const char * queries[] = { "MKVL", "x-x", "#-", "mk" };
+		     for (const char * query : queries) {
+		       std::vector<uint32_t> both = { 0, 1 };
+		       TEST_EQUAL("characters compared as they are",
+		                  dynamicprogramming_best_match(odd_proteins, query)->description,
+		                  odd.description(dynamicprogramming_best_of(odd, both, query)));
+		     }
+		   });
+
+  rubric.criterion("scratch arena reuse", 2,
+		   [&]() {
+		     ProteinVector few(proteins.begin(), proteins.begin() + 200);
+		     AlignmentContext & context = AlignmentContext::for_thread();
+		     std::string query = few[17]->sequence.substr(5, 20);
+		     auto first = dynamicprogramming_best_match(few, query);
+		     size_t allocations = context.allocations();
+		     size_t frames = context.frames();
+		     auto second = dynamicprogramming_best_match(few, query);
+		     TEST_EQUAL("same answer", first, second);
+		     TEST_EQUAL("one table per protein", frames + few.size(), context.frames());
+		     TEST_EQUAL("no allocations once warm", allocations, context.allocations());
+		     TEST_EQUAL("table reused", 5, dynamicprogramming_longest_common_subsequence("ABCDEFG", "XBCDYEF"));
+		   });
+
   return rubric.run();
 }
 
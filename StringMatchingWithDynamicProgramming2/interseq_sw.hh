@@ -0,0 +1,289 @@
+///////////////////////////////////////////////////////////////////////////////
+// interseq_sw.hh
+//
+// Inter-sequence SIMD Smith-Waterman: one query against a batch of targets
+// at once, one target per vector lane. Unlike the striped kernel, whose
+// vectors run down the query, this keeps every lane busy however short the
+// query is, which suits scanning a database with short queries.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "residues.hh"
+#include "striped_sw.hh"
+
+#ifdef STRIPED_SW_X86
+
+#pragma GCC push_options
+#pragma GCC target("ssse3")
+namespace interseq_ssse3 {
+
+struct Ops {
+	typedef __m128i V;
+	enum { LANES = 16 };
+	static V zero() { return _mm_setzero_si128(); }
+	static V set1(int x) { return _mm_set1_epi8(static_cast<char>(x)); }
+	static V load(const uint8_t * p) { return _mm_loadu_si128(reinterpret_cast<const V *>(p)); }
+	static void store(uint8_t * p, V v) { _mm_storeu_si128(reinterpret_cast<V *>(p), v); }
+	static V table(const uint8_t * p) { return load(p); }
+	static V bit_and(V a, V b) { return _mm_and_si128(a, b); }
+	static V equal(V a, V b) { return _mm_cmpeq_epi8(a, b); }
+	static V adds(V a, V b) { return _mm_adds_epu8(a, b); }
+	static V subs(V a, V b) { return _mm_subs_epu8(a, b); }
+	static V max(V a, V b) { return _mm_max_epu8(a, b); }
+	// Entry codes[k] of the 32-entry table split into low and high; codes
+	// with bit 7 set read as 0.
+	static V lookup(V low, V high, V codes, V high_half) {
+		return _mm_or_si128(_mm_and_si128(high_half, _mm_shuffle_epi8(high, codes)),
+							_mm_andnot_si128(high_half, _mm_shuffle_epi8(low, codes)));
+	}
+};
+
+#include "interseq_sw_kernel.inl"
+
+void scores(const uint8_t * rows, const uint8_t * up_open, const uint8_t * up_extend,
+			const uint8_t * left_open, const uint8_t * left_extend, int n,
+			const uint8_t * codes, int length, int stride, int bias,
+			uint8_t * column, uint8_t * e, uint8_t * best)
+{
+	interseq_scores<Ops>(rows, up_open, up_extend, left_open, left_extend, n,
+						 codes, length, stride, bias, column, e, best);
+}
+
+} // namespace interseq_ssse3
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+namespace interseq_avx2 {
+
+struct Ops {
+	typedef __m256i V;
+	enum { LANES = 32 };
+	static V zero() { return _mm256_setzero_si256(); }
+	static V set1(int x) { return _mm256_set1_epi8(static_cast<char>(x)); }
+	static V load(const uint8_t * p) { return _mm256_loadu_si256(reinterpret_cast<const V *>(p)); }
+	static void store(uint8_t * p, V v) { _mm256_storeu_si256(reinterpret_cast<V *>(p), v); }
+	// vpshufb looks up within each 128-bit half, so both get the table.
+	static V table(const uint8_t * p) {
+		return _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)));
+	}
+	static V bit_and(V a, V b) { return _mm256_and_si256(a, b); }
+	static V equal(V a, V b) { return _mm256_cmpeq_epi8(a, b); }
+	static V adds(V a, V b) { return _mm256_adds_epu8(a, b); }
+	static V subs(V a, V b) { return _mm256_subs_epu8(a, b); }
+	static V max(V a, V b) { return _mm256_max_epu8(a, b); }
+	static V lookup(V low, V high, V codes, V high_half) {
+		return _mm256_blendv_epi8(_mm256_shuffle_epi8(low, codes),
+								  _mm256_shuffle_epi8(high, codes), high_half);
+	}
+};
+
+#include "interseq_sw_kernel.inl"
+
+void scores(const uint8_t * rows, const uint8_t * up_open, const uint8_t * up_extend,
+			const uint8_t * left_open, const uint8_t * left_extend, int n,
+			const uint8_t * codes, int length, int stride, int bias,
+			uint8_t * column, uint8_t * e, uint8_t * best)
+{
+	interseq_scores<Ops>(rows, up_open, up_extend, left_open, left_extend, n,
+						 codes, length, stride, bias, column, e, best);
+}
+
+} // namespace interseq_avx2
+#pragma GCC pop_options
+
+#endif // STRIPED_SW_X86
+
+// -------------------------------------------------------------------------
+// A set of target sequences laid out for the inter-sequence kernel. The
+// targets are sorted by length and cut into batches of LANES, so that the
+// lanes of a batch finish at about the same time; each batch is stored
+// transposed, residue j of every lane side by side, and padded with
+// PAD_CODE up to the length of its longest target.
+// -------------------------------------------------------------------------
+class SequenceBatches {
+public:
+	enum { LANES = 32, PAD_CODE = 0x80 };
+
+	struct Batch {
+		size_t		offset;		// into the transposed codes
+		int			length;		// of the longest target
+		int			count;		// targets in the batch, up to LANES
+		uint32_t	ids[LANES];	// target numbers, lane by lane
+		int			lengths[LANES];
+		uint32_t	residues[LANES];	// bit c set when code c occurs
+	};
+
+	SequenceBatches() : _size(0) { }
+
+	// Lay out count targets; target t is lengths[t] codes at sequences[t].
+	void build(const std::vector<const uint8_t *> & sequences, const std::vector<int> & lengths) {
+		_size = sequences.size();
+		std::vector<uint32_t> order(_size);
+		for (size_t t = 0; t < _size; t++) {
+			order[t] = t;
+		}
+		std::stable_sort(order.begin(), order.end(), [&lengths](uint32_t a, uint32_t b) {
+			return lengths[a] < lengths[b];
+		});
+
+		_batches.clear();
+		_codes.clear();
+		for (size_t first = 0; first < _size; first += LANES) {
+			Batch batch;
+			batch.offset = _codes.size();
+			batch.count = std::min<size_t>(LANES, _size - first);
+			batch.length = 0;
+			for (int lane = 0; lane < LANES; lane++) {
+				batch.ids[lane] = (lane < batch.count) ? order[first + lane] : 0;
+				batch.lengths[lane] = (lane < batch.count) ? lengths[batch.ids[lane]] : 0;
+				batch.length = std::max(batch.length, batch.lengths[lane]);
+				batch.residues[lane] = 0;
+			}
+			_codes.resize(batch.offset + static_cast<size_t>(batch.length) * LANES, PAD_CODE);
+			for (int lane = 0; lane < batch.count; lane++) {
+				const uint8_t * sequence = sequences[batch.ids[lane]];
+				for (int j = 0; j < batch.lengths[lane]; j++) {
+					_codes[batch.offset + j * LANES + lane] = sequence[j];
+					batch.residues[lane] |= 1u << sequence[j];
+				}
+			}
+			_batches.push_back(batch);
+		}
+	}
+
+	size_t size() const {
+		return _size;
+	}
+
+	const std::vector<Batch> & batches() const {
+		return _batches;
+	}
+
+	const uint8_t * codes(const Batch & batch) const {
+		return _codes.data() + batch.offset;
+	}
+
+	// Copy target lane of a batch back out into contiguous codes.
+	void extract(const Batch & batch, int lane, std::vector<uint8_t> & sequence) const {
+		sequence.resize(batch.lengths[lane]);
+		for (int j = 0; j < batch.lengths[lane]; j++) {
+			sequence[j] = _codes[batch.offset + j * LANES + lane];
+		}
+	}
+
+	size_t storage_bytes() const {
+		return _codes.capacity() + _batches.capacity() * sizeof(Batch);
+	}
+
+private:
+	size_t					_size;
+	std::vector<Batch>		_batches;
+	std::vector<uint8_t>	_codes;
+};
+
+// -------------------------------------------------------------------------
+// Local alignment scores of one query against every target of batches,
+// indexed by target number; the same values StripedQuery::score gives.
+// Lanes that saturate 8 bits are rescored with a StripedQuery, as are
+// targets holding a residue with a positive gap penalty, and every target
+// when the path has no inter-sequence kernel (scalar, or a 128-bit machine
+// without SSSE3) or the query has a residue with a positive gap penalty.
+// -------------------------------------------------------------------------
+std::vector<int> interseq_scores(const SequenceBatches & batches,
+								 const uint8_t * query, int n,
+								 const PenaltyTable & penalties,
+								 SimdPath path = SIMD_AUTO,
+								 const GapModel & gaps = GapModel())
+{
+	path = (path == SIMD_AUTO) ? best_simd_path() : path;
+	std::vector<int> result(batches.size(), 0);
+	StripedQuery fallback(query, n, penalties, path, gaps);
+	std::vector<uint8_t> target;
+
+	// Costs of the gap model as amounts to subtract, and the biased rows.
+	auto cost = [](int penalty) { return std::min(255, std::max(0, -penalty)); };
+	uint8_t left_open[32], left_extend[32];
+	uint32_t positive_left_gaps = 0;
+	for (int code = 0; code < 32; code++) {
+		left_open[code] = cost(gaps.left_open(penalties, code));
+		left_extend[code] = cost(gaps.left_extend(penalties, code));
+		if (gaps.left_open(penalties, code) > 0 || gaps.left_extend(penalties, code) > 0) {
+			positive_left_gaps |= 1u << code;
+		}
+	}
+	bool usable = (n > 0);
+	std::vector<uint8_t> up_open(n), up_extend(n), rows(n * 32);
+	int lowest = 0;
+	for (int i = 0; i < n; i++) {
+		up_open[i] = cost(gaps.up_open(penalties, query[i]));
+		up_extend[i] = cost(gaps.up_extend(penalties, query[i]));
+		usable = usable && gaps.up_open(penalties, query[i]) <= 0 &&
+			gaps.up_extend(penalties, query[i]) <= 0;
+		for (int code = 0; code < 32; code++) {
+			lowest = std::min(lowest, static_cast<int>(penalties[query[i]][code]));
+		}
+	}
+	int bias = -lowest;
+	for (int i = 0; i < n; i++) {
+		for (int code = 0; code < 32; code++) {
+			rows[i * 32 + code] = penalties[query[i]][code] + bias;
+		}
+	}
+
+#ifdef STRIPED_SW_X86
+	int width = 0;
+	if (path == SIMD_AVX2) {
+		width = 32;
+	}
+	else if (path == SIMD_SSE2 && __builtin_cpu_supports("ssse3")) {
+		width = 16;
+	}
+	usable = usable && width > 0;
+	std::vector<uint8_t> column(n * width), e(n * width);
+	uint8_t best[SequenceBatches::LANES];
+#else
+	usable = false;
+#endif
+
+	for (const SequenceBatches::Batch & batch : batches.batches()) {
+#ifdef STRIPED_SW_X86
+		if (usable) {
+			for (int first = 0; first < batch.count; first += width) {
+				const uint8_t * codes = batches.codes(batch) + first;
+				if (width == 32) {
+					interseq_avx2::scores(rows.data(), up_open.data(), up_extend.data(),
+										  left_open, left_extend, n, codes, batch.length,
+										  SequenceBatches::LANES, bias,
+										  column.data(), e.data(), best + first);
+				}
+				else {
+					interseq_ssse3::scores(rows.data(), up_open.data(), up_extend.data(),
+										   left_open, left_extend, n, codes, batch.length,
+										   SequenceBatches::LANES, bias,
+										   column.data(), e.data(), best + first);
+				}
+			}
+		}
+#endif
+		for (int lane = 0; lane < batch.count; lane++) {
+#ifdef STRIPED_SW_X86
+			if (usable && best[lane] + bias < 255 &&
+				(batch.residues[lane] & positive_left_gaps) == 0) {
+				result[batch.ids[lane]] = best[lane];
+				continue;
+			}
+#endif
+			batches.extract(batch, lane, target);
+			result[batch.ids[lane]] = fallback.score(target.data(), target.size());
+		}
+	}
+	return result;
+}
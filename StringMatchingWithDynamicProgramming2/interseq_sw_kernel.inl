@@ -0,0 +1,76 @@
+///////////////////////////////////////////////////////////////////////////////
+// interseq_sw_kernel.inl
+//
+// Body of the inter-sequence Smith-Waterman score kernel. interseq_sw.hh
+// includes this file once per instruction set, inside a namespace that
+// defines the vector operations (Ops) for it.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// -------------------------------------------------------------------------
+// One query against Ops::LANES targets at once, one target per byte lane,
+// with Gotoh affine gaps (linear gaps are open == extend).
+//
+// rows holds, for each query position, the 32 penalties of that residue
+// against every residue code, plus bias. codes is the batch transposed:
+// residue j of every lane, then residue j + 1, stride bytes apart; lanes
+// past the end of their target hold a code with bit 7 set, which the table
+// lookup turns into a score of -bias and a free gap, so a finished target
+// can never raise its best score. left_open/left_extend are the 32 costs of
+// skipping a target residue, up_open/up_extend the n costs of skipping a
+// query residue. column and e are n vectors of scratch each. best receives
+// the best cell of every lane, saturated at 255 - bias.
+// -------------------------------------------------------------------------
+template <class Ops>
+void interseq_scores(const uint8_t * rows,
+					 const uint8_t * up_open,
+					 const uint8_t * up_extend,
+					 const uint8_t * left_open,
+					 const uint8_t * left_extend,
+					 int n,
+					 const uint8_t * codes, int length, int stride,
+					 int bias,
+					 uint8_t * column, uint8_t * e,
+					 uint8_t * best)
+{
+	typedef typename Ops::V V;
+	const int lanes = Ops::LANES;
+	const V zero = Ops::zero();
+	const V vBias = Ops::set1(bias);
+	const V vHigh = Ops::set1(16);
+	const V vLeftOpenLow = Ops::table(left_open), vLeftOpenHigh = Ops::table(left_open + 16);
+	const V vLeftExtendLow = Ops::table(left_extend), vLeftExtendHigh = Ops::table(left_extend + 16);
+	V vMax = zero;
+
+	for (int i = 0; i < n; i++) {
+		Ops::store(column + i * lanes, zero);
+		Ops::store(e + i * lanes, zero);
+	}
+
+	for (int j = 0; j < length; j++) {
+		const V vCodes = Ops::load(codes + j * stride);
+		const V vHighHalf = Ops::equal(Ops::bit_and(vCodes, vHigh), vHigh);
+		const V vLeftOpen = Ops::lookup(vLeftOpenLow, vLeftOpenHigh, vCodes, vHighHalf);
+		const V vLeftExtend = Ops::lookup(vLeftExtendLow, vLeftExtendHigh, vCodes, vHighHalf);
+		V vDiag = zero;
+		V vUp = zero;
+		V vF = zero;
+
+		for (int i = 0; i < n; i++) {
+			const uint8_t * row = rows + i * 32;
+			V vScore = Ops::lookup(Ops::table(row), Ops::table(row + 16), vCodes, vHighHalf);
+			V vLeft = Ops::load(column + i * lanes);
+			V vE = Ops::max(Ops::subs(vLeft, vLeftOpen), Ops::subs(Ops::load(e + i * lanes), vLeftExtend));
+			Ops::store(e + i * lanes, vE);
+			vF = Ops::max(Ops::subs(vUp, Ops::set1(up_open[i])), Ops::subs(vF, Ops::set1(up_extend[i])));
+			V vH = Ops::subs(Ops::adds(vDiag, vScore), vBias);
+			vH = Ops::max(Ops::max(vH, vE), vF);
+			vMax = Ops::max(vMax, vH);
+			Ops::store(column + i * lanes, vH);
+			vDiag = vLeft;
+			vUp = vH;
+		}
+	}
+
+	Ops::store(best, vMax);
+}
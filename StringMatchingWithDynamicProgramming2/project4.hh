@@ -10,37 +10,49 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cctype>
+#include <climits>
 #include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
-#include <map>
+#include <iterator>
 #include <memory>
 #include <queue>
 #include <sstream>
 #include <string>
 #include <vector>
 
-// Simple structure for a single protein
-struct Protein {
-	Protein() {
-		description = "";
-		sequence = "";
-	}
-	Protein(std::string desc, std::string seq) {
-		description = desc;
-		sequence = seq;
-	}
-	std::string		description;
-	std::string 	sequence;
-};
+#include "alignment_context.hh"
+#include "fasta.hh"
+#include "kmer_index.hh"
+#include "residues.hh"
+#include "result_cache.hh"
+#include "scoring_matrix.hh"
+#include "sequence_database.hh"
+#include "interseq_sw.hh"
+#include "striped_sw.hh"
+#include "trace.hh"
 
 // class for BLOSUM penalties.. acts as a matrix holding penalties based 
 //     on transitions for one amino acid to another
+//
+// The penalties live in a dense 32x32 table indexed by the residue codes of
+// residues.hh, so a lookup is two table reads instead of two map searches.
+// Lower case letters share the entries of their upper case letter, and all
+// characters outside the residue alphabet share one row and column.
+// Unset entries are 0.
 class BlosumPenaltyArray {
 public:
 	BlosumPenaltyArray() {
-		// nothing here
+		_codes = residue_code_table();
+		std::memset(_penalties, 0, sizeof(_penalties));
+		_used = 0;
+		_version = next_version();
 	}
 	~BlosumPenaltyArray() {
 		// nothing here
@@ -53,18 +65,75 @@ public:
 		return *this;
 	}
 
-	int get_penalty(char c1, char c2) {
-		return _penaltyMap[c1][c2];
+	int get_penalty(char c1, char c2) const {
+		return _penalties[_codes[static_cast<unsigned char>(c1)]]
+						 [_codes[static_cast<unsigned char>(c2)]];
+	}
+
+	// Penalty between two residue codes from residues.hh.
+	int get_code_penalty(uint8_t c1, uint8_t c2) const {
+		return _penalties[c1][c2];
 	}
 
-	void set_penalty(char c1, char c2, int penalty) {
-		_penaltyMap[c1][c2] = penalty;
+	// The whole table, indexed by residue codes, for the SIMD kernels.
+	const PenaltyTable & penalty_table() const {
+		return _penalties;
 	}
 
+	// The table holds int8_t penalties, which the SIMD kernels rely on: a
+	// penalty outside that range is rejected, returning false and leaving
+	// the table as it was.
+	bool set_penalty(char c1, char c2, int penalty) {
+		if (!penalty_in_range(penalty)) {
+			return false;
+		}
+		uint8_t code1 = residue_code(c1);
+		uint8_t code2 = residue_code(c2);
+		_penalties[code1][code2] = penalty;
+		_used |= (1u << code1) | (1u << code2);
+		_version = next_version();
+		return true;
+	}
+
+	static bool penalty_in_range(long penalty) {
+		return penalty >= INT8_MIN && penalty <= INT8_MAX;
+	}
+
+	// Set the penalties between every pair of the size residues of alphabet
+	// at once; penalties holds them row by row.
+	void set_penalties(const char * alphabet, int size, const int8_t * penalties) {
+		for (int row = 0; row < size; row++) {
+			uint8_t code1 = residue_code(alphabet[row]);
+			for (int column = 0; column < size; column++) {
+				_penalties[code1][residue_code(alphabet[column])] = penalties[row * size + column];
+			}
+			_used |= 1u << code1;
+		}
+		_version = next_version();
+	}
+
+	// Bit c is set when residue code c has been given penalties.
+	uint32_t used_codes() const {
+		return _used;
+	}
+
+	// Identifies the current penalties: two arrays with the same version
+	// hold the same values. Changes whenever a penalty is set.
+	uint64_t version() const {
+		return _version;
+	}
+
+	// Print the rows and columns of every residue that has been given a
+	// penalty, in residue code order.
 	void debug_map() {
-		for (auto itr1 = _penaltyMap.begin(); itr1 != _penaltyMap.end(); itr1++) {
-			for (auto itr2 = itr1->second.begin(); itr2 != itr1->second.end(); itr2++) {
-				std::cout << itr2->second << "  ";
+		for (int row = 0; row < RESIDUE_CODES; row++) {
+			if (!(_used & (1u << row))) {
+				continue;
+			}
+			for (int column = 0; column < RESIDUE_CODES; column++) {
+				if (_used & (1u << column)) {
+					std::cout << int(_penalties[row][column]) << "  ";
+				}
 			}
 			std::cout << std::endl;
 		}
@@ -72,208 +141,300 @@ public:
 
 private:
 	void internal_copy(BlosumPenaltyArray & that) {
-		this->_penaltyMap = that._penaltyMap;
+		this->_codes = that._codes;
+		std::memcpy(this->_penalties, that._penalties, sizeof(_penalties));
+		this->_used = that._used;
+		this->_version = that._version;
 	}
 
-	std::map<char, std::map<char, int>> _penaltyMap;
+	static uint64_t next_version() {
+		static std::atomic<uint64_t> counter(0);
+		return ++counter;
+	}
+
+	alignas(64) PenaltyTable _penalties;
+	const uint8_t * _codes;
+	uint32_t _used;
+	uint64_t _version;
 };
 
 
-// Alias for a vector of shared pointers to Protein objects.
-typedef std::vector<std::shared_ptr<Protein>> ProteinVector;
+// The alignment kernel runs either on raw characters or on residue codes;
+// these traits supply the gap symbol, the output letter and the penalty
+// lookup for each representation.
+template <typename Residue> struct ResidueTraits;
+
+template <> struct ResidueTraits<char> {
+	static char gap() { return '*'; }
+	static char letter(char c) { return c; }
+	static int penalty(const BlosumPenaltyArray & bpa, char c1, char c2) {
+		return bpa.get_penalty(c1, c2);
+	}
+};
 
+template <> struct ResidueTraits<uint8_t> {
+	static uint8_t gap() { return RESIDUE_GAP; }
+	static char letter(uint8_t code) { return residue_letter(code); }
+	static int penalty(const BlosumPenaltyArray & bpa, uint8_t c1, uint8_t c2) {
+		return bpa.get_code_penalty(c1, c2);
+	}
+};
 
 // -------------------------------------------------------------------------
-// Load all the proteins from a standard FASTA format file with one line
-// per sequence (multi-line sequences are not allowed).
-// Returns false on I/O error.
+// Lay every protein out for the inter-sequence kernel; protein i of the
+// vector becomes target i of the batches.
 // -------------------------------------------------------------------------
-bool load_proteins(ProteinVector & proteins, const std::string& path) 
+void build_sequence_batches(SequenceBatches & batches, const ProteinVector & proteins)
 {
-  //std::cout << "Loading proteins from [" << path << "]" << std::endl;
-  proteins.clear();
-  std::ifstream ifs(path.c_str());
-  if (!ifs.is_open() || !ifs.good()) {
-    std::cout << "Failed to open [" << path << "]" << std::endl;
-    return false;
+  std::vector<std::vector<uint8_t>> codes(proteins.size());
+  std::vector<const uint8_t *> sequences(proteins.size());
+  std::vector<int> lengths(proteins.size());
+  for (size_t i = 0; i < proteins.size(); i++) {
+    const std::string & sequence = proteins[i]->sequence;
+    codes[i].resize(sequence.size());
+    encode_residues(sequence.data(), sequence.size(), codes[i].data());
+    sequences[i] = codes[i].data();
+    lengths[i] = sequence.size();
   }
-  int proteinsLoaded = 0;
-  bool have_description = false;
-  std::shared_ptr<Protein> newProtein = nullptr;
-  while (!ifs.eof()) {
-    std::string lineBuffer;
-    std::getline(ifs, lineBuffer);
-    if (ifs.eof()) {
-      break;
-    }
-    if (lineBuffer.size() == 0) {
-		continue;
-	}
-    if (lineBuffer[0] == '>') {
-		newProtein = std::shared_ptr<Protein>(new Protein);
-		newProtein->description = lineBuffer.substr(1);
-        have_description = true;
-    } else if (have_description) {
-		newProtein->sequence = lineBuffer;
-	    proteins.push_back(newProtein);
-        proteinsLoaded++;
-        have_description = false;
-    }
-  }
-
-	ifs.close();
-
-  return true;
+  batches.build(sequences, lengths);
 }
 
 // -------------------------------------------------------------------------
-// Load all the proteins from a standard FASTA format file with one line
-// per sequence (multi-line sequences are not allowed).
-// Returns false on I/O error.
+// Same, from the database's arena: every protein is decoded once into one
+// buffer, at the offsets the arena gives it, which is dropped again once
+// the batches hold their transposed copy.
 // -------------------------------------------------------------------------
-bool save_proteins(ProteinVector & proteins, const std::string& path) 
+void build_sequence_batches(SequenceBatches & batches, const SequenceDatabase & database)
 {
-	std::cout << "Saving proteins from [" << path << "]" << std::endl;
-	std::ofstream ofs(path.c_str());
-	if (!ofs.is_open() || !ofs.good()) {
-		std::cout << "Failed to open [" << path << "]" << std::endl;
-		return false;
-	}
-
-	for (int i = 0; i < proteins.size(); i++) {
-		ofs << proteins[i]->description << std::endl;
-		ofs << proteins[i]->sequence.substr(10,10) << std::endl;
-	}
-
-	ofs.close();
-
-  return true;
+  std::vector<uint8_t> codes(database.residue_count());
+  std::vector<const uint8_t *> sequences(database.size());
+  std::vector<int> lengths(database.size());
+  for (size_t i = 0; i < database.size(); i++) {
+    sequences[i] = codes.data() + database.offset(i);
+    lengths[i] = database.length(i);
+    database.codes(i, codes.data() + database.offset(i));
+  }
+  batches.build(sequences, lengths);
 }
 
 // -------------------------------------------------------------------------
-// Load the BLOSUM penalties from a standard BLOSUM file (matrix format)
-// Returns false on I/O error.
+// Load a substitution matrix from a file into the dense table of bpa. Three
+// formats are read:
+//   - the binary format of scoring_matrix.hh, as save_scoring_matrix writes;
+//   - the text format of blosum62.txt, a "$" line with the residue letters
+//     followed by one line per row, starting with the row's letter;
+//   - NCBI's, as in the BLOSUM and PAM files that come with BLAST, which is
+//     the same except that the letter line is indented and lines starting
+//     with "#" are comments.
+// Returns false on I/O error, a malformed matrix or a penalty that does
+// not fit the table's int8_t entries.
 // -------------------------------------------------------------------------
 bool load_blosum_file(BlosumPenaltyArray & bpa, const std::string& path) 
 {
-  std::ifstream ifs(path.c_str());
+  TRACE_SCOPE("load_blosum_file");
+  std::ifstream ifs(path.c_str(), std::ios::binary);
   if (!ifs.is_open() || !ifs.good()) {
     std::cout << "Failed to open [" << path << "]" << std::endl;
     return false;
   }
+  std::string contents((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
 
-  std::vector<char> aas; // Create vector to hold our Amino Acids
+  std::string alphabet;
+  std::vector<int8_t> penalties;
+  if (contents.compare(0, SCORING_MATRIX_MAGIC_SIZE, SCORING_MATRIX_MAGIC) == 0) {
+    size_t header = SCORING_MATRIX_MAGIC_SIZE + 1;
+    size_t size = (contents.size() >= header) ? static_cast<uint8_t>(contents[header - 1]) : 0;
+    if (size == 0 || contents.size() != header + size + size * size) {
+      std::cout << "Malformed matrix [" << path << "]" << std::endl;
+      return false;
+    }
+    bpa.set_penalties(contents.data() + header, size,
+                      reinterpret_cast<const int8_t *>(contents.data() + header + size));
+    return true;
+  }
 
-  while (!ifs.eof()) {
-    std::string lineBuffer;
-    std::getline(ifs, lineBuffer);
-    if (ifs.eof()) {
-      break;
+  // Text: the letter line, then the rows in any order.
+  std::vector<bool> seen;
+  size_t rows = 0;
+  for (size_t from = 0, to = 0; from < contents.size(); from = to + 1) {
+    to = contents.find('\n', from);
+    to = (to == std::string::npos) ? contents.size() : to;
+    std::string line = contents.substr(from, to - from);
+    size_t start = line.find_first_not_of(" \t\r");
+    if (start == std::string::npos || line[start] == '#') {
+      continue;
     }
-    if (lineBuffer.size() == 0) {
-		continue;
-	}
+    if (alphabet.empty()) {
+      for (size_t i = start + (line[start] == '$'); i < line.size(); i++) {
+        if (!std::isspace(static_cast<unsigned char>(line[i]))) {
+          alphabet += line[i];
+        }
+      }
+      penalties.assign(alphabet.size() * alphabet.size(), 0);
+      seen.assign(alphabet.size(), false);
+      continue;
+    }
+    size_t row = alphabet.find(line[start]);
+    if (row == std::string::npos || seen[row]) {
+      std::cout << "Malformed matrix [" << path << "]" << std::endl;
+      return false;
+    }
+    const char * cursor = line.c_str() + start + 1;
+    for (size_t column = 0; column < alphabet.size(); column++) {
+      char * end;
+      long penalty = std::strtol(cursor, &end, 10);
+      if (end == cursor) {
+        std::cout << "Malformed matrix [" << path << "]" << std::endl;
+        return false;
+      }
+      if (!BlosumPenaltyArray::penalty_in_range(penalty)) {
+        std::cout << "Penalty " << penalty << " out of range for "
+                  << line[start] << " in [" << path << "]" << std::endl;
+        return false;
+      }
+      penalties[row * alphabet.size() + column] = penalty;
+      cursor = end;
+    }
+    seen[row] = true;
+    rows++;
+  }
+  if (alphabet.empty() || rows != alphabet.size()) {
+    std::cout << "Malformed matrix [" << path << "]" << std::endl;
+    return false;
+  }
 
-    if (lineBuffer[0] == '$') {
-		std::string buf;
-		std::stringstream ss(lineBuffer.substr(1)); // Insert the string into a stream
-	    while (ss >> buf) {
-	        aas.push_back(buf[0]);
-		}
-		continue;
-	}
+  bpa.set_penalties(alphabet.data(), alphabet.size(), penalties.data());
+  return true;
+}
 
-	int penalty;
-	char thisRowChar = lineBuffer[0];
-	std::stringstream ss(lineBuffer.substr(1)); // Insert the string into a stream
-	int tokenCount = 0;
-    while (ss >> penalty) {
-        bpa.set_penalty(thisRowChar, aas[tokenCount], penalty);
-		tokenCount++;
-	}
+// -------------------------------------------------------------------------
+// Load the built-in BLOSUM62 of scoring_matrix.hh, the same penalties
+// load_blosum_file reads from blosum62.txt, without touching the disk.
+// -------------------------------------------------------------------------
+void load_blosum62(BlosumPenaltyArray & bpa)
+{
+  bpa.set_penalties(BLOSUM62_ALPHABET, BLOSUM62_SIZE, &BLOSUM62_MATRIX[0][0]);
+}
+
+// -------------------------------------------------------------------------
+// Save the penalties of every residue bpa has been given into path in the
+// binary format of scoring_matrix.hh, which load_blosum_file reads back
+// with no parsing. Returns false on I/O error.
+// -------------------------------------------------------------------------
+bool save_scoring_matrix(const BlosumPenaltyArray & bpa, const std::string& path)
+{
+  std::string alphabet;
+  for (int code = 0; code < RESIDUE_CODES; code++) {
+    if (bpa.used_codes() & (1u << code)) {
+      alphabet += residue_letter(code);
+    }
+  }
+  std::string contents(SCORING_MATRIX_MAGIC, SCORING_MATRIX_MAGIC_SIZE);
+  contents += static_cast<char>(alphabet.size());
+  contents += alphabet;
+  for (char c1 : alphabet) {
+    for (char c2 : alphabet) {
+      contents += static_cast<char>(bpa.get_penalty(c1, c2));
+    }
   }
 
-  return true;
+  std::ofstream ofs(path.c_str(), std::ios::binary);
+  ofs.write(contents.data(), contents.size());
+  return ofs.good();
 }
 
 // -------------------------------------------------------------------------
-int local_alignment(const std::string & string1, 
-					const std::string & string2, 
-					BlosumPenaltyArray & bpa,
-					std::string & matchString1, 
-					std::string & matchString2)
+// local_alignment_kernel
+// Shared body of the local_alignment overloads; string1 and string2 are
+// arrays of n and m residues of either representation.
+// -------------------------------------------------------------------------
+template <typename Residue>
+int local_alignment_kernel(const Residue * string1, int n,
+						   const Residue * string2, int m,
+						   const BlosumPenaltyArray & bpa,
+						   std::string & matchString1,
+						   std::string & matchString2)
 {
+	typedef ResidueTraits<Residue> Traits;
 	int best_score = 0;
-	int best_i = string1.size();
+	int best_i = 0;
 	int best_j = 0;
-	int n = string1.size();
-	int m = string2.size();
 	int up = 0;
 	int left = 0;
 	int diag = 0;
-	std::vector<std::vector<int>> D(n + 1, std::vector<int>(m + 1));
-	std::vector<std::vector<char>> B(n + 1, std::vector<char>(m + 1));
+	// D and B are (n + 1) x (m + 1), row by row, in this thread's scratch arena.
+	AlignmentContext::Frame frame(AlignmentContext::for_thread());
+	const int cols = m + 1;
+	int * D = frame.allocate<int>((n + 1) * cols);
+	char * B = frame.allocate<char>((n + 1) * cols);
 	matchString1 = "";
 	matchString2 = "";
 	bool done = false;
 
-	for (int i = 0; i <= n; i++) {
-		for (int j = 0; j <= m; j++) {
-			D[i][j] = 0;
-			B[i][j] = '?';
+	{
+		TRACE_SCOPE("dp fill");
+		for (int i = 0; i <= n; i++) {
+			for (int j = 0; j <= m; j++) {
+				D[i * cols + j] = 0;
+				B[i * cols + j] = '?';
+			}
 		}
-	}
-	for (int i = 1; i <= n; i++) {
-		for (int j = 1; j <= m; j++) {
-			up = D[i - 1][j] + bpa.get_penalty(string1[i - 1], '*');
-			left = D[i][j - 1] + bpa.get_penalty('*', string2[j - 1]);
-			diag = D[i - 1][j - 1] + bpa.get_penalty(string1[i - 1], string2[j - 1]);
-			if (left > up) {
-				if (left > diag) {
-					B[i][j] = 'l';
+		for (int i = 1; i <= n; i++) {
+			for (int j = 1; j <= m; j++) {
+				up = D[(i - 1) * cols + j] + Traits::penalty(bpa, string1[i - 1], Traits::gap());
+				left = D[i * cols + j - 1] + Traits::penalty(bpa, Traits::gap(), string2[j - 1]);
+				diag = D[(i - 1) * cols + j - 1] + Traits::penalty(bpa, string1[i - 1], string2[j - 1]);
+				if (left > up) {
+					if (left > diag) {
+						B[i * cols + j] = 'l';
+					}
+					else {
+						B[i * cols + j] = 'd';
+					}
 				}
 				else {
-					B[i][j] = 'd';
+					if (up > diag) {
+						B[i * cols + j] = 'u';
+					}
+					else {
+						B[i * cols + j] = 'd';
+					}
 				}
-			}
-			else {
-				if (up > diag) {
-					B[i][j] = 'u';
+				D[i * cols + j] = std::max(std::max(up, left), std::max(diag, 0));
+				// A cell that floors at zero starts a new local alignment, so
+				// the traceback stops there.
+				if (D[i * cols + j] == 0) {
+					B[i * cols + j] = '?';
 				}
-				else {
-					B[i][j] = 'd';
+				//The best score can be anywhere in the matrix; keep the first
+				if (D[i * cols + j] > best_score) {
+					best_score = D[i * cols + j];
+					best_i = i;
+					best_j = j;
 				}
 			}
-			D[i][j] = std::max(std::max(up, left), std::max(diag, 0));
-		}
-	}
-	
-	//The best score is located somewhere on the bottom row
-	for (int j = 1; j <= m; j++) {
-		if (D[best_i][j] > best_score) {
-			best_score = D[best_i][j];
-			best_j = j;
 		}
 	}
 
 	//Now we follow the back pointers to get the exact alignment
+	TRACE_SCOPE("traceback");
 	int i = best_i;
 	int j = best_j;
 	while (!done) {
-		switch (B[i][j]) {
+		switch (B[i * cols + j]) {
 			case 'u':
-				matchString1 += string1[i - 1];
+				matchString1 += Traits::letter(string1[i - 1]);
 				matchString2 += '*';
 				i--;
 				break;
 			case 'l':
 				matchString1 += '*';
-				matchString2 += string2[j - 1];
+				matchString2 += Traits::letter(string2[j - 1]);
 				j--;
 				break;
 			case 'd':
-				matchString1 += string1[i - 1];
-				matchString2 += string2[j - 1];
+				matchString1 += Traits::letter(string1[i - 1]);
+				matchString2 += Traits::letter(string2[j - 1]);
 				i--;
 				j--;
 				break;
@@ -292,32 +453,997 @@ int local_alignment(const std::string & string1,
 }
 
 // -------------------------------------------------------------------------
-std::shared_ptr<Protein> local_alignment_best_match(
-					ProteinVector & proteins, 
-					const std::string & string1,
+int local_alignment(const std::string & string1, 
+					const std::string & string2, 
 					BlosumPenaltyArray & bpa,
 					std::string & matchString1, 
 					std::string & matchString2)
 {
-	std::shared_ptr<Protein> best_protein = proteins[0];
-	std::string m1 = "";
-	std::string m2 = "";
+	return local_alignment_kernel(string1.data(), string1.size(),
+								  string2.data(), string2.size(),
+								  bpa, matchString1, matchString2);
+}
+
+// -------------------------------------------------------------------------
+// local_alignment_banded_pass
+// local_alignment restricted to the cells with |i - j| <= w. Row i keeps
+// cell (i, j) at position j - i + w of D and B, so both take
+// (n + 1) * (2w + 1) entries. Cells outside the band read as a fresh start
+// (score 0, no back pointer), which makes the result a lower bound on the
+// full local_alignment score.
+// -------------------------------------------------------------------------
+template <typename Residue>
+int local_alignment_banded_pass(const Residue * string1, int n,
+								const Residue * string2, int m,
+								BlosumPenaltyArray & bpa,
+								int w,
+								std::string & matchString1,
+								std::string & matchString2)
+{
+	typedef ResidueTraits<Residue> Traits;
+	const int width = 2 * w + 1;
+	AlignmentContext::Frame frame(AlignmentContext::for_thread());
+	int * D = frame.allocate<int>((n + 1) * width);
+	char * B = frame.allocate<char>((n + 1) * width);
+	std::fill(D, D + (n + 1) * width, 0);
+	std::fill(B, B + (n + 1) * width, '?');
+	auto score = [&](int i, int j) {
+		int k = j - i + w;
+		return (k < 0 || k >= width) ? 0 : D[i * width + k];
+	};
+	auto pointer = [&](int i, int j) {
+		int k = j - i + w;
+		return (k < 0 || k >= width) ? '?' : B[i * width + k];
+	};
 	int best_score = 0;
+	int best_i = 0;
+	int best_j = 0;
+
+	{
+		TRACE_SCOPE("dp fill");
+		for (int i = 1; i <= n; i++) {
+			int lo = std::max(1, i - w);
+			int hi = std::min(m, i + w);
+			for (int j = lo; j <= hi; j++) {
+				int up = score(i - 1, j) + Traits::penalty(bpa, string1[i - 1], Traits::gap());
+				int left = score(i, j - 1) + Traits::penalty(bpa, Traits::gap(), string2[j - 1]);
+				int diag = score(i - 1, j - 1) + Traits::penalty(bpa, string1[i - 1], string2[j - 1]);
+				char back;
+				if (left > up) {
+					back = (left > diag) ? 'l' : 'd';
+				}
+				else {
+					back = (up > diag) ? 'u' : 'd';
+				}
+				int cell = std::max(std::max(up, left), std::max(diag, 0));
+				D[i * width + j - i + w] = cell;
+				B[i * width + j - i + w] = (cell == 0) ? '?' : back;
+				// Same rule as local_alignment: the first best cell anywhere.
+				if (cell > best_score) {
+					best_score = cell;
+					best_i = i;
+					best_j = j;
+				}
+			}
+		}
+	}
+
+	TRACE_SCOPE("traceback");
+	matchString1 = "";
+	matchString2 = "";
+	int i = best_i;
+	int j = best_j;
+	for (char back = pointer(i, j); back != '?'; back = pointer(i, j)) {
+		if (back == 'u') {
+			matchString1 += Traits::letter(string1[i - 1]);
+			matchString2 += '*';
+			i--;
+		}
+		else if (back == 'l') {
+			matchString1 += '*';
+			matchString2 += Traits::letter(string2[j - 1]);
+			j--;
+		}
+		else {
+			matchString1 += Traits::letter(string1[i - 1]);
+			matchString2 += Traits::letter(string2[j - 1]);
+			i--;
+			j--;
+		}
+	}
+	std::reverse(matchString1.begin(), matchString1.end());
+	std::reverse(matchString2.begin(), matchString2.end());
+
+	return best_score;
+}
+
+// -------------------------------------------------------------------------
+// Per-residue score ceilings used to certify a banded alignment. For each
+// residue of string1, ceiling1 holds the best penalty it can earn against
+// any residue of string2 (never below zero); ceiling2 likewise. Returns
+// false when some gap penalty is positive, since then gaps could earn more
+// than the ceilings allow.
+// -------------------------------------------------------------------------
+template <typename Residue>
+bool local_alignment_score_ceilings(const Residue * string1, int n,
+									const Residue * string2, int m,
+									BlosumPenaltyArray & bpa,
+									std::vector<int> & ceiling1,
+									std::vector<int> & ceiling2)
+{
+	typedef ResidueTraits<Residue> Traits;
+	std::vector<Residue> symbols1(string1, string1 + n), symbols2(string2, string2 + m);
+	std::sort(symbols1.begin(), symbols1.end());
+	symbols1.erase(std::unique(symbols1.begin(), symbols1.end()), symbols1.end());
+	std::sort(symbols2.begin(), symbols2.end());
+	symbols2.erase(std::unique(symbols2.begin(), symbols2.end()), symbols2.end());
+
+	for (size_t a = 0; a < symbols1.size(); a++) {
+		if (Traits::penalty(bpa, symbols1[a], Traits::gap()) > 0) {
+			return false;
+		}
+	}
+	for (size_t b = 0; b < symbols2.size(); b++) {
+		if (Traits::penalty(bpa, Traits::gap(), symbols2[b]) > 0) {
+			return false;
+		}
+	}
+
+	ceiling1.assign(n, 0);
+	for (int i = 0; i < n; i++) {
+		for (size_t b = 0; b < symbols2.size(); b++) {
+			ceiling1[i] = std::max(ceiling1[i], Traits::penalty(bpa, string1[i], symbols2[b]));
+		}
+	}
+	ceiling2.assign(m, 0);
+	for (int j = 0; j < m; j++) {
+		for (size_t a = 0; a < symbols1.size(); a++) {
+			ceiling2[j] = std::max(ceiling2[j], Traits::penalty(bpa, symbols1[a], string2[j]));
+		}
+	}
+	return true;
+}
+
+// -------------------------------------------------------------------------
+// Banded local_alignment: only cells within band_width of the diagonal are
+// filled, in O((n + m) * band_width) time and memory.
+//
+// Any alignment through a cell (i, j) outside the band scores at most the
+// ceilings of string1[0, i) plus the ceilings of string2[j, m), and j is at
+// least i + band_width + 1 (or the mirror image below the diagonal). When
+// the banded score does not beat the best such bound, the band is doubled
+// and the pass repeated. A strict win means no alignment that leaves the
+// band can tie, so both the score and the alignment returned are the ones
+// local_alignment would give. final_width, when given, receives the width
+// that was used last.
+// -------------------------------------------------------------------------
+int local_alignment_banded(const std::string & string1,
+						   const std::string & string2,
+						   BlosumPenaltyArray & bpa,
+						   std::string & matchString1,
+						   std::string & matchString2,
+						   int band_width,
+						   int * final_width = nullptr)
+{
+	int n = string1.size();
+	int m = string2.size();
+	std::vector<int> ceiling1, ceiling2;
+	bool certifiable = local_alignment_score_ceilings(string1.data(), n, string2.data(), m,
+													   bpa, ceiling1, ceiling2);
+	// prefix1[i]: ceilings of string1[0, i); suffix1[i]: of string1[i, n).
+	// Without ceilings the band just widens until it covers everything.
+	std::vector<int> prefix1(n + 1, 0), suffix1(n + 1, 0);
+	std::vector<int> prefix2(m + 1, 0), suffix2(m + 1, 0);
+	for (int i = 0; certifiable && i < n; i++) {
+		prefix1[i + 1] = prefix1[i] + ceiling1[i];
+		suffix1[n - i - 1] = suffix1[n - i] + ceiling1[n - i - 1];
+	}
+	for (int j = 0; certifiable && j < m; j++) {
+		prefix2[j + 1] = prefix2[j] + ceiling2[j];
+		suffix2[m - j - 1] = suffix2[m - j] + ceiling2[m - j - 1];
+	}
+
+	int w = std::max(band_width, 0);
 	int score;
-	for (int i = 0; i < proteins.size();i++)
+	while (true) {
+		score = local_alignment_banded_pass(string1.data(), n, string2.data(), m,
+											bpa, w, matchString1, matchString2);
+		if (w >= std::max(n, m)) {
+			break;
+		}
+		if (certifiable) {
+			int outside = 0;
+			for (int i = 0; i <= n && i + w + 1 <= m; i++) {
+				outside = std::max(outside, prefix1[i] + suffix2[i + w + 1]);
+			}
+			for (int j = 0; j <= m && j + w + 1 <= n; j++) {
+				outside = std::max(outside, prefix2[j] + suffix1[j + w + 1]);
+			}
+			if (score > outside || outside == 0) {
+				break;
+			}
+		}
+		w = 2 * w + 1;
+	}
+
+	if (final_width != nullptr) {
+		*final_width = w;
+	}
+	return score;
+}
+
+// -------------------------------------------------------------------------
+// Same alignment on packed sequences. The kernel works on the decoded
+// residue codes, which index the penalty matrix directly.
+// -------------------------------------------------------------------------
+int local_alignment(const PackedSequence & sequence1,
+					const PackedSequence & sequence2,
+					BlosumPenaltyArray & bpa,
+					std::string & matchString1,
+					std::string & matchString2)
+{
+	std::vector<uint8_t> codes1 = sequence1.codes();
+	std::vector<uint8_t> codes2 = sequence2.codes();
+	return local_alignment_kernel(codes1.data(), codes1.size(),
+								  codes2.data(), codes2.size(),
+								  bpa, matchString1, matchString2);
+}
+
+// -------------------------------------------------------------------------
+// Score-only local alignment on the striped SIMD kernel of striped_sw.hh.
+// No traceback is kept; with the default gaps the score is the one
+// local_alignment returns. path forces an instruction set; SIMD_AUTO takes the widest available.
+// gaps selects linear gaps from the matrix (the default) or affine gaps.
+// -------------------------------------------------------------------------
+int local_alignment_score(const std::string & string1,
+						  const std::string & string2,
+						  const BlosumPenaltyArray & bpa,
+						  SimdPath path = SIMD_AUTO,
+						  const GapModel & gaps = GapModel())
+{
+	std::vector<uint8_t> codes1(string1.size()), codes2(string2.size());
+	encode_residues(string1.data(), string1.size(), codes1.data());
+	encode_residues(string2.data(), string2.size(), codes2.data());
+	StripedQuery query(codes1.data(), codes1.size(), bpa.penalty_table(), path, gaps);
+	return query.score(codes2.data(), codes2.size());
+}
+
+// -------------------------------------------------------------------------
+// Database scan: the local_alignment_score of string1 against every
+// protein, with the query profile built once for the whole scan.
+// -------------------------------------------------------------------------
+std::vector<int> local_alignment_scores(const ProteinVector & proteins,
+										const std::string & string1,
+										const BlosumPenaltyArray & bpa,
+										SimdPath path = SIMD_AUTO,
+										const GapModel & gaps = GapModel())
+{
+	std::vector<uint8_t> codes1(string1.size()), codes2;
+	encode_residues(string1.data(), string1.size(), codes1.data());
+	StripedQuery query(codes1.data(), codes1.size(), bpa.penalty_table(), path, gaps);
+	std::vector<int> scores(proteins.size());
+	for (size_t i = 0; i < proteins.size(); i++) {
+		const std::string & sequence = proteins[i]->sequence;
+		codes2.resize(sequence.size());
+		encode_residues(sequence.data(), sequence.size(), codes2.data());
+		scores[i] = query.score(codes2.data(), codes2.size());
+	}
+	return scores;
+}
+
+// -------------------------------------------------------------------------
+// Linear-space local alignment with traceback, for aligning the single
+// winner of a score-only scan. Uses the local_alignment_score recurrence on
+// residue codes: a forward pass finds where the best alignment ends, a
+// backward pass anchored there finds where it starts, and Hirschberg's
+// divide and conquer recovers the global alignment between the two. Every
+// pass keeps one row, so memory is O(m) instead of the O(nm) of D and B.
+// -------------------------------------------------------------------------
+class LinearSpaceAlignment {
+public:
+	LinearSpaceAlignment(const std::string & string1,
+						 const std::string & string2,
+						 const BlosumPenaltyArray & bpa)
+		: _string1(string1), _string2(string2), _penalties(bpa.penalty_table()),
+		  _codes1(string1.size()), _codes2(string2.size()) {
+		encode_residues(string1.data(), string1.size(), _codes1.data());
+		encode_residues(string2.data(), string2.size(), _codes2.data());
+	}
+
+	int align(std::string & matchString1, std::string & matchString2) {
+		matchString1 = "";
+		matchString2 = "";
+		int n = _codes1.size();
+		int m = _codes2.size();
+
+		// Forward pass: the first cell, in row order, holding the best score.
+		std::vector<int> row(m + 1, 0);
+		int best = 0, end_i = 0, end_j = 0;
+		for (int i = 1; i <= n; i++) {
+			int diag = 0;
+			for (int j = 1; j <= m; j++) {
+				int cell = std::max(std::max(row[j] + gap1(i - 1), row[j - 1] + gap2(j - 1)),
+									std::max(diag + score(i - 1, j - 1), 0));
+				diag = row[j];
+				row[j] = cell;
+				if (cell > best) {
+					best = cell;
+					end_i = i;
+					end_j = j;
+				}
+			}
+		}
+		if (best == 0) {
+			return 0;
+		}
+
+		// Backward pass: best score of an alignment of [i, end_i) with
+		// [j, end_j) that runs right up to the end cell. The nearest cell
+		// reaching the full score is where the local alignment starts.
+		const int none = INT_MIN / 2;
+		std::vector<int> next(end_j + 1, none), current(end_j + 1);
+		int start_i = -1, start_j = -1;
+		for (int i = end_i; i >= 0 && start_i < 0; i--) {
+			for (int j = end_j; j >= 0; j--) {
+				int cell = (i == end_i && j == end_j) ? 0 : none;
+				if (i < end_i) {
+					cell = std::max(cell, next[j] + gap1(i));
+					if (j < end_j) {
+						cell = std::max(cell, next[j + 1] + score(i, j));
+					}
+				}
+				if (j < end_j) {
+					cell = std::max(cell, current[j + 1] + gap2(j));
+				}
+				current[j] = cell;
+				if (cell == best && start_i < 0) {
+					start_i = i;
+					start_j = j;
+				}
+			}
+			next.swap(current);
+		}
+		assert(start_i >= 0);
+
+		hirschberg(start_i, end_i, start_j, end_j, matchString1, matchString2);
+		return best;
+	}
+
+private:
+	int score(int i, int j) const { return _penalties[_codes1[i]][_codes2[j]]; }
+	int gap1(int i) const { return _penalties[_codes1[i]][RESIDUE_GAP]; }
+	int gap2(int j) const { return _penalties[RESIDUE_GAP][_codes2[j]]; }
+
+	// Global alignment scores of string1[i0, i1) against the first k
+	// residues of string2[j0, j1) (or, backward, the last k), for every k.
+	void last_row(int i0, int i1, int j0, int j1, bool backward, std::vector<int> & row) const {
+		int m = j1 - j0;
+		auto at2 = [&](int k) { return backward ? j1 - 1 - k : j0 + k; };
+		row.assign(m + 1, 0);
+		for (int k = 1; k <= m; k++) {
+			row[k] = row[k - 1] + gap2(at2(k - 1));
+		}
+		for (int r = 0; r < i1 - i0; r++) {
+			int i = backward ? i1 - 1 - r : i0 + r;
+			int diag = row[0];
+			row[0] += gap1(i);
+			for (int k = 1; k <= m; k++) {
+				int cell = std::max(std::max(row[k] + gap1(i), row[k - 1] + gap2(at2(k - 1))),
+									diag + score(i, at2(k - 1)));
+				diag = row[k];
+				row[k] = cell;
+			}
+		}
+	}
+
+	// Global alignment of string1[i0, i1) with string2[j0, j1), appended
+	// to out1 and out2.
+	void hirschberg(int i0, int i1, int j0, int j1, std::string & out1, std::string & out2) const {
+		int n = i1 - i0;
+		int m = j1 - j0;
+		if (n == 0 || m == 0) {
+			for (int i = i0; i < i1; i++) {
+				out1 += _string1[i];
+				out2 += '*';
+			}
+			for (int j = j0; j < j1; j++) {
+				out1 += '*';
+				out2 += _string2[j];
+			}
+			return;
+		}
+		if (n == 1) {
+			// The one residue either pairs with some column or is gapped.
+			int gaps = 0;
+			for (int j = j0; j < j1; j++) {
+				gaps += gap2(j);
+			}
+			int best = gaps + gap1(i0);
+			int best_j = -1;
+			for (int j = j0; j < j1; j++) {
+				int total = gaps - gap2(j) + score(i0, j);
+				if (total > best || (total == best && best_j < 0)) {
+					best = total;
+					best_j = j;
+				}
+			}
+			if (best_j < 0) {
+				out1 += _string1[i0];
+				out2 += '*';
+			}
+			for (int j = j0; j < j1; j++) {
+				out1 += (j == best_j) ? _string1[i0] : '*';
+				out2 += _string2[j];
+			}
+			return;
+		}
+
+		int mid = i0 + n / 2;
+		std::vector<int> prefix, suffix;
+		last_row(i0, mid, j0, j1, false, prefix);
+		last_row(mid, i1, j0, j1, true, suffix);
+		int split = 0;
+		for (int k = 1; k <= m; k++) {
+			if (prefix[k] + suffix[m - k] > prefix[split] + suffix[m - split]) {
+				split = k;
+			}
+		}
+		hirschberg(i0, mid, j0, j0 + split, out1, out2);
+		hirschberg(mid, i1, j0 + split, j1, out1, out2);
+	}
+
+	const std::string &		_string1;
+	const std::string &		_string2;
+	const PenaltyTable &	_penalties;
+	std::vector<uint8_t>	_codes1;
+	std::vector<uint8_t>	_codes2;
+};
+
+// -------------------------------------------------------------------------
+// Smith-Waterman alignment in linear space. Returns the same score as
+// local_alignment_score.
+// -------------------------------------------------------------------------
+int local_alignment_linear_space(const std::string & string1,
+								 const std::string & string2,
+								 const BlosumPenaltyArray & bpa,
+								 std::string & matchString1,
+								 std::string & matchString2)
+{
+	return LinearSpaceAlignment(string1, string2, bpa).align(matchString1, matchString2);
+}
+
+// -------------------------------------------------------------------------
+// local_alignment with affine gaps: Gotoh's three-matrix recurrence, where
+// H holds the best alignment ending at a cell, E the best ending in a gap
+// in string1 and F the best ending in a gap in string2. Like
+// local_alignment_score, the best cell is searched over the whole matrix
+// and the traceback stops where the alignment started from zero.
+// -------------------------------------------------------------------------
+int local_alignment_affine(const std::string & string1,
+						   const std::string & string2,
+						   const BlosumPenaltyArray & bpa,
+						   const GapModel & gaps,
+						   std::string & matchString1,
+						   std::string & matchString2)
+{
+	const PenaltyTable & penalties = bpa.penalty_table();
+	const int none = INT_MIN / 2;
+	int n = string1.size();
+	int m = string2.size();
+	const int width = m + 1;
+	AlignmentContext::Frame frame(AlignmentContext::for_thread());
+	uint8_t * codes1 = frame.allocate<uint8_t>(n);
+	uint8_t * codes2 = frame.allocate<uint8_t>(m);
+	int * H = frame.allocate<int>((n + 1) * width);
+	int * E = frame.allocate<int>((n + 1) * width);
+	int * F = frame.allocate<int>((n + 1) * width);
+	encode_residues(string1.data(), n, codes1);
+	encode_residues(string2.data(), m, codes2);
+	std::fill(H, H + (n + 1) * width, 0);
+	std::fill(E, E + (n + 1) * width, none);
+	std::fill(F, F + (n + 1) * width, none);
+
+	int best = 0, best_i = 0, best_j = 0;
 	{
-		score = local_alignment(string1, proteins[i]->sequence, bpa, m1, m2);
-		if (score > best_score)
-		{
-			best_score = score;
-			best_protein = proteins[i];
-			matchString1 = m1;
-			matchString2 = m2;
+		TRACE_SCOPE("dp fill");
+		for (int i = 1; i <= n; i++) {
+			for (int j = 1; j <= m; j++) {
+				int at = i * width + j;
+				E[at] = std::max(H[at - 1] + gaps.left_open(penalties, codes2[j - 1]),
+								 E[at - 1] + gaps.left_extend(penalties, codes2[j - 1]));
+				F[at] = std::max(H[at - width] + gaps.up_open(penalties, codes1[i - 1]),
+								 F[at - width] + gaps.up_extend(penalties, codes1[i - 1]));
+				int diag = H[at - width - 1] + penalties[codes1[i - 1]][codes2[j - 1]];
+				H[at] = std::max(std::max(diag, 0), std::max(E[at], F[at]));
+				if (H[at] > best) {
+					best = H[at];
+					best_i = i;
+					best_j = j;
+				}
+			}
+		}
+	}
+
+	TRACE_SCOPE("traceback");
+	matchString1 = "";
+	matchString2 = "";
+	int i = best_i;
+	int j = best_j;
+	char state = 'h';
+	while (i > 0 && j > 0) {
+		int at = i * width + j;
+		if (state == 'h') {
+			if (H[at] == 0) {
+				break;
+			}
+			if (H[at] == H[at - width - 1] + penalties[codes1[i - 1]][codes2[j - 1]]) {
+				matchString1 += string1[i - 1];
+				matchString2 += string2[j - 1];
+				i--;
+				j--;
+			}
+			else {
+				state = (H[at] == E[at]) ? 'e' : 'f';
+			}
 		}
+		else if (state == 'e') {
+			matchString1 += '*';
+			matchString2 += string2[j - 1];
+			if (E[at] == H[at - 1] + gaps.left_open(penalties, codes2[j - 1])) {
+				state = 'h';
+			}
+			j--;
+		}
+		else {
+			matchString1 += string1[i - 1];
+			matchString2 += '*';
+			if (F[at] == H[at - width] + gaps.up_open(penalties, codes1[i - 1])) {
+				state = 'h';
+			}
+			i--;
+		}
+	}
+	std::reverse(matchString1.begin(), matchString1.end());
+	std::reverse(matchString2.begin(), matchString2.end());
+
+	return best;
+}
+
+// Pairs up to this many DP cells are traced back by local_alignment itself.
+const size_t FULL_TRACEBACK_CELLS = 1 << 20;
+
+// -------------------------------------------------------------------------
+// Alignment of the winner of a score-only scan. With gaps.affine it is
+// local_alignment_affine. Otherwise, up to FULL_TRACEBACK_CELLS cells it
+// is local_alignment, so the scans return exactly the strings the
+// original best_match did; larger pairs are aligned in linear space,
+// which gives an alignment of the same score but may break ties between
+// equally good alignments differently.
+// -------------------------------------------------------------------------
+int local_alignment_winner(const std::string & string1,
+						   const std::string & string2,
+						   const BlosumPenaltyArray & bpa,
+						   const GapModel & gaps,
+						   std::string & matchString1,
+						   std::string & matchString2)
+{
+	if (gaps.affine) {
+		return local_alignment_affine(string1, string2, bpa, gaps, matchString1, matchString2);
+	}
+	if ((string1.size() + 1) * (string2.size() + 1) <= FULL_TRACEBACK_CELLS) {
+		return local_alignment_kernel(string1.data(), string1.size(),
+									  string2.data(), string2.size(),
+									  bpa, matchString1, matchString2);
+	}
+	return local_alignment_linear_space(string1, string2, bpa, matchString1, matchString2);
+}
+
+// Positions 0 .. count - 1, for scanning a whole database.
+std::vector<uint32_t> all_candidates(size_t count)
+{
+	std::vector<uint32_t> candidates(count);
+	for (size_t i = 0; i < count; i++) {
+		candidates[i] = i;
+	}
+	return candidates;
+}
+
+// What local_alignment_best_of returns when there are no candidates.
+const size_t NO_MATCH = static_cast<size_t>(-1);
+
+// -------------------------------------------------------------------------
+// Align string1 against the proteins listed in candidates, in the order
+// given, and return the position of the best one (the first on ties), or
+// NO_MATCH with a score of 0 and empty alignments when there are none.
+// The candidates are scored on the striped kernel without any traceback,
+// in O(m) memory each. Only the winner is aligned, by
+// local_alignment_winner, into matchString1/2. best_score, when given, receives the winning score;
+// gaps selects the gap model as in local_alignment_score.
+// -------------------------------------------------------------------------
+size_t local_alignment_best_of(ProteinVector & proteins,
+							   const std::vector<uint32_t> & candidates,
+							   const std::string & string1,
+							   BlosumPenaltyArray & bpa,
+							   std::string & matchString1,
+							   std::string & matchString2,
+							   int * best_score = nullptr,
+							   const GapModel & gaps = GapModel())
+{
+	if (candidates.empty()) {
+		matchString1 = "";
+		matchString2 = "";
+		if (best_score != nullptr) {
+			*best_score = 0;
+		}
+		return NO_MATCH;
 	}
 
+	std::vector<uint8_t> codes1(string1.size()), codes2;
+	encode_residues(string1.data(), string1.size(), codes1.data());
+	StripedQuery query(codes1.data(), codes1.size(), bpa.penalty_table(), SIMD_AUTO, gaps);
 
-	std:: cout << "\nSCORE = " << score << "\n";
-	return best_protein;
+	size_t best_i = candidates[0];
+	int best = 0;
+	for (size_t c = 0; c < candidates.size(); c++) {
+		const std::string & sequence = proteins[candidates[c]]->sequence;
+		codes2.resize(sequence.size());
+		encode_residues(sequence.data(), sequence.size(), codes2.data());
+		int score = query.score(codes2.data(), codes2.size());
+		if (score > best) {
+			best = score;
+			best_i = candidates[c];
+		}
+	}
+
+	local_alignment_winner(string1, proteins[best_i]->sequence, bpa, gaps, matchString1, matchString2);
+	if (best_score != nullptr) {
+		*best_score = best;
+	}
+	return best_i;
 }
 
+// -------------------------------------------------------------------------
+// Best Smith-Waterman match for string1 over the whole database, as
+// local_alignment_best_of; nullptr for an empty database.
+// -------------------------------------------------------------------------
+std::shared_ptr<Protein> local_alignment_best_match(
+					ProteinVector & proteins,
+					const std::string & string1,
+					BlosumPenaltyArray & bpa,
+					std::string & matchString1,
+					std::string & matchString2)
+{
+	int best_score = 0;
+	size_t best = local_alignment_best_of(proteins, all_candidates(proteins.size()), string1,
+										  bpa, matchString1, matchString2, &best_score);
+
+	std:: cout << "\nSCORE = " << best_score << "\n";
+	return (best == NO_MATCH) ? nullptr : proteins[best];
+}
+
+// -------------------------------------------------------------------------
+// local_alignment_best_match on the inter-sequence kernel: string1 is
+// scored against a whole batch of proteins per instruction, then the
+// winner (the first on ties, as in the plain scan) is aligned by
+// local_alignment_winner. batches must have been built from proteins.
+// -------------------------------------------------------------------------
+std::shared_ptr<Protein> local_alignment_best_match(
+					ProteinVector & proteins,
+					const std::string & string1,
+					BlosumPenaltyArray & bpa,
+					std::string & matchString1,
+					std::string & matchString2,
+					const SequenceBatches & batches,
+					const GapModel & gaps = GapModel())
+{
+	assert(batches.size() == proteins.size());
+	std::vector<uint8_t> codes1(string1.size());
+	encode_residues(string1.data(), string1.size(), codes1.data());
+	std::vector<int> scores = interseq_scores(batches, codes1.data(), codes1.size(),
+											  bpa.penalty_table(), SIMD_AUTO, gaps);
+	if (scores.empty()) {
+		matchString1 = "";
+		matchString2 = "";
+		return nullptr;
+	}
+	size_t best = std::max_element(scores.begin(), scores.end()) - scores.begin();
+	local_alignment_winner(string1, proteins[best]->sequence, bpa, gaps, matchString1, matchString2);
+	return proteins[best];
+}
+
+// One entry of a ranked hit list: a protein's position in the database
+// and its local alignment score.
+struct AlignmentHit {
+	size_t	protein;
+	int		score;
+};
+
+// -------------------------------------------------------------------------
+// Top-K mode of local_alignment_best_match: the top_k proteins with the
+// best scores against string1, best first, equal scores in database order.
+// Proteins with nothing in common (score 0) are left out. A bounded
+// min-heap holds the best hits seen so far, with the weakest on top, so a
+// protein costs a heap operation only when it beats that weakest hit.
+// -------------------------------------------------------------------------
+std::vector<AlignmentHit> local_alignment_best_matches(
+					ProteinVector & proteins,
+					const std::string & string1,
+					BlosumPenaltyArray & bpa,
+					size_t top_k,
+					const GapModel & gaps = GapModel())
+{
+	auto better = [](const AlignmentHit & a, const AlignmentHit & b) {
+		return (a.score != b.score) ? (a.score > b.score) : (a.protein < b.protein);
+	};
+	std::priority_queue<AlignmentHit, std::vector<AlignmentHit>, decltype(better)> weakest(better);
+
+	std::vector<uint8_t> codes1(string1.size()), codes2;
+	encode_residues(string1.data(), string1.size(), codes1.data());
+	StripedQuery query(codes1.data(), codes1.size(), bpa.penalty_table(), SIMD_AUTO, gaps);
+	for (size_t i = 0; i < proteins.size() && top_k > 0; i++) {
+		const std::string & sequence = proteins[i]->sequence;
+		codes2.resize(sequence.size());
+		encode_residues(sequence.data(), sequence.size(), codes2.data());
+		AlignmentHit hit = { i, query.score(codes2.data(), codes2.size()) };
+		if (hit.score == 0) {
+			continue;
+		}
+		if (weakest.size() < top_k) {
+			weakest.push(hit);
+		}
+		else if (better(hit, weakest.top())) {
+			weakest.pop();
+			weakest.push(hit);
+		}
+	}
+
+	std::vector<AlignmentHit> hits(weakest.size());
+	for (size_t h = hits.size(); h > 0; h--) {
+		hits[h - 1] = weakest.top();
+		weakest.pop();
+	}
+	return hits;
+}
+
+// -------------------------------------------------------------------------
+// Seeded version of local_alignment_best_match: only the top_k proteins
+// sharing the most k-mers with string1 are aligned. They are aligned in
+// database order so ties resolve as in the full scan. exact (or a query
+// with no k-mer hits) scans every protein instead.
+// -------------------------------------------------------------------------
+std::shared_ptr<Protein> local_alignment_best_match(
+					ProteinVector & proteins,
+					const std::string & string1,
+					BlosumPenaltyArray & bpa,
+					std::string & matchString1,
+					std::string & matchString2,
+					const KmerIndex & index,
+					size_t top_k,
+					bool exact = false)
+{
+	assert(index.size() == proteins.size());
+	std::vector<uint32_t> shortlist;
+	if (!exact) {
+		shortlist = index.candidates(string1, top_k);
+	}
+	if (shortlist.empty()) {
+		shortlist = all_candidates(proteins.size());
+	}
+	std::sort(shortlist.begin(), shortlist.end());
+	size_t best = local_alignment_best_of(proteins, shortlist, string1, bpa,
+										  matchString1, matchString2);
+	return (best == NO_MATCH) ? nullptr : proteins[best];
+}
+
+// -------------------------------------------------------------------------
+// local_alignment_best_of on a SequenceDatabase: each candidate's residue
+// codes are decoded from the database into one reused buffer and scored,
+// and only the winner is copied out of it to be aligned.
+// -------------------------------------------------------------------------
+size_t local_alignment_best_of(SequenceDatabase & database,
+							   const std::vector<uint32_t> & candidates,
+							   const std::string & string1,
+							   BlosumPenaltyArray & bpa,
+							   std::string & matchString1,
+							   std::string & matchString2,
+							   int * best_score = nullptr,
+							   const GapModel & gaps = GapModel())
+{
+	matchString1 = "";
+	matchString2 = "";
+	if (best_score != nullptr) {
+		*best_score = 0;
+	}
+	if (candidates.empty()) {
+		return NO_MATCH;
+	}
+
+	std::vector<uint8_t> codes1(string1.size()), codes2;
+	encode_residues(string1.data(), string1.size(), codes1.data());
+	StripedQuery query(codes1.data(), codes1.size(), bpa.penalty_table(), SIMD_AUTO, gaps);
+
+	size_t best_i = candidates[0];
+	int best = 0;
+	for (size_t c = 0; c < candidates.size(); c++) {
+		codes2.resize(database.length(candidates[c]));
+		database.codes(candidates[c], codes2.data());
+		int score = query.score(codes2.data(), codes2.size());
+		if (score > best) {
+			best = score;
+			best_i = candidates[c];
+		}
+	}
+
+	std::string winner = database.sequence(best_i);
+	local_alignment_winner(string1, winner, bpa, gaps, matchString1, matchString2);
+	if (best_score != nullptr) {
+		*best_score = best;
+	}
+	return best_i;
+}
+
+// -------------------------------------------------------------------------
+// The seeded search above, on a SequenceDatabase and the k-mer index it
+// keeps: the index is built by the first query and reused by every later
+// one. nullptr for an empty database.
+// -------------------------------------------------------------------------
+std::shared_ptr<Protein> local_alignment_best_match(
+					SequenceDatabase & database,
+					const std::string & string1,
+					BlosumPenaltyArray & bpa,
+					std::string & matchString1,
+					std::string & matchString2,
+					size_t top_k,
+					int k = 3)
+{
+	std::vector<uint32_t> shortlist = database.kmer_index(k).candidates(string1, top_k);
+	if (shortlist.empty()) {
+		shortlist = all_candidates(database.size());
+	}
+	std::sort(shortlist.begin(), shortlist.end());
+	size_t best = local_alignment_best_of(database, shortlist, string1, bpa,
+										  matchString1, matchString2);
+	return (best == NO_MATCH) ? nullptr : database.protein(best);
+}
+
+// -------------------------------------------------------------------------
+// local_alignment_best_match over a whole SequenceDatabase, reporting the
+// score the same way; nullptr for an empty database.
+// -------------------------------------------------------------------------
+std::shared_ptr<Protein> local_alignment_best_match(
+					SequenceDatabase & database,
+					const std::string & string1,
+					BlosumPenaltyArray & bpa,
+					std::string & matchString1,
+					std::string & matchString2)
+{
+	int best_score = 0;
+	size_t best = local_alignment_best_of(database, all_candidates(database.size()), string1,
+										  bpa, matchString1, matchString2, &best_score);
+
+	std:: cout << "\nSCORE = " << best_score << "\n";
+	return (best == NO_MATCH) ? nullptr : database.protein(best);
+}
+
+// -------------------------------------------------------------------------
+// The batched local_alignment_best_match on a SequenceDatabase. batches
+// must have been built from database; only the winner's sequence is read
+// back out of the database, to be aligned.
+// -------------------------------------------------------------------------
+std::shared_ptr<Protein> local_alignment_best_match(
+					SequenceDatabase & database,
+					const std::string & string1,
+					BlosumPenaltyArray & bpa,
+					std::string & matchString1,
+					std::string & matchString2,
+					const SequenceBatches & batches,
+					const GapModel & gaps = GapModel())
+{
+	assert(batches.size() == database.size());
+	std::vector<uint8_t> codes1(string1.size());
+	encode_residues(string1.data(), string1.size(), codes1.data());
+	std::vector<int> scores = interseq_scores(batches, codes1.data(), codes1.size(),
+											  bpa.penalty_table(), SIMD_AUTO, gaps);
+	if (scores.empty()) {
+		matchString1 = "";
+		matchString2 = "";
+		return nullptr;
+	}
+	size_t best = std::max_element(scores.begin(), scores.end()) - scores.begin();
+	std::string winner = database.sequence(best);
+	local_alignment_winner(string1, winner, bpa, gaps, matchString1, matchString2);
+	return database.protein(best);
+}
+
+// -------------------------------------------------------------------------
+// local_alignment_scores on a SequenceDatabase: score i is for protein i,
+// decoded from the database into one reused buffer.
+// -------------------------------------------------------------------------
+std::vector<int> local_alignment_scores(const SequenceDatabase & database,
+										const std::string & string1,
+										const BlosumPenaltyArray & bpa,
+										SimdPath path = SIMD_AUTO,
+										const GapModel & gaps = GapModel())
+{
+	std::vector<uint8_t> codes1(string1.size()), codes2;
+	encode_residues(string1.data(), string1.size(), codes1.data());
+	StripedQuery query(codes1.data(), codes1.size(), bpa.penalty_table(), path, gaps);
+	std::vector<int> scores(database.size());
+	for (size_t i = 0; i < database.size(); i++) {
+		codes2.resize(database.length(i));
+		database.codes(i, codes2.data());
+		scores[i] = query.score(codes2.data(), codes2.size());
+	}
+	return scores;
+}
+
+// -------------------------------------------------------------------------
+// local_alignment_best_matches on a SequenceDatabase, ranked the same way:
+// hit.protein is a position in the database.
+// -------------------------------------------------------------------------
+std::vector<AlignmentHit> local_alignment_best_matches(
+					SequenceDatabase & database,
+					const std::string & string1,
+					BlosumPenaltyArray & bpa,
+					size_t top_k,
+					const GapModel & gaps = GapModel())
+{
+	auto better = [](const AlignmentHit & a, const AlignmentHit & b) {
+		return (a.score != b.score) ? (a.score > b.score) : (a.protein < b.protein);
+	};
+	std::priority_queue<AlignmentHit, std::vector<AlignmentHit>, decltype(better)> weakest(better);
+
+	std::vector<uint8_t> codes1(string1.size()), codes2;
+	encode_residues(string1.data(), string1.size(), codes1.data());
+	StripedQuery query(codes1.data(), codes1.size(), bpa.penalty_table(), SIMD_AUTO, gaps);
+	for (size_t i = 0; i < database.size() && top_k > 0; i++) {
+		codes2.resize(database.length(i));
+		database.codes(i, codes2.data());
+		AlignmentHit hit = { i, query.score(codes2.data(), codes2.size()) };
+		if (hit.score == 0) {
+			continue;
+		}
+		if (weakest.size() < top_k) {
+			weakest.push(hit);
+		}
+		else if (better(hit, weakest.top())) {
+			weakest.pop();
+			weakest.push(hit);
+		}
+	}
+
+	std::vector<AlignmentHit> hits(weakest.size());
+	for (size_t h = hits.size(); h > 0; h--) {
+		hits[h - 1] = weakest.top();
+		weakest.pop();
+	}
+	return hits;
+}
+
+// -------------------------------------------------------------------------
+// local_alignment_best_match through a result cache: a query already seen
+// with the same version of the same database and the same matrix is
+// answered from the cache without aligning anything.
+// -------------------------------------------------------------------------
+std::shared_ptr<Protein> local_alignment_best_match(
+					SequenceDatabase & database,
+					const std::string & string1,
+					BlosumPenaltyArray & bpa,
+					std::string & matchString1,
+					std::string & matchString2,
+					ResultCache & cache)
+{
+	ResultCacheKey key = { string1, RESULT_LOCAL_ALIGNMENT, bpa.version(),
+						   database.id(), database.version() };
+	CachedMatch result;
+	if (!cache.find(key, result)) {
+		result.protein = local_alignment_best_of(database, all_candidates(database.size()),
+												 string1, bpa, matchString1, matchString2);
+		result.matchString1 = matchString1;
+		result.matchString2 = matchString2;
+		cache.insert(key, result);
+	}
+	matchString1 = result.matchString1;
+	matchString2 = result.matchString2;
+	return (result.protein == NO_MATCH) ? nullptr : database.protein(result.protein);
+}
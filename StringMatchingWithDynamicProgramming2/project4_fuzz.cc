@@ -0,0 +1,343 @@
+///////////////////////////////////////////////////////////////////////////////
+// project4_fuzz.cc
+//
+// Differential fuzzing of the alignment engines of project4.hh. The plain
+// local_alignment kernel is the oracle: every packed, banded, SIMD,
+// batched, linear-space, wavefront and threaded path must agree with it
+// on small random sequences, and the SIMD, batched and wavefront paths
+// also on long ones.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "fuzz.hh"
+#include "project4.hh"
+#include "search_engine.hh"
+#include "wavefront.hh"
+
+typedef std::vector<std::string> string_vector;
+
+// Few distinct residues, and the odd gap letter, so that random sequences
+// align in many equally good ways.
+const std::string ALPHABET = "ACDKWY*";
+
+BlosumPenaltyArray bpa;
+
+// The score an alignment earns under bpa, '*' being a gap.
+int rescore(const std::string & match1, const std::string & match2)
+{
+	int score = 0;
+	for (size_t k = 0; k < match1.size(); k++) {
+		score += bpa.get_penalty(match1[k], match2[k]);
+	}
+	return score;
+}
+
+// The proteins of a fuzz case: every string but the last, which is the query.
+ProteinVector fuzz_database(const string_vector & input)
+{
+	ProteinVector proteins;
+	for (size_t i = 0; i + 1 < input.size(); i++) {
+		proteins.push_back(std::shared_ptr<Protein>(new Protein("p" + std::to_string(i), input[i])));
+	}
+	return proteins;
+}
+
+std::string pair_property(const string_vector & pair)
+{
+	if (pair.size() != 2) {
+		return "";
+	}
+	const std::string & s1 = pair[0];
+	const std::string & s2 = pair[1];
+	std::string ref1, ref2, match1, match2;
+	int expected = local_alignment(s1, s2, bpa, ref1, ref2);
+	std::ostringstream failure;
+	auto same = [&](const char * engine, int score, bool alignment) {
+		if (failure.str().empty() && (score != expected || (alignment && (match1 != ref1 || match2 != ref2)))) {
+			failure << engine << " scored " << score << " as " << match1 << "/" << match2
+					<< ", local_alignment " << expected << " as " << ref1 << "/" << ref2;
+		}
+	};
+
+	same("packed", local_alignment(PackedSequence(s1), PackedSequence(s2), bpa, match1, match2), true);
+	same("banded", local_alignment_banded(s1, s2, bpa, match1, match2, 1), true);
+	SimdPath paths[] = { SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2 };
+	for (SimdPath path : paths) {
+		if (simd_path_supported(path)) {
+			same(simd_path_name(path), local_alignment_score(s1, s2, bpa, path), false);
+		}
+	}
+	int linear = local_alignment_linear_space(s1, s2, bpa, match1, match2);
+	same("linear space", linear, false);
+	same("linear space rescored", rescore(match1, match2), false);
+	ThreadPool pool(2);
+	for (int tile : { 1, 2, 5 }) {
+		same("wavefront", local_alignment_wavefront(s1, s2, bpa, match1, match2, pool, tile), true);
+	}
+	// BLOSUM62 gaps cost -4 against every residue but '*' itself.
+	if ((s1 + s2).find('*') == std::string::npos) {
+		same("affine, open == extend", local_alignment_affine(s1, s2, bpa, GapModel(-4, -4), match1, match2), false);
+	}
+
+	// Affine gaps against the scalar affine score.
+	GapModel blast(-12, -1);
+	int affine = local_alignment_affine(s1, s2, bpa, blast, match1, match2);
+	int scalar = local_alignment_score(s1, s2, bpa, SIMD_SCALAR, blast);
+	if (failure.str().empty() && (affine != scalar || local_alignment_score(s1, s2, bpa, SIMD_AUTO, blast) != scalar)) {
+		failure << "affine traceback " << affine << ", scalar " << scalar;
+	}
+	return failure.str();
+}
+
+// -------------------------------------------------------------------------
+// Long pairs reach what short ones cannot: striped queries of several
+// segments, scores past 255 that make the 8-bit lanes fall back to 16 bits
+// and past 32767 that make those fall back to the scalar kernel, and
+// wavefronts of many tiles. The second string is usually a mutated copy of
+// the first, so that the scores are high.
+// -------------------------------------------------------------------------
+const std::string RESIDUES = "ACDEFGHIKLMNPQRSTVWY";
+
+// s with about one residue in rate substituted, deleted or followed by an
+// insertion.
+std::string mutate(FuzzRng & rng, const std::string & s, double rate)
+{
+	std::string result;
+	for (char residue : s) {
+		if (!rng.chance(rate)) {
+			result += residue;
+			continue;
+		}
+		switch (rng.range(0, 2)) {
+		case 0:
+			result += RESIDUES[rng.range(0, RESIDUES.size() - 1)];
+			break;
+		case 1:
+			break;
+		default:
+			result += residue;
+			result += RESIDUES[rng.range(0, RESIDUES.size() - 1)];
+		}
+	}
+	return result;
+}
+
+string_vector long_pair(FuzzRng & rng)
+{
+	string_vector pair;
+	int kind = rng.range(0, 9);
+	if (kind == 0) {
+		// Tryptophan scores 11 against itself, so 3000 of them pass 32767.
+		pair.push_back(std::string(rng.range(3000, 3100), 'W'));
+		pair.push_back(mutate(rng, pair[0], 0.001));
+	}
+	else if (kind <= 2) {
+		pair.push_back(rng.string(RESIDUES, 100, 600));
+		pair.push_back(rng.string(RESIDUES, 100, 600));
+	}
+	else {
+		pair.push_back(rng.string(RESIDUES, 100, 600));
+		pair.push_back(mutate(rng, pair[0], rng.chance(0.5) ? 0.01 : 0.1));
+	}
+	return pair;
+}
+
+// Shrink by cutting ever smaller pieces out of either string, so that a
+// long counterexample shrinks in a few hundred steps rather than one
+// residue at a time.
+std::vector<string_vector> shrink_long_pair(const string_vector & pair)
+{
+	std::vector<string_vector> candidates;
+	for (size_t piece = std::max(pair[0].size(), pair[1].size()) / 2; piece > 0; piece /= 2) {
+		for (int s = 0; s < 2; s++) {
+			for (size_t at = 0; at + piece <= pair[s].size(); at += piece) {
+				string_vector smaller(pair);
+				smaller[s].erase(at, piece);
+				candidates.push_back(smaller);
+			}
+		}
+	}
+	return candidates;
+}
+
+std::string long_pair_property(const string_vector & pair)
+{
+	const std::string & s1 = pair[0];
+	const std::string & s2 = pair[1];
+	std::string ref1, ref2, match1, match2;
+	int expected = local_alignment(s1, s2, bpa, ref1, ref2);
+	std::ostringstream failure;
+	auto same = [&](const std::string & engine, int score, bool alignment) {
+		if (failure.str().empty() && (score != expected || (alignment && (match1 != ref1 || match2 != ref2)))) {
+			failure << engine << " scored " << score << ", local_alignment " << expected;
+		}
+	};
+
+	std::vector<uint8_t> codes1(s1.size()), codes2(s2.size());
+	encode_residues(s1.data(), s1.size(), codes1.data());
+	encode_residues(s2.data(), s2.size(), codes2.data());
+	SequenceBatches batches;
+	batches.build(std::vector<const uint8_t *>(1, codes2.data()), std::vector<int>(1, codes2.size()));
+	SimdPath paths[] = { SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2 };
+	for (SimdPath path : paths) {
+		if (simd_path_supported(path)) {
+			same(simd_path_name(path), local_alignment_score(s1, s2, bpa, path), false);
+			same(std::string("inter-sequence on ") + simd_path_name(path),
+				 interseq_scores(batches, codes1.data(), codes1.size(), bpa.penalty_table(), path)[0],
+				 false);
+		}
+	}
+	int linear = local_alignment_linear_space(s1, s2, bpa, match1, match2);
+	same("linear space", linear, false);
+	same("linear space rescored", rescore(match1, match2), false);
+	same("banded", local_alignment_banded(s1, s2, bpa, match1, match2, 8), true);
+	ThreadPool pool(2);
+	for (int tile : { 16, 100, (int) WavefrontAlignment::DEFAULT_TILE }) {
+		same("wavefront, tile " + std::to_string(tile),
+			 local_alignment_wavefront(s1, s2, bpa, match1, match2, pool, tile), true);
+	}
+
+	GapModel blast(-12, -1);
+	int affine = local_alignment_affine(s1, s2, bpa, blast, match1, match2);
+	int scalar = local_alignment_score(s1, s2, bpa, SIMD_SCALAR, blast);
+	if (failure.str().empty() && (affine != scalar || local_alignment_score(s1, s2, bpa, SIMD_AUTO, blast) != scalar)) {
+		failure << "affine traceback " << affine << ", scalar " << scalar;
+	}
+	return failure.str();
+}
+
+std::string database_property(const string_vector & input)
+{
+	if (input.size() < 2) {
+		return "";
+	}
+	ProteinVector proteins = fuzz_database(input);
+	const std::string & query = input.back();
+	std::vector<int> expected;
+	std::string match1, match2;
+	for (const auto & protein : proteins) {
+		expected.push_back(local_alignment(query, protein->sequence, bpa, match1, match2));
+	}
+	size_t winner = std::max_element(expected.begin(), expected.end()) - expected.begin();
+	// The searches trace back small winners with local_alignment itself, so
+	// they must return its exact strings, ties and all.
+	std::string expected1, expected2;
+	local_alignment(query, proteins[winner]->sequence, bpa, expected1, expected2);
+
+	SimdPath paths[] = { SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2 };
+	SequenceBatches batches;
+	build_sequence_batches(batches, proteins);
+	std::vector<uint8_t> codes(query.size());
+	encode_residues(query.data(), query.size(), codes.data());
+	for (SimdPath path : paths) {
+		if (!simd_path_supported(path)) {
+			continue;
+		}
+		if (local_alignment_scores(proteins, query, bpa, path) != expected) {
+			return std::string("striped scan on ") + simd_path_name(path);
+		}
+		if (interseq_scores(batches, codes.data(), codes.size(), bpa.penalty_table(), path) != expected) {
+			return std::string("inter-sequence batches on ") + simd_path_name(path);
+		}
+	}
+
+	int best_score = 0;
+	size_t best = local_alignment_best_of(proteins, all_candidates(proteins.size()), query, bpa,
+										  match1, match2, &best_score);
+	if (best != winner || best_score != expected[winner]) {
+		return "best_of chose p" + std::to_string(best) + ", expected p" + std::to_string(winner);
+	}
+	if (match1 != expected1 || match2 != expected2) {
+		return "best_of aligned " + match1 + "/" + match2 + ", expected " + expected1 + "/" + expected2;
+	}
+	SequenceDatabase database(proteins);
+	best = local_alignment_best_of(database, all_candidates(proteins.size()), query, bpa,
+								   match1, match2, &best_score);
+	if (best != winner || best_score != expected[winner]) {
+		return "database best_of chose p" + std::to_string(best) + ", expected p" + std::to_string(winner);
+	}
+	if (match1 != expected1 || match2 != expected2) {
+		return "database best_of aligned " + match1 + "/" + match2;
+	}
+	if (local_alignment_best_match(proteins, query, bpa, match1, match2, batches) != proteins[winner]) {
+		return "batched best match";
+	}
+	if (match1 != expected1 || match2 != expected2) {
+		return "batched best match aligned " + match1 + "/" + match2;
+	}
+	SearchEngine engine(database, bpa, 2);
+	SearchResult result = engine.search(query);
+	if (expected[winner] > 0 && (result.protein != winner || result.score != expected[winner])) {
+		return "search engine chose p" + std::to_string(result.protein);
+	}
+	if (expected[winner] > 0 && (result.match1 != expected1 || result.match2 != expected2)) {
+		return "search engine aligned " + result.match1 + "/" + result.match2;
+	}
+
+	std::vector<AlignmentHit> hits = local_alignment_best_matches(proteins, query, bpa, 3);
+	std::vector<size_t> order;
+	for (size_t i = 0; i < expected.size(); i++) {
+		if (expected[i] > 0) {
+			order.push_back(i);
+		}
+	}
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return expected[a] > expected[b]; });
+	order.resize(std::min<size_t>(order.size(), 3));
+	if (hits.size() != order.size()) {
+		return "top-3 has " + std::to_string(hits.size()) + " hits, expected " + std::to_string(order.size());
+	}
+	for (size_t h = 0; h < hits.size(); h++) {
+		if (hits[h].protein != order[h] || hits[h].score != expected[order[h]]) {
+			return "top-3 hit " + std::to_string(h) + " is p" + std::to_string(hits[h].protein);
+		}
+	}
+	return "";
+}
+
+int main(int argc, char * argv[]) {
+	load_blosum62(bpa);
+	Fuzzer fuzzer(argc, argv);
+
+	fuzzer.check<string_vector>("pairwise alignment engines",
+		[](FuzzRng & rng) {
+			string_vector pair;
+			pair.push_back(rng.string(ALPHABET, 0, 14));
+			pair.push_back(rng.string(ALPHABET, 0, 14));
+			return pair;
+		},
+		pair_property,
+		[](const string_vector & pair) {
+			// Keep the pair, only shorten its strings.
+			std::vector<string_vector> candidates;
+			for (const string_vector & smaller : shrink_strings(pair)) {
+				if (smaller.size() == 2) {
+					candidates.push_back(smaller);
+				}
+			}
+			return candidates;
+		},
+		describe_strings);
+
+	// Each case costs as much as hundreds of short ones.
+	fuzzer.check<string_vector>("long sequences",
+		long_pair,
+		long_pair_property,
+		shrink_long_pair,
+		[](const string_vector & pair) {
+			return "lengths " + std::to_string(pair[0].size()) + " and " + std::to_string(pair[1].size())
+				+ " " + describe_strings(pair);
+		},
+		std::max(1, fuzzer.cases() / 10));
+
+	fuzzer.check<string_vector>("database searches",
+		[](FuzzRng & rng) {
+			string_vector input = rng.words(12, ALPHABET, 0, 12);
+			input.push_back(rng.string(ALPHABET, 0, 8));
+			return input;
+		},
+		database_property,
+		shrink_strings,
+		describe_strings);
+
+	return fuzzer.finish();
+}
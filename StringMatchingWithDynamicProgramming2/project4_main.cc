@@ -1,15 +1,23 @@
 
 #include "project4.hh"
-#include "timer.hh"
-
-int main() {
-	ProteinVector proteins;
-	auto load_successful = load_proteins(proteins, "proteins_large.txt");
-	assert( load_successful );
+#include "wavefront.hh"
+#include "bench.hh"
 
+// An optional argument names another FASTA database, such as one written
+// by datagen.
+int main(int argc, char * argv[]) {
+	SequenceDatabase database;
+	const char * path = (argc > 1) ? argv[1] : "proteins_large.txt";
+	if (!database.load(path)) {
+		std::cerr << "error: cannot load \"" << path << "\"" << std::endl;
+		return 1;
+	}
+	if (database.empty()) {
+		std::cerr << "error: no proteins in \"" << path << "\"" << std::endl;
+		return 1;
+	}
     BlosumPenaltyArray bpa;
-	load_successful = load_blosum_file(bpa, "blosum62.txt");
-	assert( load_successful );
+	load_blosum62(bpa);
 
 	std::vector<std::string> testProteins;
 	
@@ -25,14 +33,23 @@ int main() {
 	testProteins.push_back("CSNPNLSDFGR");
 	testProteins.push_back("MYPEPTIDE");
 
+	// Every search is printed once, then timed under the benchmark harness.
+	BenchmarkOptions options;
+	options.time_budget = 0.5;
+
+	// Whole-database searches also report their hardware counters per DP
+	// cell, a query residue against a database residue.
+	double residues = database.residue_count();
+	BenchmarkOptions cell_options = options;
+	cell_options.work_unit = "cell";
+
 	std::cout << "------------------- Dynamic Programming ------------------" << std::endl;
 	for (int i = 0; i < testProteins.size(); i++) {
 		std::string align_string1;
 		std::string align_string2;
 		std::string searchString = 	testProteins[i];
-		Timer timer;
 		std::cout << "String to Match = " << testProteins[i] << std::endl;
-		std::shared_ptr<Protein> best_protein = local_alignment_best_match(proteins, 
+		std::shared_ptr<Protein> best_protein = local_alignment_best_match(database,
 																		  searchString, 
 																		  bpa, 
 																		  align_string1, 
@@ -40,8 +57,196 @@ int main() {
 		std::cout << best_protein->description << std::endl;
 		std::cout << align_string1 << std::endl;
 		std::cout << align_string2 << std::endl;
-		std::cout << timer.elapsed() << std::endl << std::endl;
+		// The same search as local_alignment_best_match, without its output.
+		std::vector<uint32_t> everything = all_candidates(database.size());
+		cell_options.work_per_call = searchString.size() * residues;
+		std::cout << benchmark("local_alignment_best_of", [&]() {
+			do_not_optimize(local_alignment_best_of(database, everything, searchString, bpa,
+													align_string1, align_string2));
+		}, cell_options) << std::endl << std::endl;
+	}
+
+	// The searches share the database's own index. Timing its build drops
+	// it first, so every call builds it from scratch, and leaves it built.
+	std::cout << "------------------- K-mer Seeded (k=3, top 100) ----------" << std::endl;
+	std::cout << benchmark("SequenceDatabase::kmer_index", [&]() {
+		database.changed();
+		do_not_optimize(database.kmer_index(3));
+	}, options) << std::endl << std::endl;
+	for (int i = 0; i < testProteins.size(); i++) {
+		std::string align_string1;
+		std::string align_string2;
+		std::shared_ptr<Protein> best_protein;
+		BenchmarkResult timing = benchmark("seeded local_alignment_best_match", [&]() {
+			best_protein = local_alignment_best_match(database,
+													  testProteins[i],
+													  bpa,
+													  align_string1,
+													  align_string2,
+													  100);
+		}, options);
+		std::cout << "String to Match = " << testProteins[i] << std::endl;
+		std::cout << best_protein->description << std::endl;
+		std::cout << align_string1 << std::endl;
+		std::cout << align_string2 << std::endl;
+		std::cout << timing << std::endl << std::endl;
+	}
+
+	// Banded alignment of each protein against a near-identical copy: one
+	// substitution every 50 residues and one deletion in the middle.
+	std::cout << "------------------- Banded (w=4) vs Full -----------------" << std::endl;
+	std::vector<std::string> originals, mutations;
+	for (size_t i = 0; i < database.size() && originals.size() < 50; i++) {
+		std::string original = database.sequence(i);
+		if (original.size() > 600) {
+			continue;
+		}
+		std::string mutated = original;
+		for (int k = 25; k < mutated.size(); k += 50) {
+			mutated[k] = (mutated[k] == 'W') ? 'A' : 'W';
+		}
+		mutated.erase(mutated.size() / 2, 1);
+		originals.push_back(original);
+		mutations.push_back(mutated);
+	}
+	int mismatches = 0;
+	int widest = 0;
+	{
+		std::string align_string1;
+		std::string align_string2;
+		for (int p = 0; p < originals.size(); p++) {
+			int width;
+			int full_score = local_alignment(originals[p], mutations[p], bpa, align_string1, align_string2);
+			int banded_score = local_alignment_banded(originals[p], mutations[p], bpa,
+													  align_string1, align_string2, 4, &width);
+			widest = std::max(widest, width);
+			mismatches += (full_score != banded_score);
+		}
+		std::cout << originals.size() << " pairs, widest band " << widest
+				  << ", score mismatches " << mismatches << std::endl;
+		std::cout << benchmark("full", [&]() {
+			for (int p = 0; p < originals.size(); p++) {
+				local_alignment(originals[p], mutations[p], bpa, align_string1, align_string2);
+			}
+		}, options) << std::endl;
+		std::cout << benchmark("banded", [&]() {
+			for (int p = 0; p < originals.size(); p++) {
+				local_alignment_banded(originals[p], mutations[p], bpa, align_string1, align_string2, 4);
+			}
+		}, options) << std::endl << std::endl;
+	}
+
+	std::cout << "------------------- Affine Gaps (open -12, extend -1) ----" << std::endl;
+	for (int i = 0; i < testProteins.size(); i++) {
+		std::string align_string1;
+		std::string align_string2;
+		int best_score = 0;
+		size_t best = 0;
+		std::vector<uint32_t> everything = all_candidates(database.size());
+		cell_options.work_per_call = testProteins[i].size() * residues;
+		BenchmarkResult timing = benchmark("affine local_alignment_best_of", [&]() {
+			best = local_alignment_best_of(database, everything, testProteins[i], bpa,
+										   align_string1, align_string2, &best_score, GapModel(-12, -1));
+		}, cell_options);
+		std::cout << "String to Match = " << testProteins[i] << std::endl;
+		std::cout << "SCORE = " << best_score << std::endl;
+		std::cout << database.description(best) << std::endl;
+		std::cout << align_string1 << std::endl;
+		std::cout << align_string2 << std::endl;
+		std::cout << timing << std::endl << std::endl;
+	}
+
+	SequenceBatches batches;
+	std::cout << "------------------- Inter-Sequence Batches ---------------" << std::endl;
+	BenchmarkResult build_timing = benchmark("build_sequence_batches", [&]() {
+		build_sequence_batches(batches, database);
+	}, options);
+	std::cout << batches.batches().size() << " batches, " << build_timing << std::endl << std::endl;
+	for (int i = 0; i < testProteins.size(); i++) {
+		std::string align_string1;
+		std::string align_string2;
+		std::shared_ptr<Protein> best_protein;
+		cell_options.work_per_call = testProteins[i].size() * residues;
+		BenchmarkResult timing = benchmark("batched local_alignment_best_match", [&]() {
+			best_protein = local_alignment_best_match(database,
+													  testProteins[i],
+													  bpa,
+													  align_string1,
+													  align_string2,
+													  batches);
+		}, cell_options);
+		std::cout << "String to Match = " << testProteins[i] << std::endl;
+		std::cout << best_protein->description << std::endl;
+		std::cout << align_string1 << std::endl;
+		std::cout << align_string2 << std::endl;
+		std::cout << timing << std::endl << std::endl;
+	}
+
+	std::cout << "------------------- Top 5 Hits ----------------------------" << std::endl;
+	for (int i = 0; i < testProteins.size(); i++) {
+		std::vector<AlignmentHit> hits;
+		BenchmarkResult timing = benchmark("local_alignment_best_matches", [&]() {
+			hits = local_alignment_best_matches(database, testProteins[i], bpa, 5);
+		}, options);
+		std::cout << "query " << i << ":";
+		for (const AlignmentHit & hit : hits) {
+			std::cout << " " << database.description(hit.protein).substr(0, 12) << "=" << hit.score;
+		}
+		std::cout << std::endl << timing << std::endl;
+	}
+	std::cout << std::endl;
+
+	std::cout << "------------------- Tiled Wavefront -----------------------" << std::endl;
+	// Two long strings, one from each half of the database.
+	std::string long1, long2;
+	size_t half = database.size() / 2;
+	for (size_t i = 0; i < half && long1.size() < 5000; i++) {
+		long1 += database.sequence(i);
+	}
+	for (size_t i = half; i < database.size() && long2.size() < 5000; i++) {
+		long2 += database.sequence(i);
+	}
+	if (long1.size() < 5000 || long2.size() < 5000) {
+		std::cout << "skipped: the database has too few residues for two 5000 residue strings"
+				  << std::endl;
+	}
+	else {
+		ThreadPool pool(ThreadPool::default_workers());
+		std::string align_string1;
+		std::string align_string2;
+		int score = 0;
+		BenchmarkResult timing = benchmark("local_alignment_wavefront", [&]() {
+			score = local_alignment_wavefront(long1, long2, bpa, align_string1, align_string2, pool);
+		}, options);
+		std::cout << long1.size() << " x " << long2.size() << " residues on " << pool.size()
+				  << " workers: score " << score << ", " << align_string1.size()
+				  << " columns" << std::endl << timing << std::endl;
+	}
+	std::cout << std::endl;
+
+	// Score-only database scan with the striped kernel on each instruction
+	// set this machine supports.
+	std::cout << "------------------- Striped Score-Only Scan --------------" << std::endl;
+	SimdPath paths[] = { SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2 };
+	cell_options.work_per_call = 0;
+	for (int i = 0; i < testProteins.size(); i++) {
+		cell_options.work_per_call += testProteins[i].size() * residues;
+	}
+	for (int p = 0; p < 3; p++) {
+		if (!simd_path_supported(paths[p])) {
+			continue;
+		}
+		int best = 0;
+		BenchmarkResult timing = benchmark(simd_path_name(paths[p]), [&]() {
+			best = 0;
+			for (int i = 0; i < testProteins.size(); i++) {
+				std::vector<int> scores = local_alignment_scores(database, testProteins[i], bpa, paths[p]);
+				best += *std::max_element(scores.begin(), scores.end());
+			}
+		}, cell_options);
+		std::cout << timing << " (sum of best scores " << best << ")" << std::endl;
 	}
+	std::cout << std::endl;
 
   return 0;
 }
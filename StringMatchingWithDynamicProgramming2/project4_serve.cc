@@ -0,0 +1,191 @@
+///////////////////////////////////////////////////////////////////////////////
+// project4_serve.cc
+//
+// Best-match query server. Loads the protein database and scoring matrix
+// (the built-in BLOSUM62 unless --blosum names a file) once, then answers
+// one query per line, either from stdin or from clients of a Unix socket:
+//
+//    ./serve [--threads N] [--proteins FILE] [--blosum FILE] [--socket PATH]
+//
+// Each answer is one line: score, protein description and the two aligned
+// strings, tab separated, in the order the queries arrived. The socket
+// server runs until SIGINT or SIGTERM and then removes its socket.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "search_engine.hh"
+
+// Write all of text to fd; false if the client went away (EPIPE,
+// ECONNRESET) or the write failed otherwise.
+static bool write_all(int fd, const std::string & text)
+{
+	size_t done = 0;
+	while (done < text.size()) {
+		ssize_t n = write(fd, text.data() + done, text.size() - done);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			return false;
+		}
+		done += n;
+	}
+	return true;
+}
+
+// Set by SIGINT and SIGTERM; the socket server stops accepting clients
+// and removes its socket.
+static volatile std::sig_atomic_t stopping = 0;
+
+static void request_stop(int)
+{
+	stopping = 1;
+}
+
+// Accept clients on a Unix socket at path, one at a time, and answer each
+// line they send until they close the connection. Runs until SIGINT or
+// SIGTERM, or until accept() fails with an error that waiting will not
+// fix; either way the socket file is removed.
+static int serve_socket(SearchEngine & engine, const std::string & path)
+{
+	sockaddr_un address;
+	std::memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(address.sun_path)) {
+		std::cerr << "Socket path too long [" << path << "]" << std::endl;
+		return 1;
+	}
+	std::strcpy(address.sun_path, path.c_str());
+
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	unlink(path.c_str());
+	if (listener < 0 ||
+		bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+		listen(listener, 16) != 0) {
+		std::cerr << "Failed to listen on [" << path << "]: " << std::strerror(errno) << std::endl;
+		return 1;
+	}
+	std::cerr << "Listening on " << path << std::endl;
+
+	// A client that disconnects before reading its answers must not take
+	// the server down: with SIGPIPE ignored the write fails with EPIPE
+	// instead, and only that connection is closed.
+	signal(SIGPIPE, SIG_IGN);
+
+	// Installed without SA_RESTART, so a blocked accept() or read()
+	// returns EINTR and the loop sees the request to stop.
+	struct sigaction action;
+	std::memset(&action, 0, sizeof(action));
+	action.sa_handler = request_stop;
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGINT, &action, nullptr);
+	sigaction(SIGTERM, &action, nullptr);
+
+	int status = 0;
+	while (!stopping) {
+		int client = accept(listener, nullptr, nullptr);
+		if (client < 0) {
+			if (errno == EINTR || errno == ECONNABORTED) {
+				continue;
+			}
+			// Out of descriptors or memory: retrying at once would only
+			// spin, so wait for some to be released.
+			if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+				std::cerr << "accept: " << std::strerror(errno) << ", retrying" << std::endl;
+				usleep(100 * 1000);
+				continue;
+			}
+			std::cerr << "accept: " << std::strerror(errno) << std::endl;
+			status = 1;
+			break;
+		}
+		std::string pending;
+		char buffer[4096];
+		bool open = true;
+		while (open) {
+			ssize_t n = read(client, buffer, sizeof(buffer));
+			if (n < 0 && errno == EINTR && !stopping) {
+				continue;
+			}
+			if (n <= 0) {
+				break;
+			}
+			pending.append(buffer, n);
+			size_t start = 0;
+			for (size_t end = pending.find('\n'); end != std::string::npos; end = pending.find('\n', start)) {
+				open = write_all(client, engine.answer(pending.substr(start, end - start)));
+				start = end + 1;
+				if (!open) {
+					break;
+				}
+			}
+			pending.erase(0, start);
+		}
+		if (open && !pending.empty()) {
+			write_all(client, engine.answer(pending));
+		}
+		close(client);
+	}
+	close(listener);
+	unlink(path.c_str());
+	return status;
+}
+
+int main(int argc, char * argv[]) {
+	unsigned threads = ThreadPool::default_workers();
+	std::string proteins_path = "proteins_large.txt";
+	std::string blosum_path;
+	std::string socket_path;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (i + 1 < argc && arg == "--threads") {
+			threads = std::atoi(argv[++i]);
+		}
+		else if (i + 1 < argc && arg == "--proteins") {
+			proteins_path = argv[++i];
+		}
+		else if (i + 1 < argc && arg == "--blosum") {
+			blosum_path = argv[++i];
+		}
+		else if (i + 1 < argc && arg == "--socket") {
+			socket_path = argv[++i];
+		}
+		else {
+			std::cerr << "usage: " << argv[0]
+					  << " [--threads N] [--proteins FILE] [--blosum FILE] [--socket PATH]" << std::endl;
+			return 2;
+		}
+	}
+
+	SequenceDatabase database;
+	BlosumPenaltyArray bpa;
+	if (blosum_path.empty()) {
+		load_blosum62(bpa);
+	}
+	else if (!load_blosum_file(bpa, blosum_path)) {
+		return 1;
+	}
+	if (!database.load(proteins_path)) {
+		return 1;
+	}
+	SearchEngine engine(database, bpa, threads);
+	std::cerr << "Loaded " << database.size() << " proteins, "
+			  << engine.workers() << " workers" << std::endl;
+
+	if (!socket_path.empty()) {
+		return serve_socket(engine, socket_path);
+	}
+	engine.serve(std::cin, std::cout);
+	return 0;
+}
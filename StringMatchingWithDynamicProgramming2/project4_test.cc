@@ -7,10 +7,17 @@
 
 
 #include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
 #include <sstream>
 
+#include "bench.hh"
+#include "datagen.hh"
 #include "project4.hh"
 #include "rubrictest.hh"
+#include "search_engine.hh"
+#include "wavefront.hh"
 #include "timer.hh"
 
 int main() {
@@ -24,10 +31,90 @@ int main() {
 		     TEST_EQUAL("size", 6639, proteins.size());
 		   });
 
+  rubric.criterion("load_proteins multi-line FASTA", 1, [&]() {
+		     const char * path = "multiline_test.fasta";
+		     std::ofstream ofs(path);
+		     ofs << ">first protein\r\nMMRG\nFKQR\n\nLIKK\n"
+		         << ">empty record\n"
+		         << ";comment line\n"
+		         << ">second protein\nAVPS AATT\nST";
+		     ofs.close();
+		     ProteinVector multi;
+		     TEST_TRUE("loaded", load_proteins(multi, path));
+		     std::remove(path);
+		     TEST_EQUAL("size", 2, multi.size());
+		     TEST_EQUAL("description 1", "first protein", multi[0]->description);
+		     TEST_EQUAL("sequence 1", "MMRGFKQRLIKK", multi[0]->sequence);
+		     TEST_EQUAL("description 2", "second protein", multi[1]->description);
+		     TEST_EQUAL("sequence 2", "AVPSAATTST", multi[1]->sequence);
+		   });
+
     BlosumPenaltyArray bpa;
 	load_successful = load_blosum_file(bpa, "blosum62.txt");
 	assert( load_successful );
 
+  rubric.criterion("dense BLOSUM penalties", 1, [&]() {
+		     TEST_EQUAL("A A", 4, bpa.get_penalty('A', 'A'));
+		     TEST_EQUAL("W C", -2, bpa.get_penalty('W', 'C'));
+		     TEST_EQUAL("gap", -4, bpa.get_penalty('K', '*'));
+		     TEST_EQUAL("unset", 0, bpa.get_penalty('J', 'A'));
+		     TEST_EQUAL("codes", bpa.get_penalty('Y', 'F'),
+		                bpa.get_code_penalty(residue_code('Y'), residue_code('F')));
+		     BlosumPenaltyArray copy(bpa);
+		     copy.set_penalty('J', 'A', -7);
+		     TEST_EQUAL("copy set", -7, copy.get_penalty('J', 'A'));
+		     TEST_EQUAL("copy kept", 11, copy.get_penalty('W', 'W'));
+		     TEST_EQUAL("original untouched", 0, bpa.get_penalty('J', 'A'));
+		     TEST_TRUE("in range", copy.set_penalty('J', 'W', INT8_MIN));
+		     TEST_EQUAL("lowest", INT8_MIN, copy.get_penalty('J', 'W'));
+		     uint64_t version = copy.version();
+		     TEST_FALSE("too high", copy.set_penalty('J', 'A', 200));
+		     TEST_FALSE("too low", copy.set_penalty('J', 'A', -129));
+		     TEST_EQUAL("rejected left alone", -7, copy.get_penalty('J', 'A'));
+		     TEST_EQUAL("rejected same version", version, copy.version());
+		   });
+
+  rubric.criterion("built-in and binary scoring matrices", 2, [&]() {
+		     BlosumPenaltyArray builtin;
+		     load_blosum62(builtin);
+		     TEST_EQUAL("builtin W W", 11, builtin.get_penalty('W', 'W'));
+		     TEST_EQUAL("builtin used", bpa.used_codes(), builtin.used_codes());
+		     TEST_EQUAL("builtin equals file", 0, std::memcmp(&bpa.penalty_table(), &builtin.penalty_table(),
+		                                                      sizeof(PenaltyTable)));
+		     const char * binary = "matrix_test.smx";
+		     TEST_TRUE("saved", save_scoring_matrix(builtin, binary));
+		     BlosumPenaltyArray reloaded;
+		     TEST_TRUE("binary loaded", load_blosum_file(reloaded, binary));
+		     std::remove(binary);
+		     TEST_EQUAL("binary round trip", 0, std::memcmp(&bpa.penalty_table(), &reloaded.penalty_table(),
+		                                                    sizeof(PenaltyTable)));
+		     const char * ncbi = "matrix_test.txt";
+		     std::ofstream ofs(ncbi);
+		     ofs << "#  Matrix made by matblas from blosum45.iij\n"
+		         << "#  * column uses minimum score\n"
+		         << "   A  R  W  *\n"
+		         << "A  5 -2 -2 -5\n"
+		         << "R -2  7 -2 -5\n"
+		         << "W -2 -2 15 -5\n"
+		         << "* -5 -5 -5  1\n";
+		     ofs.close();
+		     BlosumPenaltyArray small;
+		     TEST_TRUE("NCBI loaded", load_blosum_file(small, ncbi));
+		     TEST_EQUAL("NCBI W W", 15, small.get_penalty('W', 'W'));
+		     TEST_EQUAL("NCBI lower case", -2, small.get_penalty('a', 'r'));
+		     TEST_EQUAL("NCBI gap", -5, small.get_penalty('R', '*'));
+		     ofs.open(ncbi);
+		     ofs << "   A  R\nA  5 -2\n";
+		     ofs.close();
+		     TEST_FALSE("missing row", load_blosum_file(small, ncbi));
+		     ofs.open(ncbi);
+		     ofs << "   A  R\nA  5 -2\nR -2 200\n";
+		     ofs.close();
+		     TEST_FALSE("penalty out of range", load_blosum_file(small, ncbi));
+		     TEST_EQUAL("out of range left alone", 15, small.get_penalty('W', 'W'));
+		     std::remove(ncbi);
+		   });
+
 	std::string align_string1;
 	std::string align_string2;
 
@@ -80,6 +167,592 @@ int main() {
 		     TEST_EQUAL("alignment string 1b", "DE*FG", align_string2);
 		   });
   
-  return rubric.run();
+  rubric.criterion("local_alignment on packed sequences", 2,
+		   [&]() {
+		     std::string packed1, packed2;
+		     for (int i = 0; i < 10; i++) {
+		       std::string query = proteins[i]->sequence.substr(0, 12);
+		       const std::string & target = proteins[i + 1]->sequence;
+		       auto soln = local_alignment(query, target, bpa, align_string1, align_string2);
+		       auto packed = local_alignment(PackedSequence(query), PackedSequence(target),
+		                                     bpa, packed1, packed2);
+		       TEST_EQUAL("score", soln, packed);
+		       TEST_EQUAL("alignment 1", align_string1, packed1);
+		       TEST_EQUAL("alignment 2", align_string2, packed2);
+		     }
+		   });
+  
+  rubric.criterion("banded local_alignment", 2,
+		   [&]() {
+		     std::string banded1, banded2;
+		     int width = -1;
+		     auto soln = local_alignment_banded("ABC", "ABC", bpa, banded1, banded2, 0, &width);
+		     TEST_EQUAL("same 3", 17, soln);
+		     TEST_EQUAL("identical needs no band", 0, width);
+		     soln = local_alignment_banded("DEGH", "ABCDEFGHIJ", bpa, banded1, banded2, 1);
+		     TEST_EQUAL("score", 21, soln);
+		     TEST_EQUAL("alignment string 1a", "DE*GH", banded1);
+		     TEST_EQUAL("alignment string 1b", "DEFGH", banded2);
+		     // C/C and KA/KA both score 9; the band must not settle on the wrong one.
+		     local_alignment("CKA", "KAC", bpa, align_string1, align_string2);
+		     local_alignment_banded("CKA", "KAC", bpa, banded1, banded2, 0);
+		     TEST_EQUAL("tied alignment", align_string1, banded1);
+		     std::string original = proteins[7]->sequence.substr(0, 300);
+		     std::string mutated = original;
+		     mutated[40] = 'W';
+		     mutated.erase(150, 1);
+		     mutated[220] = 'C';
+		     auto full = local_alignment(original, mutated, bpa, align_string1, align_string2);
+		     soln = local_alignment_banded(original, mutated, bpa, banded1, banded2, 2, &width);
+		     TEST_EQUAL("near-identical score", full, soln);
+		     TEST_LT("near-identical band", width, 32);
+		     for (int i = 0; i < 10; i++) {
+		       std::string query = proteins[i]->sequence.substr(0, 20);
+		       std::string target = proteins[i + 1]->sequence.substr(0, 80);
+		       full = local_alignment(query, target, bpa, align_string1, align_string2);
+		       TEST_EQUAL("unrelated", full, local_alignment_banded(query, target, bpa, banded1, banded2, 1));
+		     }
+		   });
+
+  rubric.criterion("striped SIMD local_alignment_score", 2,
+		   [&]() {
+		     TEST_EQUAL("empty", 0, local_alignment_score("", "MMRG", bpa));
+		     std::string query = proteins[7]->sequence.substr(5, 40);
+		     std::string self1, self2;
+		     int full = local_alignment(query, proteins[7]->sequence, bpa, self1, self2);
+		     TEST_EQUAL("contained", full, local_alignment_score(query, proteins[7]->sequence, bpa));
+		     std::string longer = proteins[7]->sequence;
+		     TEST_TRUE("16-bit rescore", local_alignment_score(longer, longer, bpa, SIMD_SCALAR) > 255);
+		     SimdPath paths[] = { SIMD_SSE2, SIMD_AVX2 };
+		     for (SimdPath path : paths) {
+		       if (!simd_path_supported(path)) {
+		         continue;
+		       }
+		       TEST_EQUAL(simd_path_name(path), local_alignment_score(longer, longer, bpa, SIMD_SCALAR),
+		                  local_alignment_score(longer, longer, bpa, path));
+		       for (size_t i = 0; i < 200; i += 7) {
+		         std::string q = proteins[i]->sequence.substr(0, 5 + i % 60);
+		         for (size_t j = 300; j < 320; j++) {
+		           TEST_EQUAL(simd_path_name(path),
+		                      local_alignment_score(q, proteins[j]->sequence, bpa, SIMD_SCALAR),
+		                      local_alignment_score(q, proteins[j]->sequence, bpa, path));
+		         }
+		       }
+		     }
+		     BlosumPenaltyArray bonus(bpa);
+		     bonus.set_penalty('*', 'W', 1);
+		     TEST_EQUAL("positive gap", local_alignment_score("AW", "W", bonus, SIMD_SCALAR),
+		                local_alignment_score("AW", "W", bonus));
+		     auto scan = local_alignment_scores(proteins, query, bpa);
+		     TEST_EQUAL("scan size", proteins.size(), scan.size());
+		     TEST_EQUAL("scan", local_alignment_score(query, proteins[7]->sequence, bpa), scan[7]);
+		   }).concurrent().time_budget(30);
+
+  rubric.criterion("linear-space local alignment", 2,
+		   [&]() {
+		     std::string linear1, linear2;
+		     auto soln = local_alignment_linear_space("DEGH", "ABCDEFGHIJ", bpa, linear1, linear2);
+		     TEST_EQUAL("score", 21, soln);
+		     TEST_EQUAL("alignment string 1a", "DE*GH", linear1);
+		     TEST_EQUAL("alignment string 1b", "DEFGH", linear2);
+		     TEST_EQUAL("unrelated", 0, local_alignment_linear_space("W", "A", bpa, linear1, linear2));
+		     TEST_EQUAL("unrelated alignment", "", linear1);
+		     for (int i = 0; i < 10; i++) {
+		       std::string query = proteins[i]->sequence.substr(0, 30);
+		       const std::string & target = proteins[i + 20]->sequence;
+		       soln = local_alignment_linear_space(query, target, bpa, linear1, linear2);
+		       TEST_EQUAL("score", local_alignment_score(query, target, bpa), soln);
+		       int rescored = 0;
+		       for (size_t k = 0; k < linear1.size(); k++) {
+		         rescored += bpa.get_penalty(linear1[k], linear2[k]);
+		       }
+		       TEST_EQUAL("alignment scores", soln, rescored);
+		     }
+		     std::string query = proteins[100]->sequence.substr(20, 15);
+		     int best_score = 0;
+		     size_t best = local_alignment_best_of(proteins, all_candidates(proteins.size()), query,
+		                                           bpa, linear1, linear2, &best_score);
+		     auto scan = local_alignment_scores(proteins, query, bpa);
+		     TEST_EQUAL("winner", *std::max_element(scan.begin(), scan.end()), best_score);
+		     TEST_EQUAL("first winner",
+		                static_cast<size_t>(std::max_element(scan.begin(), scan.end()) - scan.begin()), best);
+		     TEST_EQUAL("winner alignment", query, linear1);
+		   }).concurrent().time_budget(15);
+
+  rubric.criterion("affine gap local alignment", 2,
+		   [&]() {
+		     GapModel blast(-12, -1);
+		     std::string affine1, affine2;
+		     auto soln = local_alignment_affine("ABCDEFGHIKLM", "ABCDEFWWWGHIKLM", bpa, blast,
+		                                        affine1, affine2);
+		     TEST_EQUAL("alignment string 1", "ABCDEF***GHIKLM", affine1);
+		     TEST_EQUAL("alignment string 2", "ABCDEFWWWGHIKLM", affine2);
+		     TEST_EQUAL("score", local_alignment_score("ABCDEFGHIKLM", "ABCDEFWWWGHIKLM", bpa,
+		                                               SIMD_SCALAR, blast), soln);
+		     GapModel linear(-4, -4);
+		     std::string query = proteins[3]->sequence.substr(10, 50);
+		     for (size_t j = 40; j < 60; j++) {
+		       const std::string & target = proteins[j]->sequence;
+		       TEST_EQUAL("open == extend is linear", local_alignment_score(query, target, bpa, SIMD_SCALAR),
+		                  local_alignment_score(query, target, bpa, SIMD_SCALAR, linear));
+		       int scalar = local_alignment_score(query, target, bpa, SIMD_SCALAR, blast);
+		       TEST_EQUAL("SIMD", scalar, local_alignment_score(query, target, bpa, SIMD_AUTO, blast));
+		       TEST_EQUAL("traceback", scalar, local_alignment_affine(query, target, bpa, blast,
+		                                                               affine1, affine2));
+		     }
+		     int best_score = 0;
+		     local_alignment_best_of(proteins, all_candidates(100), query, bpa, affine1, affine2,
+		                             &best_score, blast);
+		     TEST_EQUAL("best_of", local_alignment_score(query, proteins[3]->sequence, bpa,
+		                                                         SIMD_AUTO, blast), best_score);
+		     TEST_EQUAL("best_of alignment", query, affine1);
+		   }).concurrent().time_budget(5);
+
+  rubric.criterion("inter-sequence batch scores", 2,
+		   [&]() {
+		     ProteinVector few(proteins.begin(), proteins.begin() + 150);
+		     few.push_back(std::shared_ptr<Protein>(new Protein(">star", "MKW*WKM")));
+		     few.push_back(std::shared_ptr<Protein>(new Protein(">empty", "")));
+		     SequenceBatches batches;
+		     build_sequence_batches(batches, few);
+		     TEST_EQUAL("size", few.size(), batches.size());
+		     TEST_EQUAL("batches", 5, batches.batches().size());
+		     std::string queries[] = { "PIEPCMGA", "WKW", few[60]->sequence.substr(0, 120) };
+		     SimdPath paths[] = { SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2 };
+		     GapModel models[] = { GapModel(), GapModel(-12, -1) };
+		     for (const std::string & query : queries) {
+		       std::vector<uint8_t> codes(query.size());
+		       encode_residues(query.data(), query.size(), codes.data());
+		       for (SimdPath path : paths) {
+		         if (!simd_path_supported(path)) {
+		           continue;
+		         }
+		         for (const GapModel & gaps : models) {
+		           auto batched = interseq_scores(batches, codes.data(), codes.size(),
+		                                          bpa.penalty_table(), path, gaps);
+		           auto striped = local_alignment_scores(few, query, bpa, SIMD_SCALAR, gaps);
+		           TEST_TRUE(simd_path_name(path), batched == striped);
+		         }
+		       }
+		     }
+		     std::string batched1, batched2, plain1, plain2;
+		     std::string query = few[90]->sequence.substr(30, 9);
+		     auto batched = local_alignment_best_match(few, query, bpa, batched1, batched2, batches);
+		     auto plain = few[local_alignment_best_of(few, all_candidates(few.size()), query,
+		                                              bpa, plain1, plain2)];
+		     TEST_EQUAL("best match", plain, batched);
+		     TEST_EQUAL("alignment", plain1, batched1);
+		     SequenceDatabase database(few);
+		     SequenceBatches database_batches;
+		     build_sequence_batches(database_batches, database);
+		     TEST_TRUE("database scores", local_alignment_scores(database, query, bpa) ==
+		                                  local_alignment_scores(few, query, bpa));
+		     auto from_database = local_alignment_best_match(database, query, bpa, batched1, batched2,
+		                                                     database_batches);
+		     TEST_EQUAL("database best match", plain->description, from_database->description);
+		     TEST_EQUAL("database alignment", plain1, batched1);
+		   }).concurrent().time_budget(40);
+
+  rubric.criterion("local_alignment best cell and top-K hits", 2,
+		   [&]() {
+		     auto soln = local_alignment("WWWCCKDE", "CCKAAAAW", bpa, align_string1, align_string2);
+		     TEST_EQUAL("best cell off the bottom row", 23, soln);
+		     TEST_EQUAL("alignment string 1", "CCK", align_string1);
+		     TEST_EQUAL("alignment string 2", "CCK", align_string2);
+		     soln = local_alignment("WCCPPPPPPPPPPPPKDE", "WCCAKDE", bpa, align_string1, align_string2);
+		     TEST_EQUAL("restart", 0, align_string1.find_first_not_of("KDE"));
+		     TEST_EQUAL("restart score", local_alignment_score("WCCPPPPPPPPPPPPKDE", "WCCAKDE", bpa), soln);
+		     ProteinVector few(proteins.begin(), proteins.begin() + 300);
+		     std::string query = few[42]->sequence.substr(15, 25);
+		     auto hits = local_alignment_best_matches(few, query, bpa, 10);
+		     TEST_EQUAL("count", 10, hits.size());
+		     TEST_EQUAL("self first", 42, hits[0].protein);
+		     auto scores = local_alignment_scores(few, query, bpa);
+		     std::vector<int> sorted(scores);
+		     std::sort(sorted.rbegin(), sorted.rend());
+		     for (size_t h = 0; h < hits.size(); h++) {
+		       TEST_EQUAL("ranked", sorted[h], hits[h].score);
+		       TEST_EQUAL("score", scores[hits[h].protein], hits[h].score);
+		       if (h > 0 && hits[h].score == hits[h - 1].score) {
+		         TEST_TRUE("ties in database order", hits[h - 1].protein < hits[h].protein);
+		       }
+		     }
+		     TEST_EQUAL("none", 0, local_alignment_best_matches(few, query, bpa, 0).size());
+		     SequenceDatabase database(few);
+		     auto database_hits = local_alignment_best_matches(database, query, bpa, 10);
+		     TEST_EQUAL("database count", hits.size(), database_hits.size());
+		     for (size_t h = 0; h < hits.size() && h < database_hits.size(); h++) {
+		       TEST_EQUAL("database hit", hits[h].protein, database_hits[h].protein);
+		       TEST_EQUAL("database hit score", hits[h].score, database_hits[h].score);
+		     }
+		   });
+
+  KmerIndex index(3);
+  build_kmer_index(index, proteins);
+
+  rubric.criterion("k-mer seeded local_alignment_best_match", 2,
+		   [&]() {
+		     TEST_EQUAL("indexed", proteins.size(), index.size());
+		     std::string query = proteins[100]->sequence.substr(20, 15);
+		     auto shortlist = index.candidates(query, 5);
+		     TEST_FALSE("has candidates", shortlist.empty());
+		     TEST_EQUAL("source ranked first", 100, shortlist[0]);
+		     std::string seeded1, seeded2, exact1, exact2;
+		     auto seeded = local_alignment_best_match(proteins, query, bpa, seeded1, seeded2, index, 50);
+		     auto exact = local_alignment_best_match(proteins, query, bpa, exact1, exact2, index, 50, true);
+		     TEST_EQUAL("same protein", exact->description, seeded->description);
+		     TEST_EQUAL("same alignment", exact1, seeded1);
+		     TEST_EQUAL("full match", query, seeded1);
+		     int score = -1;
+		     TEST_EQUAL("no candidates", NO_MATCH, local_alignment_best_of(proteins, std::vector<uint32_t>(),
+		                                                                   query, bpa, exact1, exact2, &score));
+		     TEST_EQUAL("no score", 0, score);
+		     TEST_EQUAL("no alignment", "", exact1);
+		     ProteinVector none;
+		     KmerIndex empty_index(3);
+		     empty_index.build();
+		     TEST_TRUE("empty database", local_alignment_best_match(none, query, bpa, seeded1, seeded2,
+		                                                            empty_index, 50) == nullptr);
+		   });
+
+  rubric.criterion("sequence database", 1,
+		   [&]() {
+		     ProteinVector some(proteins.begin(), proteins.begin() + 150);
+		     SequenceDatabase database(some);
+		     TEST_EQUAL("size", some.size(), database.size());
+		     TEST_EQUAL("sequence", some[60]->sequence, database.sequence(60));
+		     TEST_EQUAL("description", some[60]->description, database[60]->description);
+		     SequenceBatches from_codes, from_proteins;
+		     build_sequence_batches(from_codes, database);
+		     build_sequence_batches(from_proteins, some);
+		     std::string query = database[60]->sequence.substr(10, 40);
+		     std::vector<uint8_t> codes(query.size());
+		     encode_residues(query.data(), query.size(), codes.data());
+		     TEST_TRUE("same batch scores",
+		               interseq_scores(from_codes, codes.data(), codes.size(), bpa.penalty_table(), SIMD_AUTO)
+		               == interseq_scores(from_proteins, codes.data(), codes.size(), bpa.penalty_table(), SIMD_AUTO));
+		     std::string seeded1, seeded2, exact1, exact2;
+		     auto seeded = local_alignment_best_match(database, query, bpa, seeded1, seeded2, 20);
+		     auto exact = local_alignment_best_match(some, query, bpa, exact1, exact2,
+		                                             database.kmer_index(), 20, true);
+		     TEST_EQUAL("seeded on its own index", exact->description, seeded->description);
+		     TEST_EQUAL("same alignment", exact1, seeded1);
+		   });
+  
+  rubric.criterion("cached local_alignment_best_match", 2,
+		   [&]() {
+		     ProteinVector few(proteins.begin(), proteins.begin() + 40);
+		     SequenceDatabase database(few);
+		     ResultCache cache;
+		     std::string query = few[30]->sequence.substr(10, 12);
+		     std::string cached1, cached2, plain1, plain2;
+		     auto plain = few[local_alignment_best_of(few, all_candidates(few.size()), query,
+		                                              bpa, plain1, plain2)];
+		     auto first = local_alignment_best_match(database, query, bpa, cached1, cached2, cache);
+		     TEST_EQUAL("same protein", plain->description, first->description);
+		     TEST_EQUAL("same alignment", plain1, cached1);
+		     auto second = local_alignment_best_match(database, query, bpa, cached1, cached2, cache);
+		     TEST_EQUAL("hit", 1, cache.hits());
+		     TEST_EQUAL("hit protein", first->description, second->description);
+		     TEST_EQUAL("hit alignment", plain2, cached2);
+		     BlosumPenaltyArray changed(bpa);
+		     changed.set_penalty('W', 'W', 12);
+		     local_alignment_best_match(database, query, changed, cached1, cached2, cache);
+		     TEST_EQUAL("new matrix misses", 2, cache.misses());
+		     database.changed();
+		     local_alignment_best_match(database, query, bpa, cached1, cached2, cache);
+		     TEST_EQUAL("new version misses", 3, cache.misses());
+		   });
+  
+  rubric.criterion("scratch arena reuse", 2,
+		   [&]() {
+		     ProteinVector few(proteins.begin(), proteins.begin() + 100);
+		     AlignmentContext & context = AlignmentContext::for_thread();
+		     std::string query = few[17]->sequence.substr(5, 20);
+		     auto scan = [&]() {
+		       int total = 0;
+		       for (size_t i = 0; i < few.size(); i++) {
+		         total += local_alignment(query, few[i]->sequence, bpa, align_string1, align_string2);
+		         total += local_alignment_affine(query, few[i]->sequence, bpa, GapModel(-12, -1),
+		                                         align_string1, align_string2);
+		       }
+		       return total;
+		     };
+		     int first = scan();
+		     size_t allocations = context.allocations();
+		     size_t frames = context.frames();
+		     TEST_EQUAL("same scores", first, scan());
+		     TEST_EQUAL("one frame per call", frames + 2 * few.size(), context.frames());
+		     TEST_EQUAL("no allocations once warm", allocations, context.allocations());
+		     std::string other1, other2;
+		     int score = 0;
+		     std::thread other([&]() {
+		       score = local_alignment("CCKAAAAW", "WWWCCKDE", bpa, other1, other2);
+		       TEST_TRUE("own context per thread", &AlignmentContext::for_thread() != &context);
+		     });
+		     other.join();
+		     TEST_EQUAL("other thread", 23, score);
+		     TEST_EQUAL("other thread alignment", "CCK", other1);
+		   });
+
+  rubric.criterion("tiled wavefront local_alignment", 2,
+		   [&]() {
+		     ThreadPool pool(3);
+		     std::string wave1, wave2;
+		     TEST_EQUAL("empty", 0, local_alignment_wavefront("", "ABC", bpa, wave1, wave2, pool));
+		     TEST_EQUAL("empty alignment", "", wave1);
+		     std::string long1, long2;
+		     for (int i = 0; long1.size() < 1200; i++) {
+		       long1 += proteins[i]->sequence;
+		     }
+		     for (int i = 7; long2.size() < 900; i++) {
+		       long2 += proteins[i]->sequence;
+		     }
+		     const std::string pairs[][2] = { { "WWWCCKDE", "CCKAAAAW" },
+		                                      { "WCCPPPPPPPPPPPPKDE", "WCCAKDE" },
+		                                      { long1, long2 } };
+		     for (const auto & pair : pairs) {
+		       int plain = local_alignment(pair[0], pair[1], bpa, align_string1, align_string2);
+		       for (int tile : { 1, 3, 64 }) {
+		         TEST_EQUAL("score", plain, local_alignment_wavefront(pair[0], pair[1], bpa,
+		                                                              wave1, wave2, pool, tile));
+		         TEST_EQUAL("alignment string 1", align_string1, wave1);
+		         TEST_EQUAL("alignment string 2", align_string2, wave2);
+		       }
+		     }
+		   });
+
+  rubric.criterion("thread pool search engine", 2,
+		   [&]() {
+		     ProteinVector few(proteins.begin(), proteins.begin() + 500);
+		     SequenceDatabase database(few);
+		     SearchEngine engine(database, bpa, 3);
+		     TEST_EQUAL("workers", 3, engine.workers());
+		     std::stringstream in, out, expected;
+		     for (int q = 0; q < 6; q++) {
+		       std::string query = few[q * 71]->sequence.substr(q, 8 + q * 3);
+		       std::string plain1, plain2;
+		       int plain_score = 0;
+		       size_t plain = local_alignment_best_of(few, all_candidates(few.size()), query,
+		                                              bpa, plain1, plain2, &plain_score);
+		       SearchResult result = engine.search(query);
+		       TEST_EQUAL("same protein", plain, result.protein);
+		       TEST_EQUAL("same score", plain_score, result.score);
+		       TEST_EQUAL("same alignment", plain1, result.match1);
+		       in << query << "\n";
+		       expected << plain_score << "\t" << few[plain]->description << "\t"
+		                << plain1 << "\t" << plain2 << "\n";
+		     }
+		     TEST_EQUAL("answered", 6, engine.serve(in, out));
+		     TEST_EQUAL("in query order", expected.str(), out.str());
+		     TEST_EQUAL("no hit", 0, engine.search("").score);
+
+		     // A striped query reset for another query scores as a new one
+		     // would, and once both its profiles have been built, in the
+		     // storage it already has.
+		     auto codes_of = [&database](size_t i) {
+		       std::vector<uint8_t> codes(database.length(i));
+		       database.codes(i, codes.data());
+		       return codes;
+		     };
+		     std::vector<uint8_t> long_query = codes_of(7), short_query = codes_of(9);
+		     short_query.resize(std::min<size_t>(short_query.size(), long_query.size() / 2));
+		     std::vector<uint8_t> target = codes_of(11);
+		     StripedQuery reused(long_query.data(), long_query.size(), bpa.penalty_table());
+		     reused.score(target.data(), target.size());
+		     reused.reset(short_query.data(), short_query.size());
+		     reused.score(target.data(), target.size());
+		     reused.reset(long_query.data(), long_query.size());
+		     reused.score(target.data(), target.size());
+		     AllocationStats stats;
+		     int score;
+		     {
+		       AllocationScope scope(stats);
+		       reused.reset(short_query.data(), short_query.size());
+		       score = reused.score(target.data(), target.size());
+		     }
+		     StripedQuery fresh(short_query.data(), short_query.size(), bpa.penalty_table());
+		     TEST_EQUAL("reset scores as new", fresh.score(target.data(), target.size()), score);
+		     if (stats.available) {
+		       TEST_EQUAL("reset reuses its storage", 0, stats.thread_allocations);
+		     }
+		   });
+
+  rubric.criterion("benchmark counters degrade gracefully", 1,
+		   [&]() {
+		     // Counters may or may not be permitted here; either way a scope
+		     // must work, and only the counters that opened report values.
+		     PerfCounters counters;
+		     CounterValues values;
+		     std::string align_string1, align_string2;
+		     {
+		       CounterScope scope(counters, values);
+		       local_alignment(proteins[0]->sequence, proteins[1]->sequence, bpa,
+		                       align_string1, align_string2);
+		     }
+		     TEST_EQUAL("available iff counted", counters.available(), values.available != 0);
+		     if (values.has(PERF_CYCLES) && values.has(PERF_INSTRUCTIONS)) {
+		       TEST_TRUE("cycles counted", values.counts[PERF_CYCLES] > 0);
+		       TEST_TRUE("positive IPC", values.ipc() > 0);
+		     }
+		     CounterValues halves = values.per(2);
+		     for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+		       TEST_EQUAL("per unit", values.counts[c] / 2, halves.counts[c]);
+		     }
+
+		     PerfCounters disabled(false);
+		     TEST_FALSE("disabled", disabled.available());
+
+		     BenchmarkOptions options;
+		     options.time_budget = 0.05;
+		     options.counters = false;
+		     options.work_per_call = 100;
+		     options.work_unit = "cell";
+		     BenchmarkResult result = benchmark("sum", [&]() {
+		       int sum = 0;
+		       for (int i = 0; i < 100; i++) {
+		         sum += i;
+		       }
+		       do_not_optimize(sum);
+		     }, options);
+		     TEST_EQUAL("no counters when off", 0u, result.counters.available);
+		     TEST_EQUAL("work unit", std::string("cell"), result.work_unit);
+		     TEST_TRUE("timed", result.median > 0);
+		   }).exclusive();
+
+  rubric.criterion("allocation accounting", 1,
+		   [&]() {
+		     // Exact counts are only for this thread's share: the global
+		     // counters also see whatever other threads of the process do.
+		     AllocationStats stats;
+		     {
+		       AllocationScope scope(stats);
+		       std::vector<int> * block = new std::vector<int>(1000);
+		       delete block;
+		     }
+		     size_t bytes = sizeof(std::vector<int>) + 1000 * sizeof(int);
+		     TEST_TRUE("available", stats.available);
+		     TEST_EQUAL("allocations", 2u, stats.thread_allocations);
+		     TEST_EQUAL("bytes", bytes, stats.thread_bytes);
+		     TEST_GE("global allocations", stats.allocations, stats.thread_allocations);
+		     TEST_GE("global bytes", stats.bytes, stats.thread_bytes);
+
+		     AllocationStats elsewhere;
+		     {
+		       AllocationScope scope(elsewhere);
+		       std::thread other([]() { delete new std::vector<int>(10); });
+		       other.join();
+		     }
+		     TEST_GE("other thread counted", elsewhere.allocations, 2u);
+		     TEST_GE("other thread's bytes", elsewhere.bytes - elsewhere.thread_bytes, 10 * sizeof(int));
+
+		     BenchmarkOptions options;
+		     options.time_budget = 0.05;
+		     options.counters = false;
+		     BenchmarkResult result = benchmark("vector", [&]() {
+		       std::vector<char> buffer(4096);
+		       do_not_optimize(buffer);
+		     }, options);
+		     TEST_GE("allocation per call", result.allocations, 1.0);
+		     TEST_GE("bytes per call", result.allocated_bytes, 4096.0);
+		     TEST_TRUE("resident set", result.peak_rss > 0);
+		   }).exclusive();
+
+  rubric.criterion("scoped trace export", 1,
+		   [&]() {
+		     // TraceScope records whether or not TRACE_SCOPE is compiled in.
+		     trace_clear();
+		     {
+		       TraceScope outer("outer");
+		       std::thread worker([]() { TraceScope inner("worker"); });
+		       worker.join();
+		     }
+		     std::vector<TraceEvent> events = trace_events();
+		     TEST_EQUAL("two events", 2, events.size());
+		     bool outer = false, worker = false;
+		     for (const TraceEvent & event : events) {
+		       outer = outer || std::string(event.name) == "outer";
+		       worker = worker || std::string(event.name) == "worker";
+		     }
+		     TEST_TRUE("both names", outer && worker);
+		     TEST_NOT_EQUAL("own thread buffers", events[0].thread, events[1].thread);
+		     std::stringstream json;
+		     trace_write_json(json);
+		     TEST_TRUE("chrome format", json.str().find("{\"traceEvents\":[") == 0);
+		     TEST_TRUE("complete events", json.str().find("\"name\":\"worker\",\"ph\":\"X\"")
+		                                  != std::string::npos);
+		     trace_clear();
+		     TEST_EQUAL("cleared", 0, trace_events().size());
+		   });
+
+  rubric.criterion("synthetic protein databases", 1,
+		   [&]() {
+		     std::ostringstream first, again;
+		     write_fasta(first, 200, 1);
+		     write_fasta(again, 200, 1);
+		     TEST_TRUE("same seed, same database", first.str() == again.str());
+		     {
+		       std::ofstream out("datagen_test_proteins.txt");
+		       out << first.str();
+		     }
+		     ProteinVector synthetic;
+		     bool loaded = load_proteins(synthetic, "datagen_test_proteins.txt");
+		     std::remove("datagen_test_proteins.txt");
+		     TEST_TRUE("loads", loaded);
+		     TEST_EQUAL("size", 200, synthetic.size());
+		     // Leucine is the most common residue of the background.
+		     std::vector<size_t> counts(RESIDUE_CODES, 0);
+		     for (const auto & protein : synthetic) {
+		       for (char residue : protein->sequence) {
+		         counts[residue_code(residue)]++;
+		       }
+		     }
+		     TEST_EQUAL("background frequencies", residue_code('L'),
+		                std::max_element(counts.begin(), counts.end()) - counts.begin());
+		     TEST_EQUAL("standard residues only", 0, counts[RESIDUE_UNKNOWN] + counts[residue_code('X')]);
+		   });
+
+  rubric.criterion("concurrent and timed criteria", 1,
+		   [&]() {
+		     std::ostringstream report;
+		     Rubric inner(report);
+		     std::atomic<int> ran(0);
+		     for (int c = 0; c < 4; c++) {
+		       inner.criterion("quick " + std::to_string(c), 1, [&]() { ran++; }).concurrent();
+		     }
+		     inner.criterion("slow", 1, [&]() {
+		       Timer timer;
+		       while (timer.elapsed() < 0.05) {
+		       }
+		     }).time_budget(0.01);
+		     inner.criterion("failing", 1, [&]() { TEST_FAIL("expected"); }).concurrent();
+		     // The exclusive criterion must see none of the slow concurrent
+		     // ones running, though they were declared on either side of it.
+		     std::atomic<int> running(0);
+		     bool alone = false;
+		     auto busy = [&]() {
+		       running++;
+		       std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		       running--;
+		     };
+		     for (int c = 0; c < 3; c++) {
+		       inner.criterion("busy " + std::to_string(c), 1, busy).concurrent();
+		     }
+		     inner.criterion("alone", 1, [&]() { alone = running.load() == 0; }).exclusive();
+		     for (int c = 3; c < 6; c++) {
+		       inner.criterion("busy " + std::to_string(c), 1, busy).concurrent();
+		     }
+		     TEST_EQUAL("fails", 1, inner.run(3));
+		     TEST_EQUAL("all ran", 4, ran.load());
+		     TEST_TRUE("exclusive runs alone", alone);
+		     std::string text = report.str();
+		     TEST_TRUE("declaration order", text.find("quick 0: passed") < text.find("quick 3: passed")
+		                                    && text.find("quick 3: passed") < text.find("slow:"));
+		     TEST_TRUE("over budget", text.find("over time budget") != std::string::npos);
+		     TEST_TRUE("timed", inner.seconds(4) >= 0.05);
+		     TEST_TRUE("score", text.find("TOTAL SCORE = 11 / 13") != std::string::npos);
+		   });
+
+  return rubric.run(Rubric::default_workers());
 }
 
@@ -0,0 +1,67 @@
+///////////////////////////////////////////////////////////////////////////////
+// scoring_matrix.hh
+//
+// Built-in BLOSUM62 and the compact binary file format for substitution
+// matrices.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <cstdint>
+
+#include "residues.hh"
+
+// -------------------------------------------------------------------------
+// BLOSUM62, exactly as in blosum62.txt. Rows and columns follow
+// BLOSUM62_ALPHABET, which is also the order of the first residue codes, so
+// BLOSUM62_MATRIX[code1][code2] is the penalty of two residue codes.
+// -------------------------------------------------------------------------
+const int BLOSUM62_SIZE = 24;
+const char BLOSUM62_ALPHABET[] = "ARNDCQEGHILKMFPSTWYVBZX*";
+
+constexpr int8_t BLOSUM62_MATRIX[BLOSUM62_SIZE][BLOSUM62_SIZE] = {
+	{  4, -1, -2, -2,  0, -1, -1,  0, -2, -1, -1, -1, -1, -2, -1,  1,  0, -3, -2,  0, -2, -1,  0, -4 },	// A
+	{ -1,  5,  0, -2, -3,  1,  0, -2,  0, -3, -2,  2, -1, -3, -2, -1, -1, -3, -2, -3, -1,  0, -1, -4 },	// R
+	{ -2,  0,  6,  1, -3,  0,  0,  0,  1, -3, -3,  0, -2, -3, -2,  1,  0, -4, -2, -3,  3,  0, -1, -4 },	// N
+	{ -2, -2,  1,  6, -3,  0,  2, -1, -1, -3, -4, -1, -3, -3, -1,  0, -1, -4, -3, -3,  4,  1, -1, -4 },	// D
+	{  0, -3, -3, -3,  9, -3, -4, -3, -3, -1, -1, -3, -1, -2, -3, -1, -1, -2, -2, -1, -3, -3, -2, -4 },	// C
+	{ -1,  1,  0,  0, -3,  5,  2, -2,  0, -3, -2,  1,  0, -3, -1,  0, -1, -2, -1, -2,  0,  3, -1, -4 },	// Q
+	{ -1,  0,  0,  2, -4,  2,  5, -2,  0, -3, -3,  1, -2, -3, -1,  0, -1, -3, -2, -2,  1,  4, -1, -4 },	// E
+	{  0, -2,  0, -1, -3, -2, -2,  6, -2, -4, -4, -2, -3, -3, -2,  0, -2, -2, -3, -3, -1, -2, -1, -4 },	// G
+	{ -2,  0,  1, -1, -3,  0,  0, -2,  8, -3, -3, -1, -2, -1, -2, -1, -2, -2,  2, -3,  0,  0, -1, -4 },	// H
+	{ -1, -3, -3, -3, -1, -3, -3, -4, -3,  4,  2, -3,  1,  0, -3, -2, -1, -3, -1,  3, -3, -3, -1, -4 },	// I
+	{ -1, -2, -3, -4, -1, -2, -3, -4, -3,  2,  4, -2,  2,  0, -3, -2, -1, -2, -1,  1, -4, -3, -1, -4 },	// L
+	{ -1,  2,  0, -1, -3,  1,  1, -2, -1, -3, -2,  5, -1, -3, -1,  0, -1, -3, -2, -2,  0,  1, -1, -4 },	// K
+	{ -1, -1, -2, -3, -1,  0, -2, -3, -2,  1,  2, -1,  5,  0, -2, -1, -1, -1, -1,  1, -3, -1, -1, -4 },	// M
+	{ -2, -3, -3, -3, -2, -3, -3, -3, -1,  0,  0, -3,  0,  6, -4, -2, -2,  1,  3, -1, -3, -3, -1, -4 },	// F
+	{ -1, -2, -2, -1, -3, -1, -1, -2, -2, -3, -3, -1, -2, -4,  7, -1, -1, -4, -3, -2, -2, -1, -2, -4 },	// P
+	{  1, -1,  1,  0, -1,  0,  0,  0, -1, -2, -2,  0, -1, -2, -1,  4,  1, -3, -2, -2,  0,  0,  0, -4 },	// S
+	{  0, -1,  0, -1, -1, -1, -1, -2, -2, -1, -1, -1, -1, -2, -1,  1,  5, -2, -2,  0, -1, -1,  0, -4 },	// T
+	{ -3, -3, -4, -4, -2, -2, -3, -2, -2, -3, -2, -3, -1,  1, -4, -3, -2, 11,  2, -3, -4, -3, -2, -4 },	// W
+	{ -2, -2, -2, -3, -2, -1, -2, -3,  2, -1, -1, -2, -1,  3, -3, -2, -2,  2,  7, -1, -3, -2, -1, -4 },	// Y
+	{  0, -3, -3, -3, -1, -2, -2, -3, -3,  3,  1, -2,  1, -1, -2, -2,  0, -3, -1,  4, -3, -2, -1, -4 },	// V
+	{ -2, -1,  3,  4, -3,  0,  1, -1,  0, -3, -4,  0, -3, -3, -2,  0, -1, -4, -3, -3,  4,  1, -1, -4 },	// B
+	{ -1,  0,  0,  1, -3,  3,  4, -2,  0, -3, -3,  1, -1, -3, -1,  0, -1, -3, -2, -2,  1,  4, -1, -4 },	// Z
+	{  0, -1, -1, -1, -2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -2,  0,  0, -2, -1, -1, -1, -1, -1, -4 },	// X
+	{ -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4,  1 },	// *
+};
+
+// Lowest entry of BLOSUM62, the bias of its unsigned SIMD profiles.
+constexpr int BLOSUM62_LOWEST = -4;
+
+static_assert(BLOSUM62_MATRIX[17][17] == 11, "W/W of BLOSUM62");
+static_assert(BLOSUM62_MATRIX[RESIDUE_GAP][0] == BLOSUM62_LOWEST, "gap row of BLOSUM62");
+
+// -------------------------------------------------------------------------
+// Binary matrix files, for matrices that load with one read and no
+// parsing:
+//
+//    4 bytes   SCORING_MATRIX_MAGIC
+//    1 byte    size, the number of residues k
+//    k bytes   the residue letters, in row order
+//    k * k     signed bytes, the penalties row by row
+// -------------------------------------------------------------------------
+const char SCORING_MATRIX_MAGIC[] = "SMX1";
+const int SCORING_MATRIX_MAGIC_SIZE = 4;
@@ -0,0 +1,157 @@
+///////////////////////////////////////////////////////////////////////////////
+// search_engine.hh
+//
+// Long-lived local_alignment_best_match service: the protein database and
+// BLOSUM matrix are loaded once, then any number of queries are answered,
+// each database scan shared out over a persistent thread pool.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "project4.hh"
+#include "thread_pool.hh"
+
+// The answer to one query: the best protein's position in the database,
+// its score, and the aligned strings as local_alignment_best_match gives
+// them.
+struct SearchResult {
+	size_t			protein;
+	int				score;
+	std::string		match1;
+	std::string		match2;
+};
+
+// -------------------------------------------------------------------------
+// Answers best-match queries against a fixed SequenceDatabase, whose
+// packed residue codes the workers decode as they scan, so a query costs
+// only its scan and one traceback. Each scan is cut into chunks of CHUNK
+// proteins that the workers claim in turn. Every worker keeps, from one
+// query to the next, its own striped query (profile and DP rows, reset for
+// each query in the storage the last one left) and decoding buffer, and
+// its own best hit, which are merged once the scan is done. The result is
+// the same protein and score as local_alignment_best_of over
+// all_candidates: the first on ties.
+//
+// database and bpa must outlive the engine and stay unchanged. search() and
+// serve() are meant for one calling thread at a time.
+// -------------------------------------------------------------------------
+class SearchEngine {
+public:
+	enum { CHUNK = 64 };
+
+	SearchEngine(const SequenceDatabase & database,
+				 const BlosumPenaltyArray & bpa,
+				 unsigned workers = ThreadPool::default_workers(),
+				 const GapModel & gaps = GapModel())
+		: _database(database), _bpa(bpa), _gaps(gaps), _pool(workers), _workers(_pool.size()) { }
+
+	unsigned workers() const {
+		return _workers.size();
+	}
+
+	SearchResult search(const std::string & query) {
+		SearchResult result = { 0, 0, "", "" };
+		if (_database.empty()) {
+			return result;
+		}
+		std::vector<uint8_t> codes1(query.size());
+		encode_residues(query.data(), query.size(), codes1.data());
+
+		std::atomic<size_t> next(0);
+		std::function<void(unsigned)> scan = [&](unsigned w) {
+			Worker & worker = _workers[w];
+			if (worker.query) {
+				worker.query->reset(codes1.data(), codes1.size());
+			}
+			else {
+				worker.query.reset(new StripedQuery(codes1.data(), codes1.size(),
+													_bpa.penalty_table(), SIMD_AUTO, _gaps));
+			}
+			worker.best = 0;
+			worker.best_i = _database.size();
+			size_t count = _database.size();
+			for (size_t first = next.fetch_add(CHUNK); first < count; first = next.fetch_add(CHUNK)) {
+				size_t last = std::min<size_t>(first + CHUNK, count);
+				for (size_t i = first; i < last; i++) {
+					worker.target.resize(_database.length(i));
+					_database.codes(i, worker.target.data());
+					int score = worker.query->score(worker.target.data(), worker.target.size());
+					if (score > worker.best || (score == worker.best && i < worker.best_i)) {
+						worker.best = score;
+						worker.best_i = i;
+					}
+				}
+			}
+		};
+		_pool.run(scan);
+
+		// Chunks are claimed in order, but any worker may hold any of them;
+		// the lowest position wins among equal scores.
+		for (const Worker & worker : _workers) {
+			if (worker.best_i == _database.size()) {
+				continue;
+			}
+			if (worker.best > result.score || (worker.best == result.score && worker.best_i < result.protein)) {
+				result.score = worker.best;
+				result.protein = worker.best_i;
+			}
+		}
+		if (result.score == 0) {
+			result.protein = 0;
+		}
+
+		std::string sequence = _database.sequence(result.protein);
+		local_alignment_winner(query, sequence, _bpa, _gaps, result.match1, result.match2);
+		return result;
+	}
+
+	// One line of service output for a query line: score, description and
+	// the two aligned strings, tab separated. A trailing carriage return on
+	// the query is ignored.
+	std::string answer(std::string line) {
+		if (!line.empty() && line.back() == '\r') {
+			line.pop_back();
+		}
+		SearchResult result = search(line);
+		std::string description = _database.empty() ? "" : _database.description(result.protein);
+		return std::to_string(result.score) + "\t" + description + "\t" +
+			result.match1 + "\t" + result.match2 + "\n";
+	}
+
+	// Answer every line of in, one output line per query line, in order,
+	// flushing after each so a client can wait for its answer. Returns the
+	// number of queries answered.
+	size_t serve(std::istream & in, std::ostream & out) {
+		size_t answered = 0;
+		std::string line;
+		while (std::getline(in, line)) {
+			out << answer(line) << std::flush;
+			answered++;
+		}
+		return answered;
+	}
+
+private:
+	struct Worker {
+		std::unique_ptr<StripedQuery>	query;	// built by the first query
+		std::vector<uint8_t>			target;	// codes of the protein being scored
+		int								best;
+		size_t							best_i;
+	};
+
+	const SequenceDatabase &	_database;
+	const BlosumPenaltyArray &	_bpa;
+	GapModel					_gaps;
+	ThreadPool					_pool;
+	std::vector<Worker>			_workers;
+};
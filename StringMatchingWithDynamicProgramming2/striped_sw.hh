@@ -0,0 +1,509 @@
+///////////////////////////////////////////////////////////////////////////////
+// striped_sw.hh
+//
+// Score-only Smith-Waterman local alignment on SIMD vectors, using Farrar's
+// striped query layout, with a scalar reference version. The instruction
+// set is picked at run time, so the same binary runs on any x86 machine.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cstdint>
+#include <vector>
+
+#include "residues.hh"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define STRIPED_SW_X86 1
+#include <immintrin.h>
+#endif
+
+// Penalty of aligning residue code a with residue code b is table[a][b];
+// a gap is the code RESIDUE_GAP.
+typedef int8_t PenaltyTable[RESIDUE_CODES][RESIDUE_CODES];
+
+enum SimdPath {
+	SIMD_AUTO,
+	SIMD_SCALAR,
+	SIMD_SSE2,
+	SIMD_AVX2
+};
+
+const char * simd_path_name(SimdPath path)
+{
+	switch (path) {
+		case SIMD_SCALAR: return "scalar";
+		case SIMD_SSE2: return "SSE2";
+		case SIMD_AVX2: return "AVX2";
+		default: return "auto";
+	}
+}
+
+// Whether this machine can run the given path.
+bool simd_path_supported(SimdPath path)
+{
+	switch (path) {
+		case SIMD_AUTO:
+		case SIMD_SCALAR:
+			return true;
+#ifdef STRIPED_SW_X86
+		case SIMD_SSE2:
+			return __builtin_cpu_supports("sse2");
+		case SIMD_AVX2:
+			return __builtin_cpu_supports("avx2");
+#endif
+		default:
+			return false;
+	}
+}
+
+// The widest path this machine can run.
+SimdPath best_simd_path()
+{
+	if (simd_path_supported(SIMD_AVX2)) {
+		return SIMD_AVX2;
+	}
+	if (simd_path_supported(SIMD_SSE2)) {
+		return SIMD_SSE2;
+	}
+	return SIMD_SCALAR;
+}
+
+// -------------------------------------------------------------------------
+// How gaps are scored. The default, linear model charges every residue of
+// a gap its penalty from the RESIDUE_GAP row or column of the matrix. The
+// affine (Gotoh) model charges open for the first residue of a gap and
+// extend for each further one, whatever the residues; BLAST's usual 11/1
+// for BLOSUM62 is GapModel(-12, -1).
+//
+// "up" gaps skip a residue of the query (string1), "left" gaps skip a
+// residue of the target (string2), as in local_alignment.
+// -------------------------------------------------------------------------
+struct GapModel {
+	GapModel() : affine(false), open(0), extend(0) { }
+	GapModel(int gap_open, int gap_extend) : affine(true), open(gap_open), extend(gap_extend) { }
+
+	int up_open(const PenaltyTable & penalties, uint8_t code) const {
+		return affine ? open : penalties[code][RESIDUE_GAP];
+	}
+	int up_extend(const PenaltyTable & penalties, uint8_t code) const {
+		return affine ? extend : penalties[code][RESIDUE_GAP];
+	}
+	int left_open(const PenaltyTable & penalties, uint8_t code) const {
+		return affine ? open : penalties[RESIDUE_GAP][code];
+	}
+	int left_extend(const PenaltyTable & penalties, uint8_t code) const {
+		return affine ? extend : penalties[RESIDUE_GAP][code];
+	}
+
+	bool	affine;
+	int		open;
+	int		extend;
+};
+
+// -------------------------------------------------------------------------
+// Reference local alignment score: the best cell anywhere in the
+// Smith-Waterman matrix of query (rows) against target (columns), with the
+// same recurrence as local_alignment, or Gotoh's for affine gaps. Keeps a
+// single row of each matrix, so it runs in O(m) memory.
+// -------------------------------------------------------------------------
+int local_alignment_score_scalar(const uint8_t * query, int n,
+								 const uint8_t * target, int m,
+								 const PenaltyTable & penalties,
+								 const GapModel & gaps = GapModel())
+{
+	const int none = INT_MIN / 2;
+	int left_open[RESIDUE_CODES], left_extend[RESIDUE_CODES];
+	for (int code = 0; code < RESIDUE_CODES; code++) {
+		left_open[code] = gaps.left_open(penalties, code);
+		left_extend[code] = gaps.left_extend(penalties, code);
+	}
+	std::vector<int> row(m + 1, 0), up(m + 1, none);
+	int best = 0;
+	for (int i = 1; i <= n; i++) {
+		const int8_t * scores = penalties[query[i - 1]];
+		int up_open = gaps.up_open(penalties, query[i - 1]);
+		int up_extend = gaps.up_extend(penalties, query[i - 1]);
+		int diag = 0;
+		int left = none;
+		for (int j = 1; j <= m; j++) {
+			uint8_t b = target[j - 1];
+			left = std::max(row[j - 1] + left_open[b], left + left_extend[b]);
+			up[j] = std::max(row[j] + up_open, up[j] + up_extend);
+			int cell = std::max(std::max(up[j], left), std::max(diag + scores[b], 0));
+			diag = row[j];
+			row[j] = cell;
+			best = std::max(best, cell);
+		}
+	}
+	return best;
+}
+
+// Gap costs of a striped query, as non-negative amounts to subtract. A gap
+// skipping query position i costs up_open for its first residue and
+// up_extend for each further one (striped like the profile); a gap
+// skipping a target residue costs left_open/left_extend of its code.
+template <typename Elem>
+struct StripedGaps {
+	const Elem *	up_open;
+	const Elem *	up_extend;
+	const Elem *	left_open;
+	const Elem *	left_extend;
+};
+
+#ifdef STRIPED_SW_X86
+
+#pragma GCC push_options
+#pragma GCC target("sse2")
+namespace striped_sse2 {
+
+// 16 unsigned byte lanes. Scores are stored without bias and floor at 0;
+// profile entries carry +bias so that they are never negative.
+struct U8 {
+	typedef __m128i V;
+	typedef uint8_t Elem;
+	enum { LANES = 16 };
+	static V zero() { return _mm_setzero_si128(); }
+	static V set1(int x) { return _mm_set1_epi8(static_cast<char>(x)); }
+	static V load(const Elem * p) { return _mm_loadu_si128(reinterpret_cast<const V *>(p)); }
+	static void store(Elem * p, V v) { _mm_storeu_si128(reinterpret_cast<V *>(p), v); }
+	static V diag(V h, V score, V bias) { return _mm_subs_epu8(_mm_adds_epu8(h, score), bias); }
+	static V gap(V h, V cost) { return _mm_subs_epu8(h, cost); }
+	static V max(V a, V b) { return _mm_max_epu8(a, b); }
+	static V shift(V a) { return _mm_slli_si128(a, 1); }
+	static bool any_greater(V a, V b) {
+		return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_subs_epu8(a, b), zero())) != 0xFFFF;
+	}
+	static int horizontal_max(V a) {
+		Elem lanes[LANES];
+		store(lanes, a);
+		return *std::max_element(lanes, lanes + LANES);
+	}
+};
+
+// 8 signed 16-bit lanes, for scores that overflow a byte.
+struct I16 {
+	typedef __m128i V;
+	typedef int16_t Elem;
+	enum { LANES = 8 };
+	static V zero() { return _mm_setzero_si128(); }
+	static V set1(int x) { return _mm_set1_epi16(static_cast<short>(x)); }
+	static V load(const Elem * p) { return _mm_loadu_si128(reinterpret_cast<const V *>(p)); }
+	static void store(Elem * p, V v) { _mm_storeu_si128(reinterpret_cast<V *>(p), v); }
+	static V diag(V h, V score, V) { return _mm_max_epi16(_mm_adds_epi16(h, score), zero()); }
+	static V gap(V h, V cost) { return _mm_subs_epi16(h, cost); }
+	static V max(V a, V b) { return _mm_max_epi16(a, b); }
+	static V shift(V a) { return _mm_slli_si128(a, 2); }
+	static bool any_greater(V a, V b) {
+		return _mm_movemask_epi8(_mm_cmpgt_epi16(a, b)) != 0;
+	}
+	static int horizontal_max(V a) {
+		Elem lanes[LANES];
+		store(lanes, a);
+		return *std::max_element(lanes, lanes + LANES);
+	}
+};
+
+#include "striped_sw_kernel.inl"
+
+int score_u8(const uint8_t * profile, const StripedGaps<uint8_t> & gaps, int seg_len,
+			 const uint8_t * target, int m, int bias,
+			 uint8_t * h_load, uint8_t * h_store, uint8_t * e)
+{
+	return striped_score<U8>(profile, gaps, seg_len, target, m, bias, h_load, h_store, e);
+}
+
+int score_i16(const int16_t * profile, const StripedGaps<int16_t> & gaps, int seg_len,
+			  const uint8_t * target, int m,
+			  int16_t * h_load, int16_t * h_store, int16_t * e)
+{
+	return striped_score<I16>(profile, gaps, seg_len, target, m, 0, h_load, h_store, e);
+}
+
+} // namespace striped_sse2
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+namespace striped_avx2 {
+
+// Moves every lane of a 256-bit vector up by bytes, across the two
+// 128-bit halves, filling with zeros.
+#define STRIPED_AVX2_SHIFT(a, bytes) \
+	_mm256_alignr_epi8((a), _mm256_permute2x128_si256((a), (a), 0x08), 16 - (bytes))
+
+struct U8 {
+	typedef __m256i V;
+	typedef uint8_t Elem;
+	enum { LANES = 32 };
+	static V zero() { return _mm256_setzero_si256(); }
+	static V set1(int x) { return _mm256_set1_epi8(static_cast<char>(x)); }
+	static V load(const Elem * p) { return _mm256_loadu_si256(reinterpret_cast<const V *>(p)); }
+	static void store(Elem * p, V v) { _mm256_storeu_si256(reinterpret_cast<V *>(p), v); }
+	static V diag(V h, V score, V bias) { return _mm256_subs_epu8(_mm256_adds_epu8(h, score), bias); }
+	static V gap(V h, V cost) { return _mm256_subs_epu8(h, cost); }
+	static V max(V a, V b) { return _mm256_max_epu8(a, b); }
+	static V shift(V a) { return STRIPED_AVX2_SHIFT(a, 1); }
+	static bool any_greater(V a, V b) {
+		return _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_subs_epu8(a, b), zero())) != -1;
+	}
+	static int horizontal_max(V a) {
+		Elem lanes[LANES];
+		store(lanes, a);
+		return *std::max_element(lanes, lanes + LANES);
+	}
+};
+
+struct I16 {
+	typedef __m256i V;
+	typedef int16_t Elem;
+	enum { LANES = 16 };
+	static V zero() { return _mm256_setzero_si256(); }
+	static V set1(int x) { return _mm256_set1_epi16(static_cast<short>(x)); }
+	static V load(const Elem * p) { return _mm256_loadu_si256(reinterpret_cast<const V *>(p)); }
+	static void store(Elem * p, V v) { _mm256_storeu_si256(reinterpret_cast<V *>(p), v); }
+	static V diag(V h, V score, V) { return _mm256_max_epi16(_mm256_adds_epi16(h, score), zero()); }
+	static V gap(V h, V cost) { return _mm256_subs_epi16(h, cost); }
+	static V max(V a, V b) { return _mm256_max_epi16(a, b); }
+	static V shift(V a) { return STRIPED_AVX2_SHIFT(a, 2); }
+	static bool any_greater(V a, V b) {
+		return _mm256_movemask_epi8(_mm256_cmpgt_epi16(a, b)) != 0;
+	}
+	static int horizontal_max(V a) {
+		Elem lanes[LANES];
+		store(lanes, a);
+		return *std::max_element(lanes, lanes + LANES);
+	}
+};
+
+#undef STRIPED_AVX2_SHIFT
+
+#include "striped_sw_kernel.inl"
+
+int score_u8(const uint8_t * profile, const StripedGaps<uint8_t> & gaps, int seg_len,
+			 const uint8_t * target, int m, int bias,
+			 uint8_t * h_load, uint8_t * h_store, uint8_t * e)
+{
+	return striped_score<U8>(profile, gaps, seg_len, target, m, bias, h_load, h_store, e);
+}
+
+int score_i16(const int16_t * profile, const StripedGaps<int16_t> & gaps, int seg_len,
+			  const uint8_t * target, int m,
+			  int16_t * h_load, int16_t * h_store, int16_t * e)
+{
+	return striped_score<I16>(profile, gaps, seg_len, target, m, 0, h_load, h_store, e);
+}
+
+} // namespace striped_avx2
+#pragma GCC pop_options
+
+#endif // STRIPED_SW_X86
+
+// -------------------------------------------------------------------------
+// A query prepared for scoring against many targets. The query profile is
+// built once, in 8-bit lanes; a target whose score saturates 8 bits is
+// rescored in 16-bit lanes, and one that saturates those with the scalar
+// reference, so every path returns the same score as
+// local_alignment_score_scalar.
+//
+// Positive gap penalties cannot be expressed as saturating subtractions,
+// so a gap model (or a target residue) with one takes the scalar path, as
+// does an affine model whose gaps cost less to open than to extend.
+// The object keeps scratch rows between calls; use one per thread.
+// -------------------------------------------------------------------------
+class StripedQuery {
+public:
+	StripedQuery(const uint8_t * query, int n,
+				 const PenaltyTable & penalties,
+				 SimdPath path = SIMD_AUTO,
+				 const GapModel & gaps = GapModel())
+		: _penalties(penalties), _gaps(gaps), _requested_path(path), _precision(0) {
+		reset(query, n);
+	}
+
+	// Prepare for another query with the same penalties, path and gaps. The
+	// profiles and scratch rows are rebuilt in the storage the last query
+	// left, so a long-lived object stops allocating once it has seen its
+	// longest query.
+	void reset(const uint8_t * query, int n) {
+		_query.assign(query, query + n);
+		_path = (_requested_path == SIMD_AUTO) ? best_simd_path() : _requested_path;
+		assert(simd_path_supported(_path));
+		for (int i = 0; i < n; i++) {
+			int open = _gaps.up_open(_penalties, query[i]);
+			int extend = _gaps.up_extend(_penalties, query[i]);
+			if (open > 0 || extend > 0 || open > extend) {
+				_path = SIMD_SCALAR;
+			}
+		}
+		_positive_left_gaps = 0;
+		for (int code = 0; code < RESIDUE_CODES; code++) {
+			if (_gaps.left_open(_penalties, code) > 0 || _gaps.left_extend(_penalties, code) > 0) {
+				_positive_left_gaps |= 1u << code;
+			}
+		}
+
+		int lowest = 0;
+		for (int i = 0; i < n; i++) {
+			for (int code = 0; code < RESIDUE_CODES; code++) {
+				lowest = std::min(lowest, static_cast<int>(_penalties[query[i]][code]));
+			}
+		}
+		_bias = -lowest;
+
+		if (_path != SIMD_SCALAR && n > 0) {
+			build_profile(_u8, UINT8_MAX, 0, _bias);
+		}
+		_i16.built = false;
+	}
+
+	SimdPath path() const {
+		return _path;
+	}
+
+	// Lane width in bits used for the last score() call: 8, 16, or 32 for
+	// the scalar reference.
+	int last_precision() const {
+		return _precision;
+	}
+
+	int score(const uint8_t * target, int m) {
+		int n = _query.size();
+		if (n == 0 || m == 0) {
+			_precision = 32;
+			return 0;
+		}
+		bool scalar = (_path == SIMD_SCALAR);
+		for (int j = 0; j < m && !scalar && _positive_left_gaps != 0; j++) {
+			scalar = (_positive_left_gaps & (1u << target[j])) != 0;
+		}
+		if (!scalar) {
+			int best = run_u8(target, m);
+			if (best + _bias < UINT8_MAX) {
+				_precision = 8;
+				return best;
+			}
+			if (!_i16.built) {
+				build_profile(_i16, INT16_MAX, INT16_MIN, 0);
+			}
+			best = run_i16(target, m);
+			if (best < INT16_MAX - INT8_MAX) {
+				_precision = 16;
+				return best;
+			}
+		}
+		_precision = 32;
+		return local_alignment_score_scalar(_query.data(), n, target, m, _penalties, _gaps);
+	}
+
+private:
+	template <typename Elem>
+	struct Profile {
+		Profile() : seg_len(0), built(false) { }
+
+		int					seg_len;
+		bool				built;		// for the current query
+		std::vector<Elem>	profile;	// RESIDUE_CODES * seg_len * lanes
+		std::vector<Elem>	up_open;	// seg_len * lanes
+		std::vector<Elem>	up_extend;
+		std::vector<Elem>	left_open;	// RESIDUE_CODES
+		std::vector<Elem>	left_extend;
+		std::vector<Elem>	h_load;
+		std::vector<Elem>	h_store;
+		std::vector<Elem>	e;
+
+		StripedGaps<Elem> gaps() const {
+			StripedGaps<Elem> g = { up_open.data(), up_extend.data(),
+									left_open.data(), left_extend.data() };
+			return g;
+		}
+	};
+
+	int lanes_for(size_t elem_size) const {
+		return ((_path == SIMD_AVX2) ? 32 : 16) / elem_size;
+	}
+
+	// Striped layout: query position i goes to lane i / seg_len of vector
+	// i % seg_len. Padding past the end of the query scores pad_score
+	// against everything and blocks vertical gaps with the largest cost,
+	// max_cost, which also caps the gap costs.
+	template <typename Elem>
+	void build_profile(Profile<Elem> & p, int max_cost, int pad_score, int bias) {
+		int n = _query.size();
+		int lanes = lanes_for(sizeof(Elem));
+		auto cost = [max_cost](int penalty) { return std::min(max_cost, std::max(0, -penalty)); };
+		p.seg_len = (n + lanes - 1) / lanes;
+		int stride = p.seg_len * lanes;
+		p.profile.assign(RESIDUE_CODES * stride, 0);
+		p.up_open.assign(stride, max_cost);
+		p.up_extend.assign(stride, max_cost);
+		for (int s = 0; s < p.seg_len; s++) {
+			for (int lane = 0; lane < lanes; lane++) {
+				int i = lane * p.seg_len + s;
+				int at = s * lanes + lane;
+				if (i < n) {
+					p.up_open[at] = cost(_gaps.up_open(_penalties, _query[i]));
+					p.up_extend[at] = cost(_gaps.up_extend(_penalties, _query[i]));
+				}
+				for (int code = 0; code < RESIDUE_CODES; code++) {
+					p.profile[code * stride + at] =
+						(i < n) ? _penalties[_query[i]][code] + bias : pad_score;
+				}
+			}
+		}
+		p.left_open.resize(RESIDUE_CODES);
+		p.left_extend.resize(RESIDUE_CODES);
+		for (int code = 0; code < RESIDUE_CODES; code++) {
+			p.left_open[code] = cost(_gaps.left_open(_penalties, code));
+			p.left_extend[code] = cost(_gaps.left_extend(_penalties, code));
+		}
+		p.h_load.assign(stride, 0);
+		p.h_store.assign(stride, 0);
+		p.e.assign(stride, 0);
+		p.built = true;
+	}
+
+	int run_u8(const uint8_t * target, int m) {
+#ifdef STRIPED_SW_X86
+		Profile<uint8_t> & p = _u8;
+		if (_path == SIMD_AVX2) {
+			return striped_avx2::score_u8(p.profile.data(), p.gaps(), p.seg_len, target, m, _bias,
+										  p.h_load.data(), p.h_store.data(), p.e.data());
+		}
+		return striped_sse2::score_u8(p.profile.data(), p.gaps(), p.seg_len, target, m, _bias,
+									  p.h_load.data(), p.h_store.data(), p.e.data());
+#else
+		return UINT8_MAX;
+#endif
+	}
+
+	int run_i16(const uint8_t * target, int m) {
+#ifdef STRIPED_SW_X86
+		Profile<int16_t> & p = _i16;
+		if (_path == SIMD_AVX2) {
+			return striped_avx2::score_i16(p.profile.data(), p.gaps(), p.seg_len, target, m,
+										   p.h_load.data(), p.h_store.data(), p.e.data());
+		}
+		return striped_sse2::score_i16(p.profile.data(), p.gaps(), p.seg_len, target, m,
+									   p.h_load.data(), p.h_store.data(), p.e.data());
+#else
+		return INT16_MAX;
+#endif
+	}
+
+	std::vector<uint8_t>	_query;
+	const PenaltyTable &	_penalties;
+	GapModel				_gaps;
+	SimdPath				_requested_path;
+	SimdPath				_path;
+	uint32_t				_positive_left_gaps;
+	int						_bias;
+	int						_precision;
+	Profile<uint8_t>		_u8;
+	Profile<int16_t>		_i16;
+};
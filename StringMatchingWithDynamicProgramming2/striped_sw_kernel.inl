@@ -0,0 +1,100 @@
+///////////////////////////////////////////////////////////////////////////////
+// striped_sw_kernel.inl
+//
+// Body of the striped Smith-Waterman score kernel. striped_sw.hh includes
+// this file once per instruction set, inside a namespace that defines the
+// vector operations (Ops) for that instruction set, so that the AVX2 copy
+// can be compiled with AVX2 enabled while the rest of the program is not.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// -------------------------------------------------------------------------
+// Farrar's striped score-only Smith-Waterman with Gotoh affine gaps.
+// Linear gaps are the case open == extend.
+//
+// Query position i lives in lane i / seg_len of vector i % seg_len, so the
+// cell above a given cell is in the previous vector, same lane. profile
+// holds, for each residue code, seg_len vectors of the penalties of the
+// query against that code. h_load, h_store and e are seg_len vectors of
+// scratch each. Returns the best cell value found anywhere in the matrix.
+// -------------------------------------------------------------------------
+template <class Ops>
+int striped_score(const typename Ops::Elem * profile,
+				  const StripedGaps<typename Ops::Elem> & gaps,
+				  int seg_len,
+				  const uint8_t * target, int m,
+				  int bias,
+				  typename Ops::Elem * h_load,
+				  typename Ops::Elem * h_store,
+				  typename Ops::Elem * e)
+{
+	typedef typename Ops::V V;
+	const int lanes = Ops::LANES;
+	const V zero = Ops::zero();
+	const V vBias = Ops::set1(bias);
+	V vMax = zero;
+
+	for (int s = 0; s < seg_len; s++) {
+		Ops::store(h_load + s * lanes, zero);
+		Ops::store(h_store + s * lanes, zero);
+		Ops::store(e + s * lanes, zero);
+	}
+
+	for (int j = 0; j < m; j++) {
+		const typename Ops::Elem * column = profile + target[j] * seg_len * lanes;
+		const V vLeftOpen = Ops::set1(gaps.left_open[target[j]]);
+		const V vLeftExtend = Ops::set1(gaps.left_extend[target[j]]);
+
+		// The diagonal of vector 0 is the last vector of the previous
+		// column, moved up one lane.
+		V vH = Ops::shift(Ops::load(h_store + (seg_len - 1) * lanes));
+		std::swap(h_load, h_store);
+		V vF = zero;
+		V vLastF = zero;
+
+		for (int s = 0; s < seg_len; s++) {
+			vH = Ops::diag(vH, Ops::load(column + s * lanes), vBias);
+			V vHLeft = Ops::load(h_load + s * lanes);
+			V vE = Ops::max(Ops::gap(vHLeft, vLeftOpen),
+							Ops::gap(Ops::load(e + s * lanes), vLeftExtend));
+			Ops::store(e + s * lanes, vE);
+			vH = Ops::max(vH, vE);
+			vH = Ops::max(vH, vF);
+			vMax = Ops::max(vMax, vH);
+			Ops::store(h_store + s * lanes, vH);
+			vLastF = vF;
+			if (s + 1 < seg_len) {
+				vF = Ops::max(Ops::gap(vH, Ops::load(gaps.up_open + (s + 1) * lanes)),
+							  Ops::gap(vF, Ops::load(gaps.up_extend + (s + 1) * lanes)));
+			}
+			vH = vHLeft;
+		}
+
+		// Lazy F loop: carry gaps from the bottom of one lane into the top
+		// of the next, for as long as the carried gap beats the one the
+		// main loop already opened from the cell above. Opening costs at
+		// least as much as extending, so a cell raised by the carried gap
+		// opens nothing the carried gap does not already cover.
+		V vLastH = Ops::shift(Ops::load(h_store + (seg_len - 1) * lanes));
+		vF = Ops::max(Ops::gap(vLastH, Ops::load(gaps.up_open)),
+					  Ops::gap(Ops::shift(vLastF), Ops::load(gaps.up_extend)));
+		int s = 0;
+		while (true) {
+			V vHs = Ops::load(h_store + s * lanes);
+			Ops::store(h_store + s * lanes, Ops::max(vHs, vF));
+			vMax = Ops::max(vMax, vF);
+			if (++s == seg_len) {
+				s = 0;
+				vF = Ops::shift(vF);
+				vHs = Ops::shift(vHs);
+			}
+			vF = Ops::gap(vF, Ops::load(gaps.up_extend + s * lanes));
+			V vOpened = Ops::gap(vHs, Ops::load(gaps.up_open + s * lanes));
+			if (!Ops::any_greater(vF, Ops::max(vOpened, zero))) {
+				break;
+			}
+		}
+	}
+
+	return Ops::horizontal_max(vMax);
+}
@@ -0,0 +1,104 @@
+///////////////////////////////////////////////////////////////////////////////
+// thread_pool.hh
+//
+// A fixed set of worker threads that stay alive between jobs, so a server
+// answering many queries pays for thread creation once rather than once
+// per query.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// -------------------------------------------------------------------------
+// Fork-join pool: run() hands one job to every worker, each called with its
+// own worker number (0 .. size() - 1), and returns once all of them have
+// finished. Workers sleep between jobs. The thread calling run() only
+// waits, so the pool should have as many workers as there are cores.
+// run() is not reentrant; call it from one thread at a time.
+// -------------------------------------------------------------------------
+class ThreadPool {
+public:
+	explicit ThreadPool(unsigned workers) : _job(nullptr), _generation(0), _running(0), _stop(false) {
+		if (workers == 0) {
+			workers = 1;
+		}
+		for (unsigned w = 0; w < workers; w++) {
+			_threads.emplace_back(&ThreadPool::work, this, w);
+		}
+	}
+
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+		_wake.notify_all();
+		for (std::thread & thread : _threads) {
+			thread.join();
+		}
+	}
+
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool & operator=(const ThreadPool &) = delete;
+
+	unsigned size() const {
+		return _threads.size();
+	}
+
+	void run(const std::function<void(unsigned)> & job) {
+		std::unique_lock<std::mutex> lock(_mutex);
+		_job = &job;
+		_running = _threads.size();
+		_generation++;
+		_wake.notify_all();
+		_done.wait(lock, [this]() { return _running == 0; });
+		_job = nullptr;
+	}
+
+	// Worker count to use when none is asked for: one per core.
+	static unsigned default_workers() {
+		unsigned cores = std::thread::hardware_concurrency();
+		return (cores == 0) ? 1 : cores;
+	}
+
+private:
+	void work(unsigned worker) {
+		uint64_t seen = 0;
+		while (true) {
+			const std::function<void(unsigned)> * job;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_wake.wait(lock, [this, seen]() { return _stop || _generation != seen; });
+				if (_stop) {
+					return;
+				}
+				seen = _generation;
+				job = _job;
+			}
+			(*job)(worker);
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				if (--_running == 0) {
+					_done.notify_one();
+				}
+			}
+		}
+	}
+
+	std::vector<std::thread>					_threads;
+	std::mutex									_mutex;
+	std::condition_variable						_wake;
+	std::condition_variable						_done;
+	const std::function<void(unsigned)> *		_job;
+	uint64_t									_generation;
+	size_t										_running;
+	bool										_stop;
+};
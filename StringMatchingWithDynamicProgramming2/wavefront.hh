@@ -0,0 +1,237 @@
+///////////////////////////////////////////////////////////////////////////////
+// wavefront.hh
+//
+// Tiled wavefront local_alignment: one long pairwise alignment spread over
+// the workers of a ThreadPool, for sequences too long for a database-level
+// parallel scan to help.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "alignment_context.hh"
+#include "project4.hh"
+#include "thread_pool.hh"
+
+// -------------------------------------------------------------------------
+// The D matrix of local_alignment cut into tiles of tile x tile cells. Tile
+// (bi, bj) only needs the row of D just above it and the column just to its
+// left, which tiles (bi - 1, bj) and (bi, bj - 1) produce, so all the tiles
+// of one anti-diagonal (bi + bj constant) are computed in parallel, one
+// anti-diagonal after the other.
+//
+// Every tile publishes its bottom row into _rows[bi + 1] and its right
+// column into _cols[bj + 1]; nothing else of D is kept. Those boundaries
+// double as checkpoints for the traceback, which recomputes, with back
+// pointers, only the tiles the alignment passes through. Memory is
+// O(nm / tile) instead of the O(nm) of local_alignment, and the alignment
+// and score are exactly those of local_alignment.
+// -------------------------------------------------------------------------
+class WavefrontAlignment {
+public:
+	enum { DEFAULT_TILE = 256 };
+
+	WavefrontAlignment(const std::string & string1,
+					   const std::string & string2,
+					   const BlosumPenaltyArray & bpa,
+					   int tile = DEFAULT_TILE)
+		: _string1(string1), _string2(string2), _penalties(bpa.penalty_table()),
+		  _codes1(string1.size()), _codes2(string2.size()), _tile(std::max(tile, 1)) {
+		encode_residues(string1.data(), string1.size(), _codes1.data());
+		encode_residues(string2.data(), string2.size(), _codes2.data());
+		_n = string1.size();
+		_m = string2.size();
+		_tile_rows = (_n + _tile - 1) / _tile;
+		_tile_cols = (_m + _tile - 1) / _tile;
+	}
+
+	int align(ThreadPool & pool, std::string & matchString1, std::string & matchString2) {
+		matchString1 = "";
+		matchString2 = "";
+		_rows.assign(static_cast<size_t>(_tile_rows + 1) * (_m + 1), 0);
+		_cols.assign(static_cast<size_t>(_tile_cols + 1) * (_n + 1), 0);
+
+		std::vector<Best> best(_tile_rows * _tile_cols);
+		for (int d = 0; d < _tile_rows + _tile_cols - 1; d++) {
+			int first = std::max(0, d - _tile_cols + 1);
+			int last = std::min(d, _tile_rows - 1);
+			std::atomic<int> next(first);
+			std::function<void(unsigned)> wave = [&](unsigned) {
+				for (int bi = next++; bi <= last; bi = next++) {
+					best[bi * _tile_cols + d - bi] = fill_tile(bi, d - bi, nullptr);
+				}
+			};
+			pool.run(wave);
+		}
+
+		// The first best cell in row order, as local_alignment picks it.
+		Best winner = { 0, 0, 0 };
+		for (const Best & b : best) {
+			if (b.score > winner.score ||
+				(b.score == winner.score && b.score > 0 &&
+				 (b.i < winner.i || (b.i == winner.i && b.j < winner.j)))) {
+				winner = b;
+			}
+		}
+		trace_back(winner, matchString1, matchString2);
+		return winner.score;
+	}
+
+private:
+	struct Best {
+		int		score;
+		int		i;
+		int		j;
+	};
+
+	int gap1(int i) const {
+		return _penalties[_codes1[i - 1]][RESIDUE_GAP];
+	}
+	int gap2(int j) const {
+		return _penalties[RESIDUE_GAP][_codes2[j - 1]];
+	}
+
+	int * boundary_row(int bi) {
+		return _rows.data() + static_cast<size_t>(bi) * (_m + 1);
+	}
+	int * boundary_col(int bj) {
+		return _cols.data() + static_cast<size_t>(bj) * (_n + 1);
+	}
+
+	// Fill tile (bi, bj) from the boundaries above and to the left of it,
+	// with the local_alignment recurrence and tie rules. Without back
+	// pointers the tile publishes its own boundaries; with them (B is
+	// tile x tile, row by row) it only records the pointers. Returns the
+	// first best cell of the tile in row order.
+	Best fill_tile(int bi, int bj, char * B) {
+		TRACE_SCOPE("dp fill tile");
+		int i0 = bi * _tile + 1, i1 = std::min(_n, i0 + _tile - 1);
+		int j0 = bj * _tile + 1, j1 = std::min(_m, j0 + _tile - 1);
+		int width = j1 - j0 + 1;
+		const int * above = boundary_row(bi);
+		const int * left_col = boundary_col(bj);
+		AlignmentContext::Frame frame(AlignmentContext::for_thread());
+		int * row = frame.allocate<int>(width + 1);
+		std::copy(above + j0 - 1, above + j1 + 1, row);
+
+		Best best = { 0, 0, 0 };
+		for (int i = i0; i <= i1; i++) {
+			const int8_t * scores = _penalties[_codes1[i - 1]];
+			int up_gap = gap1(i);
+			int diag = row[0];
+			row[0] = left_col[i];
+			for (int k = 1; k <= width; k++) {
+				int j = j0 + k - 1;
+				int up = row[k] + up_gap;
+				int left = row[k - 1] + gap2(j);
+				int d = diag + scores[_codes2[j - 1]];
+				int cell = std::max(std::max(up, left), std::max(d, 0));
+				diag = row[k];
+				row[k] = cell;
+				if (B != nullptr) {
+					char back;
+					if (left > up) {
+						back = (left > d) ? 'l' : 'd';
+					}
+					else {
+						back = (up > d) ? 'u' : 'd';
+					}
+					B[(i - i0) * _tile + k - 1] = (cell == 0) ? '?' : back;
+				}
+				if (cell > best.score) {
+					best.score = cell;
+					best.i = i;
+					best.j = j;
+				}
+			}
+			if (B == nullptr) {
+				boundary_col(bj + 1)[i] = row[width];
+			}
+		}
+		if (B == nullptr) {
+			std::copy(row + 1, row + width + 1, boundary_row(bi + 1) + j0);
+		}
+		return best;
+	}
+
+	// Follow the back pointers from the best cell, recomputing each tile
+	// the path enters from its saved boundaries.
+	void trace_back(const Best & best, std::string & matchString1, std::string & matchString2) {
+		TRACE_SCOPE("traceback");
+		AlignmentContext::Frame frame(AlignmentContext::for_thread());
+		char * B = frame.allocate<char>(static_cast<size_t>(_tile) * _tile);
+		int i = best.i;
+		int j = best.j;
+		while (i > 0 && j > 0) {
+			int bi = (i - 1) / _tile;
+			int bj = (j - 1) / _tile;
+			int i0 = bi * _tile + 1;
+			int j0 = bj * _tile + 1;
+			fill_tile(bi, bj, B);
+			char back = B[(i - i0) * _tile + j - j0];
+			while (back != '?') {
+				if (back == 'u') {
+					matchString1 += _string1[i - 1];
+					matchString2 += '*';
+					i--;
+				}
+				else if (back == 'l') {
+					matchString1 += '*';
+					matchString2 += _string2[j - 1];
+					j--;
+				}
+				else {
+					matchString1 += _string1[i - 1];
+					matchString2 += _string2[j - 1];
+					i--;
+					j--;
+				}
+				if (i < i0 || j < j0) {
+					break;
+				}
+				back = B[(i - i0) * _tile + j - j0];
+			}
+			if (back == '?') {
+				break;
+			}
+		}
+		std::reverse(matchString1.begin(), matchString1.end());
+		std::reverse(matchString2.begin(), matchString2.end());
+	}
+
+	const std::string &		_string1;
+	const std::string &		_string2;
+	const PenaltyTable &	_penalties;
+	std::vector<uint8_t>	_codes1;
+	std::vector<uint8_t>	_codes2;
+	int						_tile;
+	int						_n;
+	int						_m;
+	int						_tile_rows;
+	int						_tile_cols;
+	std::vector<int>		_rows;	// row bi * tile of D, for each tile row bi
+	std::vector<int>		_cols;	// column bj * tile of D, for each tile column bj
+};
+
+// -------------------------------------------------------------------------
+// local_alignment on the tiled wavefront: the same score and alignment,
+// computed tile x tile cells at a time by the workers of pool.
+// -------------------------------------------------------------------------
+int local_alignment_wavefront(const std::string & string1,
+							  const std::string & string2,
+							  const BlosumPenaltyArray & bpa,
+							  std::string & matchString1,
+							  std::string & matchString2,
+							  ThreadPool & pool,
+							  int tile = WavefrontAlignment::DEFAULT_TILE)
+{
+	return WavefrontAlignment(string1, string2, bpa, tile).align(pool, matchString1, matchString2);
+}
@@ -0,0 +1,121 @@
+///////////////////////////////////////////////////////////////////////////////
+// alignment_context.hh
+//
+// Scratch memory for dynamic programming tables, kept from one call to the
+// next so that scanning a database does not allocate a table per protein.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// A grow-only scratch arena. Tables are carved out of one flat block inside
+// a Frame and handed back when the frame ends; frames nest like the calls
+// that open them. A table that does not fit in the block gets a block of
+// its own for the time being, and when the outermost frame ends the main
+// block is regrown to the most that was ever in use at once. After the
+// first few calls of a scan, then, a call allocates nothing.
+//
+// The memory is uninitialized. A context is not thread safe: every thread
+// gets its own from for_thread().
+class AlignmentContext {
+public:
+	class Frame {
+	public:
+		explicit Frame(AlignmentContext & context) : _context(context), _mark(context.open()) { }
+		~Frame() {
+			_context.close(_mark);
+		}
+
+		Frame(const Frame &) = delete;
+		Frame & operator=(const Frame &) = delete;
+
+		// Room for count objects of a trivially copyable type T.
+		template <typename T>
+		T * allocate(size_t count) {
+			return static_cast<T *>(_context.allocate(count * sizeof(T)));
+		}
+
+	private:
+		AlignmentContext &	_context;
+		size_t				_mark;
+	};
+
+	AlignmentContext() : _capacity(0), _used(0), _peak(0), _depth(0), _allocations(0), _frames(0) { }
+
+	AlignmentContext(const AlignmentContext &) = delete;
+	AlignmentContext & operator=(const AlignmentContext &) = delete;
+
+	// The calling thread's context, created on first use.
+	static AlignmentContext & for_thread() {
+		static thread_local AlignmentContext context;
+		return context;
+	}
+
+	// Heap blocks allocated so far; stays put once the arena has warmed up.
+	size_t allocations() const {
+		return _allocations;
+	}
+
+	// Frames opened so far, nested ones included.
+	size_t frames() const {
+		return _frames;
+	}
+
+	// Size of the main block in bytes.
+	size_t capacity() const {
+		return _capacity;
+	}
+
+private:
+	static const size_t ALIGN = alignof(std::max_align_t);
+
+	size_t open() {
+		_depth++;
+		_frames++;
+		return _used;
+	}
+
+	void close(size_t mark) {
+		_used = mark;
+		if (--_depth == 0) {
+			_overflow.clear();
+			if (_peak > _capacity) {
+				_block.reset(new char[_peak]);
+				_capacity = _peak;
+				_allocations++;
+			}
+		}
+	}
+
+	void * allocate(size_t bytes) {
+		bytes = (bytes + ALIGN - 1) / ALIGN * ALIGN;
+		size_t end = _used + bytes;
+		_peak = std::max(_peak, end);
+		char * memory;
+		if (end <= _capacity) {
+			memory = _block.get() + _used;
+		}
+		else {
+			_overflow.emplace_back(new char[std::max<size_t>(bytes, 1)]);
+			memory = _overflow.back().get();
+			_allocations++;
+		}
+		_used = end;
+		return memory;
+	}
+
+	std::unique_ptr<char[]>					_block;
+	std::vector<std::unique_ptr<char[]>>	_overflow;	// until the outermost frame ends
+	size_t									_capacity;
+	size_t									_used;
+	size_t									_peak;
+	size_t									_depth;
+	size_t									_allocations;
+	size_t									_frames;
+};
@@ -0,0 +1,264 @@
+///////////////////////////////////////////////////////////////////////////////
+// bench.hh
+//
+// Benchmark harness for the experiments. A single Timer reading is at the
+// mercy of cold caches, frequency scaling and whatever else the machine is
+// doing; this runs the code under test many times and reports statistics
+// over the samples instead.
+//
+// How to use:
+//
+//    BenchmarkResult result = benchmark("character_mode", [&]() {
+//      do_not_optimize(character_mode(words));
+//    });
+//    cout << result << endl;
+//
+// The body is first run on its own to calibrate: calls are batched until
+// one batch takes at least sample_time, so that short bodies are not
+// lost in the clock's resolution. A few batches are then run and thrown
+// away as warm-up, and the rest are the samples. Every figure reported is
+// seconds per call.
+//
+// Where perf_counters.hh can open the hardware counters, the samples are
+// also counted, and the result reports instructions per cycle and cache
+// and branch misses per unit of work. The unit is a call unless the
+// options say how much work one call does, such as the number of DP cells
+// it fills:
+//
+//    options.work_per_call = query.size() * total_residues;
+//    options.work_unit = "cell";
+//
+// The samples' allocations are counted too (see memory_usage.hh): the
+// result reports allocations and bytes allocated per call, the most bytes
+// any sample held at once, and the process's peak resident set size.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "memory_usage.hh"
+#include "perf_counters.hh"
+#include "timer.hh"
+
+// Make the compiler believe value is used, so that the computation of a
+// result nobody reads is not optimized away.
+template <typename T>
+inline void do_not_optimize(const T & value) {
+  asm volatile("" : : "m"(value) : "memory");
+}
+
+// Make the compiler believe all memory may have been read and written.
+inline void clobber_memory() {
+  asm volatile("" : : : "memory");
+}
+
+struct BenchmarkOptions {
+  BenchmarkOptions()
+    : sample_time(0.01), warmup(2), samples(15), min_samples(5), time_budget(2.0),
+      counters(true), work_per_call(1), work_unit("call") { }
+
+  double sample_time;   // shortest batch, in seconds, used as one sample
+  int warmup;           // batches run and discarded before sampling
+  int samples;          // most samples taken
+  int min_samples;      // when fewer fit in the budget, skip the warm-up
+  double time_budget;   // seconds to spend on warm-up and samples; a body
+                        // whose first call takes longer is timed just once
+  bool counters;        // read the hardware counters when they are available
+  double work_per_call; // units of work done by one call, for miss rates
+  std::string work_unit;
+};
+
+struct BenchmarkResult {
+  std::string name;
+  size_t iterations;    // calls per sample
+  size_t samples;
+  double min;
+  double median;
+  double mad;           // median absolute deviation from the median
+  double ci_low;        // 95% confidence interval for the median
+  double ci_high;
+  CounterValues counters; // per unit of work over all samples
+  std::string work_unit;
+  bool allocations_available;
+  double allocations;   // operator new calls per call
+  double allocated_bytes; // bytes allocated per call
+  uint64_t peak_bytes;  // most bytes live at once during any sample
+  uint64_t peak_rss;    // process peak resident set size once sampling ended
+};
+
+// -------------------------------------------------------------------------
+// Median of values, which is sorted in place.
+// -------------------------------------------------------------------------
+inline double benchmark_median(std::vector<double> & values) {
+  std::sort(values.begin(), values.end());
+  size_t n = values.size();
+  return (n % 2 == 1) ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+// -------------------------------------------------------------------------
+// Statistics over per-call sample times. The confidence interval for the
+// median is distribution free: the order statistics at ranks
+// n/2 -+ 1.96 sqrt(n)/2, which holds whatever shape the timing noise has.
+// -------------------------------------------------------------------------
+inline BenchmarkResult benchmark_statistics(const std::string & name,
+                                            size_t iterations,
+                                            std::vector<double> samples) {
+  BenchmarkResult result;
+  result.name = name;
+  result.iterations = iterations;
+  result.samples = samples.size();
+  result.median = benchmark_median(samples);
+  result.min = samples.front();
+  size_t n = samples.size();
+  double half_width = 1.96 * std::sqrt(static_cast<double>(n)) / 2;
+  long low = static_cast<long>(std::floor(n / 2.0 - half_width));
+  long high = static_cast<long>(std::ceil(n / 2.0 + half_width));
+  result.ci_low = samples[std::max(0L, low)];
+  result.ci_high = samples[std::min(static_cast<long>(n) - 1, high)];
+  std::vector<double> deviations(n);
+  for (size_t i = 0; i < n; i++) {
+    deviations[i] = std::fabs(samples[i] - result.median);
+  }
+  result.mad = benchmark_median(deviations);
+  return result;
+}
+
+// -------------------------------------------------------------------------
+// Time body, a callable taking no arguments, as described at the top of
+// this file.
+// -------------------------------------------------------------------------
+template <typename Body>
+BenchmarkResult benchmark(const std::string & name,
+                          Body body,
+                          const BenchmarkOptions & options = BenchmarkOptions()) {
+  auto run = [&body](size_t iterations) {
+    Timer timer;
+    for (size_t i = 0; i < iterations; i++) {
+      body();
+      clobber_memory();
+    }
+    return timer.elapsed();
+  };
+  PerfCounters counters(options.counters);
+  auto finish = [&options](BenchmarkResult result, const CounterValues & values,
+                           const AllocationStats & memory, size_t calls) {
+    result.counters = values.per(calls * options.work_per_call);
+    result.work_unit = options.work_unit;
+    result.allocations_available = memory.available;
+    result.allocations = static_cast<double>(memory.allocations) / calls;
+    result.allocated_bytes = static_cast<double>(memory.bytes) / calls;
+    result.peak_bytes = memory.peak_bytes;
+    result.peak_rss = peak_rss_bytes();
+    return result;
+  };
+
+  // Calibrate: double the batch until it fills sample_time.
+  size_t iterations = 1;
+  double elapsed;
+  CounterValues values;
+  AllocationStats memory;
+  {
+    AllocationScope allocation_scope(memory);
+    CounterScope scope(counters, values);
+    elapsed = run(iterations);
+  }
+  if (elapsed >= options.time_budget) {
+    return finish(benchmark_statistics(name, 1, std::vector<double>(1, elapsed)), values, memory, 1);
+  }
+  while (elapsed < options.sample_time) {
+    iterations *= 2;
+    elapsed = run(iterations);
+  }
+
+  // Fit the warm-up and samples into the budget. A slow body goes without
+  // warm-up, the calibration runs having warmed it already.
+  int affordable = static_cast<int>(options.time_budget / elapsed);
+  int warmup = options.warmup;
+  if (affordable < options.min_samples + warmup) {
+    warmup = 0;
+  }
+  int wanted = std::max(1, std::min(options.samples, affordable - warmup));
+  for (int w = 0; w < warmup; w++) {
+    run(iterations);
+  }
+  std::vector<double> samples;
+  CounterValues totals;
+  AllocationStats memory_totals;
+  for (int s = 0; s < wanted; s++) {
+    CounterValues sample;
+    AllocationStats sample_memory;
+    double seconds;
+    {
+      AllocationScope allocation_scope(sample_memory);
+      CounterScope scope(counters, sample);
+      seconds = run(iterations);
+    }
+    samples.push_back(seconds / iterations);
+    totals.available = sample.available;
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+      totals.counts[c] += sample.counts[c];
+    }
+    memory_totals.available = sample_memory.available;
+    memory_totals.allocations += sample_memory.allocations;
+    memory_totals.bytes += sample_memory.bytes;
+    memory_totals.peak_bytes = std::max(memory_totals.peak_bytes, sample_memory.peak_bytes);
+  }
+  return finish(benchmark_statistics(name, iterations, samples), totals, memory_totals,
+                iterations * wanted);
+}
+
+// A duration in seconds, printed with a unit that suits it.
+inline std::string format_duration(double seconds) {
+  std::ostringstream out;
+  out << std::setprecision(3);
+  if (seconds < 1e-6) {
+    out << seconds * 1e9 << " ns";
+  }
+  else if (seconds < 1e-3) {
+    out << seconds * 1e6 << " us";
+  }
+  else if (seconds < 1) {
+    out << seconds * 1e3 << " ms";
+  }
+  else {
+    out << seconds << " s";
+  }
+  return out.str();
+}
+
+inline std::ostream & operator<<(std::ostream & out, const BenchmarkResult & result) {
+  out << result.name << ": median " << format_duration(result.median)
+      << " [95% CI " << format_duration(result.ci_low) << " .. " << format_duration(result.ci_high)
+      << "], min " << format_duration(result.min)
+      << ", MAD " << format_duration(result.mad)
+      << " (" << result.samples << " x " << result.iterations << ")";
+  const CounterValues & counters = result.counters;
+  if (counters.has(PERF_CYCLES) && counters.has(PERF_INSTRUCTIONS)) {
+    out << ", IPC " << std::setprecision(3) << counters.ipc();
+  }
+  PerfCounter misses[] = { PERF_CACHE_MISSES, PERF_BRANCH_MISSES };
+  for (PerfCounter counter : misses) {
+    if (counters.has(counter)) {
+      out << ", " << perf_counter_name(counter) << " " << std::setprecision(3)
+          << counters.counts[counter] << "/" << result.work_unit;
+    }
+  }
+  if (result.allocations_available) {
+    out << ", " << std::setprecision(3) << result.allocations << " allocs/call, "
+        << format_bytes(result.allocated_bytes) << "/call, peak "
+        << format_bytes(static_cast<double>(result.peak_bytes));
+  }
+  if (result.peak_rss > 0) {
+    out << ", max RSS " << format_bytes(static_cast<double>(result.peak_rss));
+  }
+  return out;
+}
@@ -0,0 +1,70 @@
+///////////////////////////////////////////////////////////////////////////////
+// datagen.cc
+//
+// Writes a synthetic dataset from datagen.hh to a file:
+//
+//    ./datagen words 100x words_100x.txt
+//    ./datagen proteins 50000 proteins_50000.txt 7
+//
+// The count is a number of records, or a multiple of the bundled dataset
+// when it ends in 'x'. The optional last argument is the seed (default 1).
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <fstream>
+#include <iostream>
+
+#include "datagen.hh"
+#include "timer.hh"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+  if (argc < 4 || argc > 5) {
+    cerr << "usage: " << argv[0] << " words|foods|proteins|peptides COUNT[x] PATH [SEED]" << endl;
+    return 1;
+  }
+  string kind = argv[1], path = argv[3];
+  uint64_t seed = (argc > 4) ? strtoull(argv[4], nullptr, 10) : 1;
+
+  size_t bundled;
+  if (kind == "words") {
+    bundled = WORDS_BUNDLED;
+  } else if (kind == "foods") {
+    bundled = FOODS_BUNDLED;
+  } else if (kind == "proteins") {
+    bundled = PROTEINS_BUNDLED;
+  } else if (kind == "peptides") {
+    bundled = PEPTIDES_BUNDLED;
+  } else {
+    cerr << "error: unknown dataset \"" << kind << "\"" << endl;
+    return 1;
+  }
+  size_t count;
+  if (!parse_dataset_count(argv[2], bundled, count)) {
+    cerr << "error: bad count \"" << argv[2] << "\"" << endl;
+    return 1;
+  }
+
+  ofstream out(path, ios::binary);
+  if (!out) {
+    cerr << "error: cannot open \"" << path << "\"" << endl;
+    return 1;
+  }
+  Timer timer;
+  if (kind == "words") {
+    write_words(out, count, seed);
+  } else if (kind == "foods") {
+    write_foods(out, count, seed);
+  } else {
+    write_fasta(out, count, seed, (kind == "peptides") ? 10 : 0);
+  }
+  out.close();
+  if (!out) {
+    cerr << "error: cannot write \"" << path << "\"" << endl;
+    return 1;
+  }
+  cout << "wrote " << count << " " << kind << " to " << path
+       << " in " << timer.elapsed() << " s" << endl;
+  return 0;
+}
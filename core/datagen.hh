@@ -0,0 +1,284 @@
+///////////////////////////////////////////////////////////////////////////////
+// datagen.hh
+//
+// Deterministic synthetic datasets shaped like the bundled inputs, for
+// benchmarking at sizes the bundled files cannot reach:
+//
+//    words     like words.txt: one word per line, English letter
+//              frequencies, possessives, capitals, and the odd mirror.
+//    foods     like ABBREV.txt: 53 '^'-separated fields per line, with
+//              water, protein, fat, carbohydrate and ash making 100 g.
+//    proteins  like proteins_large.txt: FASTA with log-normal lengths
+//              around 360 residues, drawn from the BLOSUM62 background
+//              residue frequencies.
+//    peptides  like proteins.txt: FASTA with 10-residue sequences.
+//
+// Every generator writes record by record to a stream, so the size of a
+// dataset is bounded by the disk, not by memory. The same kind, count and
+// seed always give the same bytes: DatasetRng draws only from the raw
+// output of std::mt19937_64, which the standard fixes exactly, and never
+// from the std:: distributions, whose results vary between libraries.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Record counts of the bundled datasets, for sizes given as multiples.
+enum {
+  WORDS_BUNDLED = 99171,    // words.txt
+  FOODS_BUNDLED = 8790,     // ABBREV.txt
+  PROTEINS_BUNDLED = 6639,  // proteins_large.txt
+  PEPTIDES_BUNDLED = 2000   // proteins.txt
+};
+
+// -------------------------------------------------------------------------
+// Portable random draws over std::mt19937_64.
+// -------------------------------------------------------------------------
+class DatasetRng {
+public:
+  explicit DatasetRng(uint64_t seed) : _engine(seed) { }
+
+  // Uniform in [0, 1), from the top 53 bits of one draw.
+  double uniform() {
+    return (_engine() >> 11) * (1.0 / 9007199254740992.0);
+  }
+
+  // Uniform integer in [0, n).
+  size_t below(size_t n) {
+    return static_cast<size_t>(uniform() * n);
+  }
+
+  bool chance(double probability) {
+    return uniform() < probability;
+  }
+
+  // Standard normal, by the Box-Muller transform.
+  double normal() {
+    double u1 = 1.0 - uniform(), u2 = uniform();
+    return std::sqrt(-2.0 * std::log(u1)) * std::cos(6.283185307179586 * u2);
+  }
+
+private:
+  std::mt19937_64 _engine;
+};
+
+// -------------------------------------------------------------------------
+// A table for repeated weighted draws: a cumulative distribution searched
+// by bisection.
+// -------------------------------------------------------------------------
+class DiscreteTable {
+public:
+  explicit DiscreteTable(const std::vector<double> & weights) : _cumulative(weights) {
+    for (size_t i = 1; i < _cumulative.size(); i++) {
+      _cumulative[i] += _cumulative[i - 1];
+    }
+  }
+
+  size_t draw(DatasetRng & rng) const {
+    double target = rng.uniform() * _cumulative.back();
+    size_t low = 0, high = _cumulative.size() - 1;
+    while (low < high) {
+      size_t middle = (low + high) / 2;
+      if (target < _cumulative[middle]) {
+        high = middle;
+      } else {
+        low = middle + 1;
+      }
+    }
+    return low;
+  }
+
+private:
+  std::vector<double> _cumulative;
+};
+
+// -------------------------------------------------------------------------
+// Parses a record count: either a plain number, or a multiple of the
+// bundled dataset such as "100x". Returns false on anything else.
+// -------------------------------------------------------------------------
+inline bool parse_dataset_count(const std::string & text, size_t bundled, size_t & count) {
+  if (text.empty() || !std::isdigit(static_cast<unsigned char>(text[0]))) {
+    return false;
+  }
+  char * end = nullptr;
+  unsigned long long value = std::strtoull(text.c_str(), &end, 10);
+  std::string rest(end);
+  if (rest == "x" || rest == "X") {
+    count = static_cast<size_t>(value) * bundled;
+    return true;
+  }
+  count = static_cast<size_t>(value);
+  return rest.empty();
+}
+
+// -------------------------------------------------------------------------
+// words: the letter and length frequencies of words.txt. A root word is
+// followed by its possessive about a third of the time, and a few words
+// are mirrors or prefixes of recent ones, so longest_mirrored_string and
+// longest_substring_trio have answers to find.
+// -------------------------------------------------------------------------
+inline void write_words(std::ostream & out, size_t count, uint64_t seed) {
+  static const DiscreteTable letters({
+    63151, 14279, 30453, 27797, 88237, 10220, 21992, 18568, 66643, 1455,
+    7827, 40271, 20948, 56626, 48585, 21354, 1459, 56645, 88663, 52187,
+    25988, 7666, 7077, 2085, 12513, 3141
+  });
+  // Root lengths 1 to 23.
+  static const DiscreteTable lengths({
+    52, 182, 845, 3346, 6788, 11278, 14787, 15674, 14262, 11546, 8415,
+    5508, 3236, 1679, 893, 382, 176, 72, 31, 10, 3, 5, 1
+  });
+  const size_t RECENT = 64;
+
+  DatasetRng rng(seed);
+  std::vector<std::string> recent;
+  size_t written = 0;
+  while (written < count) {
+    std::string word;
+    if (recent.size() == RECENT && rng.chance(0.002)) {
+      const std::string & other = recent[rng.below(RECENT)];
+      word.assign(other.rbegin(), other.rend());
+    } else if (recent.size() == RECENT && rng.chance(0.03)) {
+      const std::string & other = recent[rng.below(RECENT)];
+      word = other.substr(0, 1 + rng.below(other.size()));
+    } else {
+      word.resize(lengths.draw(rng) + 1);
+      for (char & letter : word) {
+        letter = 'a' + letters.draw(rng);
+      }
+      if (rng.chance(0.17)) {
+        word[0] = std::toupper(word[0]);
+      }
+    }
+    out << word << '\n';
+    written++;
+    if (written < count && rng.chance(0.36)) {
+      out << word << "'s\n";
+      written++;
+    }
+    if (recent.size() < RECENT) {
+      recent.push_back(word);
+    } else {
+      recent[rng.below(RECENT)] = word;
+    }
+  }
+}
+
+// -------------------------------------------------------------------------
+// foods: ABBREV.txt lines. Water takes most of the 100 g; the rest splits
+// into protein, fat, carbohydrate and ash, which fixes the calories. Only
+// the fields load_usda_abbrev reads, and the proximates behind them, are
+// filled in; the other nutrients are zero.
+// -------------------------------------------------------------------------
+inline void write_foods(std::ostream & out, size_t count, uint64_t seed) {
+  static const char * const BASES[] = {
+    "BEEF", "CHICKEN", "PORK", "TURKEY", "FISH,SALMON", "FISH,TUNA",
+    "CHEESE,CHEDDAR", "MILK", "YOGURT", "EGG", "BEANS,KIDNEY", "LENTILS",
+    "RICE,BROWN", "BREAD,WHEAT", "PASTA", "OATS", "POTATOES", "BROCCOLI",
+    "SPINACH", "CARROTS", "APPLES", "BANANAS", "ALMONDS", "PEANUT BUTTER",
+    "TOFU", "BUTTER", "OLIVE OIL", "CEREAL", "SOUP", "CRACKERS"
+  };
+  static const char * const STYLES[] = {
+    "RAW", "COOKED", "ROASTED", "BOILED", "FRIED", "CANNED", "FROZEN",
+    "DRY", "WITH SALT", "WO/ SALT", "LOWFAT", "WHOLE", "ENRICHED"
+  };
+  static const char * const AMOUNTS[] = {
+    "1 cup", "1 tbsp", "1 oz", "1 serving", "1 piece", "3 oz", "1 slice"
+  };
+  static const int AMOUNT_G[] = { 240, 14, 28, 100, 50, 85, 30 };
+  const size_t base_count = sizeof(BASES) / sizeof(BASES[0]);
+  const size_t style_count = sizeof(STYLES) / sizeof(STYLES[0]);
+  const size_t amount_count = sizeof(AMOUNTS) / sizeof(AMOUNTS[0]);
+
+  DatasetRng rng(seed);
+  char number[32];
+  for (size_t i = 0; i < count; i++) {
+    double water = 95 * std::pow(rng.uniform(), 0.7);
+    double parts[4];  // protein, fat, carbohydrate, ash
+    double total = 0;
+    for (double & part : parts) {
+      part = -std::log(1.0 - rng.uniform());
+      total += part;
+    }
+    for (double & part : parts) {
+      part *= (100 - water) / total;
+    }
+    double kcal = 4 * parts[0] + 9 * parts[1] + 4 * parts[2];
+    size_t amount = rng.below(amount_count);
+
+    std::vector<std::string> fields(53, "0");
+    std::snprintf(number, sizeof(number), "~%05zu~", i + 1);
+    fields[0] = number;
+    fields[1] = std::string("~") + BASES[rng.below(base_count)] + "," + STYLES[rng.below(style_count)]
+                + (rng.chance(0.5) ? std::string(",") + STYLES[rng.below(style_count)] : "") + "~";
+    auto fixed = [&](double value) {
+      std::snprintf(number, sizeof(number), "%.2f", value);
+      return std::string(number);
+    };
+    fields[2] = fixed(water);
+    fields[3] = std::to_string(std::lround(kcal));
+    fields[4] = fixed(parts[0]);
+    fields[5] = fixed(parts[1]);
+    fields[6] = fixed(parts[3]);
+    fields[7] = fixed(parts[2]);
+    fields[48] = std::to_string(AMOUNT_G[amount]);
+    fields[49] = std::string("~") + AMOUNTS[amount] + "~";
+    fields[50] = "";
+    fields[51] = "";
+    for (size_t f = 0; f < fields.size(); f++) {
+      out << (f ? "^" : "") << fields[f];
+    }
+    out << '\n';
+  }
+}
+
+// -------------------------------------------------------------------------
+// proteins and peptides: FASTA records wrapped at 60 residues. Residues
+// follow the BLOSUM62 background frequencies, in the row order of
+// blosum62.txt (ARNDCQEGHILKMFPSTWYV). Protein lengths are log-normal with
+// the median and spread of proteins_large.txt; a peptide_length above
+// zero gives every record that length instead.
+// -------------------------------------------------------------------------
+inline void write_fasta(std::ostream & out, size_t count, uint64_t seed, size_t peptide_length = 0) {
+  static const char RESIDUES[] = "ARNDCQEGHILKMFPSTWYV";
+  static const DiscreteTable background({
+    0.074, 0.052, 0.045, 0.054, 0.025, 0.034, 0.054, 0.074, 0.026, 0.068,
+    0.099, 0.058, 0.025, 0.047, 0.039, 0.057, 0.051, 0.013, 0.032, 0.073
+  });
+  const double MEDIAN_LENGTH = 364, LOG_SPREAD = 0.67;
+  const size_t MIN_LENGTH = 20, MAX_LENGTH = 5000, LINE = 60;
+
+  DatasetRng rng(seed);
+  char header[128];
+  std::string line;
+  for (size_t i = 0; i < count; i++) {
+    size_t length = peptide_length;
+    if (length == 0) {
+      double drawn = MEDIAN_LENGTH * std::exp(LOG_SPREAD * rng.normal());
+      length = std::min(MAX_LENGTH, std::max(MIN_LENGTH, static_cast<size_t>(drawn)));
+    }
+    std::snprintf(header, sizeof(header),
+                  ">sp|S%07zu|SYN%zu_SYNTH Synthetic protein %zu OS=Synthetic organism\n",
+                  i + 1, i + 1, i + 1);
+    out << header;
+    for (size_t done = 0; done < length; done += LINE) {
+      line.resize(std::min(LINE, length - done));
+      for (char & residue : line) {
+        residue = RESIDUES[background.draw(rng)];
+      }
+      out << line << '\n';
+    }
+  }
+}
@@ -0,0 +1,279 @@
+///////////////////////////////////////////////////////////////////////////////
+// fasta.hh
+//
+// Streaming FASTA reader that packs every residue of a protein database
+// into one contiguous arena.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "residues.hh"
+#include "trace.hh"
+
+// All the sequences of a FASTA file stored back to back in one buffer.
+// Sequence i occupies residues [offsets[i], offsets[i + 1]) of the arena.
+// Header lines are kept as raw bytes and are only turned into
+// std::string objects when a description is actually asked for.
+// After pack() the residues are held as 5-bit codes, instead of the chars
+// or next to them.
+class SequenceArena {
+public:
+	SequenceArena() {
+		clear();
+	}
+
+	// Number of sequences in the arena.
+	size_t size() const {
+		return _offsets.size() - 1;
+	}
+
+	bool empty() const {
+		return size() == 0;
+	}
+
+	// Total number of residues over all sequences.
+	size_t residue_count() const {
+		return _offsets.back();
+	}
+
+	// Raw residue characters; only available while has_characters().
+	const char * sequence_data(size_t i) const {
+		assert(has_characters());
+		return _residues.data() + _offsets[i];
+	}
+
+	size_t sequence_length(size_t i) const {
+		return _offsets[i + 1] - _offsets[i];
+	}
+
+	// Position of sequence i's first residue among all the residues.
+	size_t offset(size_t i) const {
+		return _offsets[i];
+	}
+
+	// Sequence i as loaded; once only the packed codes are left, in upper
+	// case with '?' for any character that is not a residue.
+	std::string sequence(size_t i) const {
+		if (has_characters()) {
+			return std::string(sequence_data(i), sequence_length(i));
+		}
+		std::vector<uint8_t> codes(sequence_length(i));
+		unpack_codes(i, codes.data());
+		std::string result(codes.size(), ' ');
+		for (size_t k = 0; k < codes.size(); k++) {
+			result[k] = residue_letter(codes[k]);
+		}
+		return result;
+	}
+
+	// Residue codes of sequence i, one byte per residue.
+	void unpack_codes(size_t i, uint8_t * codes) const {
+		if (is_packed()) {
+			_packed.unpack(_offsets[i], sequence_length(i), codes);
+		} else {
+			encode_residues(sequence_data(i), sequence_length(i), codes);
+		}
+	}
+
+	bool is_packed() const {
+		return _is_packed;
+	}
+
+	bool has_characters() const {
+		return !_is_packed || _kept_characters;
+	}
+
+	// Encode the arena into packed 5-bit codes, which unpack_codes() then
+	// reads. The encoding folds case and maps non-residue characters to one
+	// code, see residues.hh, so it is lossy: keep_characters keeps the
+	// characters next to the codes, for callers that need the sequences
+	// exactly as loaded; otherwise the codes replace them.
+	void pack(bool keep_characters = false) {
+		if (is_packed()) {
+			return;
+		}
+		_packed.append(_residues.data(), _residues.size());
+		_packed.shrink_to_fit();
+		if (!keep_characters) {
+			std::vector<char>().swap(_residues);
+		}
+		_is_packed = true;
+		_kept_characters = keep_characters;
+	}
+
+	// Bytes used to hold residues, in whichever forms they are stored.
+	size_t residue_bytes() const {
+		return (is_packed() ? _packed.storage_bytes() : 0) + _residues.capacity();
+	}
+
+	// Header line of sequence i, without the leading '>'.
+	std::string description(size_t i) const {
+		return std::string(_headers.data() + _header_offsets[i],
+						   _header_offsets[i + 1] - _header_offsets[i]);
+	}
+
+	void clear() {
+		_residues.clear();
+		_headers.clear();
+		_offsets.assign(1, 0);
+		_header_offsets.assign(1, 0);
+		_open_header = _open_residues = 0;
+		_packed.clear();
+		_is_packed = false;
+		_kept_characters = false;
+	}
+
+	// Start a new record. Residues appended after this call belong to it
+	// until end_record() is called.
+	void begin_record() {
+		_open_header = _headers.size();
+		_open_residues = _residues.size();
+	}
+
+	void append_header(const char * text, size_t length) {
+		_headers.insert(_headers.end(), text, text + length);
+	}
+
+	// Called at the end of the header line; drops a DOS line ending that
+	// may have arrived in an earlier block than the '\n'.
+	void finish_header() {
+		if (_headers.size() > _open_header && _headers.back() == '\r') {
+			_headers.pop_back();
+		}
+	}
+
+	void append_residues(const char * residues, size_t length) {
+		assert(!is_packed());
+		_residues.insert(_residues.end(), residues, residues + length);
+	}
+
+	// Close the current record. Records without any residues are dropped,
+	// the same as the original single-line loader did.
+	void end_record() {
+		if (_residues.size() == _open_residues) {
+			_headers.resize(_open_header);
+			return;
+		}
+		_offsets.push_back(_residues.size());
+		_header_offsets.push_back(_headers.size());
+	}
+
+	// Add a whole record at once. Unlike end_record(), a record without
+	// residues is kept, so that the i-th record added is always sequence i.
+	void add(const std::string & description, const std::string & sequence) {
+		assert(!is_packed());
+		_headers.insert(_headers.end(), description.begin(), description.end());
+		_residues.insert(_residues.end(), sequence.begin(), sequence.end());
+		_offsets.push_back(_residues.size());
+		_header_offsets.push_back(_headers.size());
+	}
+
+	// Give back the slack left over from geometric growth while loading.
+	void shrink_to_fit() {
+		_residues.shrink_to_fit();
+		_headers.shrink_to_fit();
+		_offsets.shrink_to_fit();
+		_header_offsets.shrink_to_fit();
+	}
+
+private:
+	std::vector<char>	_residues;
+	std::vector<size_t>	_offsets;
+	std::vector<char>	_headers;
+	std::vector<size_t>	_header_offsets;
+	size_t				_open_header;
+	size_t				_open_residues;
+	PackedResidues		_packed;
+	bool				_is_packed;
+	bool				_kept_characters;
+};
+
+// -------------------------------------------------------------------------
+// Load all the proteins from a FASTA file into an arena. Sequences may span
+// any number of lines; blank lines, ';' comment lines, whitespace and '\r'
+// are ignored. The file is read in large blocks rather than line by line,
+// so a partial line at the end of a block is simply carried over into the
+// next one.
+// Returns false on I/O error.
+// -------------------------------------------------------------------------
+bool load_proteins(SequenceArena & arena, const std::string& path)
+{
+	TRACE_SCOPE("load_proteins");
+	arena.clear();
+	std::FILE * file = std::fopen(path.c_str(), "rb");
+	if (file == nullptr) {
+		return false;
+	}
+
+	enum { LINE_START, HEADER, SEQUENCE, SKIP } state = LINE_START;
+	bool in_record = false;
+	std::vector<char> buffer(1 << 20);
+	size_t got;
+	while ((got = std::fread(buffer.data(), 1, buffer.size(), file)) > 0) {
+		const char * p = buffer.data();
+		const char * end = p + got;
+		while (p < end) {
+			if (state == LINE_START) {
+				if (*p == '>') {
+					if (in_record) {
+						arena.end_record();
+					}
+					arena.begin_record();
+					in_record = true;
+					state = HEADER;
+					p++;
+				} else if (*p == ';' || !in_record) {
+					state = SKIP;
+				} else {
+					state = SEQUENCE;
+				}
+				continue;
+			}
+
+			const char * eol = static_cast<const char *>(std::memchr(p, '\n', end - p));
+			const char * stop = (eol != nullptr) ? eol : end;
+			if (state == HEADER) {
+				arena.append_header(p, stop - p);
+				if (eol != nullptr) {
+					arena.finish_header();
+				}
+			} else if (state == SEQUENCE) {
+				// Residue runs are copied in bulk; only whitespace splits them.
+				const char * run = p;
+				for (const char * q = p; q < stop; q++) {
+					if (*q == ' ' || *q == '\t' || *q == '\r') {
+						arena.append_residues(run, q - run);
+						run = q + 1;
+					}
+				}
+				arena.append_residues(run, stop - run);
+			}
+			if (eol == nullptr) {
+				break;
+			}
+			state = LINE_START;
+			p = eol + 1;
+		}
+	}
+
+	bool ok = !std::ferror(file);
+	std::fclose(file);
+	if (state == HEADER) {
+		arena.finish_header();
+	}
+	if (in_record) {
+		arena.end_record();
+	}
+	arena.shrink_to_fit();
+	return ok;
+}
@@ -0,0 +1,194 @@
+///////////////////////////////////////////////////////////////////////////////
+// fuzz.hh
+//
+// Differential fuzzing: run a fast algorithm and a slow reference on the
+// same random inputs, and report the smallest input on which they differ.
+//
+// How to use:
+//
+//    Fuzzer fuzzer(argc, argv);
+//    fuzzer.check<string_vector>("longest_mirrored_string",
+//      [](FuzzRng & rng) { return rng.words(8, "abc", 0, 4); },
+//      [](const string_vector & words) -> std::string {
+//        return (fast(words) == slow(words)) ? "" : "results differ";
+//      },
+//      shrink_strings,
+//      describe_strings);
+//    return fuzzer.finish();
+//
+// A property returns an empty string when the input passes, or what went
+// wrong. Inputs come from a generator seeded from the run's seed and the
+// case number, so any failure can be replayed from the two numbers
+// printed with it. The first failing input is then shrunk: each candidate
+// the shrinker proposes that still fails replaces it, until none does.
+//
+// The program takes optional arguments [cases [seed]]; the defaults make
+// `make fuzz` a quick, repeatable run.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// -------------------------------------------------------------------------
+// The random source handed to generators.
+// -------------------------------------------------------------------------
+class FuzzRng {
+public:
+  explicit FuzzRng(uint64_t seed) : _engine(seed) { }
+
+  // A uniform integer in [low, high].
+  int range(int low, int high) {
+    return std::uniform_int_distribution<int>(low, high)(_engine);
+  }
+
+  bool chance(double probability) {
+    return std::bernoulli_distribution(probability)(_engine);
+  }
+
+  // A string of length in [min_length, max_length] over alphabet.
+  std::string string(const std::string & alphabet, int min_length, int max_length) {
+    std::string result(range(min_length, max_length), ' ');
+    for (char & letter : result) {
+      letter = alphabet[range(0, alphabet.size() - 1)];
+    }
+    return result;
+  }
+
+  // Up to count strings as above. Small alphabets and lengths make
+  // repeats, mirrors and substrings common, which is where the
+  // interesting cases are.
+  std::vector<std::string> words(int count, const std::string & alphabet,
+                                 int min_length, int max_length) {
+    std::vector<std::string> result(range(0, count));
+    for (std::string & word : result) {
+      word = string(alphabet, min_length, max_length);
+    }
+    return result;
+  }
+
+private:
+  std::mt19937_64 _engine;
+};
+
+// -------------------------------------------------------------------------
+// Shrink candidates for a vector of strings: without each element in turn,
+// then with one letter removed from each string.
+// -------------------------------------------------------------------------
+inline std::vector<std::vector<std::string>> shrink_strings(const std::vector<std::string> & input) {
+  std::vector<std::vector<std::string>> candidates;
+  for (size_t i = 0; i < input.size(); i++) {
+    std::vector<std::string> smaller(input);
+    smaller.erase(smaller.begin() + i);
+    candidates.push_back(smaller);
+  }
+  for (size_t i = 0; i < input.size(); i++) {
+    for (size_t k = 0; k < input[i].size(); k++) {
+      std::vector<std::string> smaller(input);
+      smaller[i].erase(k, 1);
+      candidates.push_back(smaller);
+    }
+  }
+  return candidates;
+}
+
+inline std::string describe_strings(const std::vector<std::string> & input) {
+  std::ostringstream out;
+  out << "{";
+  for (size_t i = 0; i < input.size(); i++) {
+    out << (i ? ", " : " ") << "\"" << input[i] << "\"";
+  }
+  out << " }";
+  return out.str();
+}
+
+// -------------------------------------------------------------------------
+// Repeatedly replace input with the first smaller candidate that still
+// fails, until no candidate does. Returns the property's message for the
+// final input.
+// -------------------------------------------------------------------------
+template <typename T>
+std::string fuzz_shrink(T & input,
+                        const std::function<std::string(const T &)> & property,
+                        const std::function<std::vector<T>(const T &)> & smaller) {
+  std::string message = property(input);
+  bool shrunk = true;
+  while (shrunk) {
+    shrunk = false;
+    for (const T & candidate : smaller(input)) {
+      std::string failure = property(candidate);
+      if (!failure.empty()) {
+        input = candidate;
+        message = failure;
+        shrunk = true;
+        break;
+      }
+    }
+  }
+  return message;
+}
+
+// -------------------------------------------------------------------------
+// Runs each property over the configured number of cases and reports.
+// -------------------------------------------------------------------------
+class Fuzzer {
+public:
+  Fuzzer(int argc, char * argv[], int cases = 300, uint64_t seed = 1)
+    : _cases(cases), _seed(seed), _failures(0) {
+    if (argc > 1) {
+      _cases = std::atoi(argv[1]);
+    }
+    if (argc > 2) {
+      _seed = std::strtoull(argv[2], nullptr, 10);
+    }
+  }
+
+  int cases() const { return _cases; }
+
+  // Check property on cases inputs from generate. Returns false, after
+  // printing the shrunk counterexample, on the first failure.
+  template <typename T>
+  bool check(const std::string & name,
+             const std::function<T(FuzzRng &)> & generate,
+             const std::function<std::string(const T &)> & property,
+             const std::function<std::vector<T>(const T &)> & smaller,
+             const std::function<std::string(const T &)> & describe,
+             int cases = 0) {
+    int count = (cases > 0) ? cases : _cases;
+    for (int c = 0; c < count; c++) {
+      FuzzRng rng(_seed * 1000003 + c);
+      T input = generate(rng);
+      if (property(input).empty()) {
+        continue;
+      }
+      std::string message = fuzz_shrink(input, property, smaller);
+      std::cout << name << ": FAILED on case " << c << " of seed " << _seed << std::endl
+                << "    shrunk input: " << describe(input) << std::endl
+                << "    " << message << std::endl;
+      _failures++;
+      return false;
+    }
+    std::cout << name << ": " << count << " cases passed" << std::endl;
+    return true;
+  }
+
+  // 0 when every property held, 1 otherwise; suitable for main().
+  int finish() const {
+    std::cout << (_failures ? "FUZZING FAILED" : "FUZZING PASSED")
+              << " (seed " << _seed << ")" << std::endl;
+    return _failures ? 1 : 0;
+  }
+
+private:
+  int _cases;
+  uint64_t _seed;
+  int _failures;
+};
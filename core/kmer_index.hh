@@ -0,0 +1,174 @@
+///////////////////////////////////////////////////////////////////////////////
+// kmer_index.hh
+//
+// Inverted index from short residue words (k-mers) to the sequences that
+// contain them, used to shortlist candidates before running a full dynamic
+// programming match against every protein.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "residues.hh"
+
+class KmerIndex {
+public:
+	enum { MIN_K = 2, MAX_K = 4 };
+
+	// Create an empty index over words of k residues, 2 <= k <= 4.
+	explicit KmerIndex(int k = 3)
+		: _k(k) {
+		assert(k >= MIN_K && k <= MAX_K);
+		clear();
+	}
+
+	int k() const {
+		return _k;
+	}
+
+	// Number of sequences indexed so far.
+	size_t size() const {
+		return _sequence_count;
+	}
+
+	void clear() {
+		_sequence_count = 0;
+		_buckets.assign(bucket_count() + 1, 0);
+		_postings.clear();
+		_pending.clear();
+		_built = true;
+	}
+
+	// Add the next sequence; sequences are numbered in the order they are
+	// added, starting from 0. Call build() once all of them are in.
+	void add(const std::string & sequence) {
+		std::vector<uint8_t> codes(sequence.size());
+		encode_residues(sequence.data(), sequence.size(), codes.data());
+		add(codes.data(), codes.size());
+	}
+
+	// Same, for a sequence already turned into residue codes.
+	void add(const uint8_t * codes, size_t length) {
+		std::vector<uint32_t> keys = distinct_kmers(codes, length);
+		for (size_t i = 0; i < keys.size(); i++) {
+			_pending.push_back(Posting(keys[i], _sequence_count));
+		}
+		_sequence_count++;
+		_built = false;
+	}
+
+	// Turn the pending (k-mer, sequence) pairs into the posting lists, kept
+	// in compressed sparse row form: one flat array of uint32 sequence
+	// numbers, and _buckets[key] where the list for key starts in it.
+	// Sequences added after an earlier build() are merged into the
+	// existing lists.
+	void build() {
+		std::vector<Posting> all;
+		all.reserve(_postings.size() + _pending.size());
+		for (uint32_t key = 0; key < bucket_count(); key++) {
+			for (uint32_t p = _buckets[key]; p < _buckets[key + 1]; p++) {
+				all.push_back(Posting(key, _postings[p]));
+			}
+		}
+		all.insert(all.end(), _pending.begin(), _pending.end());
+		std::vector<Posting>().swap(_pending);
+
+		std::vector<uint32_t> counts(bucket_count() + 1, 0);
+		for (size_t i = 0; i < all.size(); i++) {
+			counts[all[i].key + 1]++;
+		}
+		for (size_t key = 0; key < bucket_count(); key++) {
+			counts[key + 1] += counts[key];
+		}
+		_buckets = counts;
+		_postings.assign(all.size(), 0);
+		for (size_t i = 0; i < all.size(); i++) {
+			_postings[counts[all[i].key]++] = all[i].sequence;
+		}
+		_built = true;
+	}
+
+	// Up to top_k sequence numbers ranked by how many distinct k-mers they
+	// share with the query, best first; equal counts keep index order.
+	// Sequences with no k-mer in common are never returned.
+	std::vector<uint32_t> candidates(const std::string & query, size_t top_k) const {
+		assert(_built);
+		std::vector<uint8_t> codes(query.size());
+		encode_residues(query.data(), query.size(), codes.data());
+		std::vector<uint32_t> keys = distinct_kmers(codes.data(), codes.size());
+		std::vector<uint32_t> shared(_sequence_count, 0);
+		std::vector<uint32_t> touched;
+		for (size_t i = 0; i < keys.size(); i++) {
+			for (uint32_t p = _buckets[keys[i]]; p < _buckets[keys[i] + 1]; p++) {
+				uint32_t sequence = _postings[p];
+				if (shared[sequence]++ == 0) {
+					touched.push_back(sequence);
+				}
+			}
+		}
+
+		auto better = [&shared](uint32_t a, uint32_t b) {
+			return (shared[a] != shared[b]) ? (shared[a] > shared[b]) : (a < b);
+		};
+		size_t keep = std::min(top_k, touched.size());
+		std::partial_sort(touched.begin(), touched.begin() + keep, touched.end(), better);
+		touched.resize(keep);
+		return touched;
+	}
+
+	// Memory held by the bucket table and posting lists, in bytes.
+	size_t storage_bytes() const {
+		return (_buckets.capacity() + _postings.capacity()) * sizeof(uint32_t);
+	}
+
+private:
+	struct Posting {
+		Posting(uint32_t k, uint32_t s) : key(k), sequence(s) { }
+		uint32_t key;
+		uint32_t sequence;
+	};
+
+	uint32_t bucket_count() const {
+		return 1u << (RESIDUE_BITS * _k);
+	}
+
+	// Keys of the distinct k-mers of a sequence of residue codes. A k-mer
+	// key is its codes concatenated, 5 bits each; k-mers touching an
+	// unknown residue are skipped.
+	std::vector<uint32_t> distinct_kmers(const uint8_t * codes, size_t length) const {
+		std::vector<uint32_t> keys;
+		if (length < static_cast<size_t>(_k)) {
+			return keys;
+		}
+		const uint32_t mask = bucket_count() - 1;
+		uint32_t key = 0;
+		int valid = 0;
+		keys.reserve(length);
+		for (size_t i = 0; i < length; i++) {
+			uint8_t code = codes[i];
+			key = ((key << RESIDUE_BITS) | code) & mask;
+			valid = (code == RESIDUE_UNKNOWN) ? 0 : valid + 1;
+			if (valid >= _k) {
+				keys.push_back(key);
+			}
+		}
+		std::sort(keys.begin(), keys.end());
+		keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+		return keys;
+	}
+
+	int						_k;
+	uint32_t				_sequence_count;
+	std::vector<uint32_t>	_buckets;
+	std::vector<uint32_t>	_postings;
+	std::vector<Posting>	_pending;
+	bool					_built;
+};
@@ -0,0 +1,106 @@
+///////////////////////////////////////////////////////////////////////////////
+// memory_usage.cc
+//
+// The counting replacements for the global operator new and delete that
+// memory_usage.hh reports on. Link this file into every program that
+// includes the header, once.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cstdlib>
+#include <new>
+
+#include "memory_usage.hh"
+
+#ifndef NO_ALLOCATION_TRACKING
+
+bool allocation_tracking_enabled() {
+  return true;
+}
+
+// -------------------------------------------------------------------------
+// Each block carries its size in a header in front of it, so that delete
+// knows how many bytes go back. The header is as large as the strictest
+// fundamental alignment, which keeps the block as aligned as malloc's.
+// -------------------------------------------------------------------------
+namespace {
+
+const size_t HEADER = alignof(std::max_align_t);
+
+void * allocate(size_t size) {
+  char * block = static_cast<char *>(std::malloc(size + HEADER));
+  if (block == nullptr) {
+    return nullptr;
+  }
+  *reinterpret_cast<size_t *>(block) = size;
+  AllocationCounters & counters = allocation_counters();
+  counters.allocations.fetch_add(1, std::memory_order_relaxed);
+  counters.bytes.fetch_add(size, std::memory_order_relaxed);
+  ThreadAllocationCounters & own = thread_allocation_counters();
+  own.allocations++;
+  own.bytes += size;
+  uint64_t live = counters.live_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+  uint64_t peak = counters.peak_bytes.load(std::memory_order_relaxed);
+  while (live > peak && !counters.peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+  }
+  return block + HEADER;
+}
+
+void release(void * pointer) {
+  if (pointer == nullptr) {
+    return;
+  }
+  char * block = static_cast<char *>(pointer) - HEADER;
+  allocation_counters().live_bytes.fetch_sub(*reinterpret_cast<size_t *>(block),
+                                             std::memory_order_relaxed);
+  std::free(block);
+}
+
+void * allocate_or_throw(size_t size) {
+  void * pointer = allocate(size);
+  while (pointer == nullptr) {
+    std::new_handler handler = std::get_new_handler();
+    if (handler == nullptr) {
+      throw std::bad_alloc();
+    }
+    handler();
+    pointer = allocate(size);
+  }
+  return pointer;
+}
+
+}  // namespace
+
+void * operator new(std::size_t size) {
+  return allocate_or_throw(size);
+}
+
+void * operator new[](std::size_t size) {
+  return allocate_or_throw(size);
+}
+
+void * operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  return allocate(size);
+}
+
+void * operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+  return allocate(size);
+}
+
+void operator delete(void * pointer) noexcept {
+  release(pointer);
+}
+
+void operator delete[](void * pointer) noexcept {
+  release(pointer);
+}
+
+void operator delete(void * pointer, const std::nothrow_t &) noexcept {
+  release(pointer);
+}
+
+void operator delete[](void * pointer, const std::nothrow_t &) noexcept {
+  release(pointer);
+}
+
+#endif
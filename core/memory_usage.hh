@@ -0,0 +1,155 @@
+///////////////////////////////////////////////////////////////////////////////
+// memory_usage.hh
+//
+// Allocation accounting for the experiments. memory_usage.cc replaces the
+// program's global operator new and delete with versions that count
+// every allocation: how many, how many bytes, and the most bytes
+// live at once. The process's peak resident set size comes from
+// getrusage.
+//
+// How to use:
+//
+//    AllocationStats stats;
+//    {
+//      AllocationScope scope(stats);
+//      // code whose allocations are counted
+//    }
+//    cout << stats.allocations << " allocations, peak "
+//         << format_bytes(stats.peak_bytes) << endl;
+//
+// The replacement allocation functions are defined once, in
+// memory_usage.cc, which every program that includes this header links
+// with. Define NO_ALLOCATION_TRACKING to keep the standard allocator; the
+// counts are then reported as unavailable.
+//
+// The counters are shared by all threads, so a scope also counts what
+// other threads allocate while it is open; the calling thread's own share
+// is reported apart, for checks that must not depend on other threads.
+// Scopes do not nest: opening one restarts the peak.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+// Counts since the program started.
+struct AllocationCounters {
+  std::atomic<uint64_t> allocations;
+  std::atomic<uint64_t> bytes;
+  std::atomic<uint64_t> live_bytes;
+  std::atomic<uint64_t> peak_bytes;
+};
+
+inline AllocationCounters & allocation_counters() {
+  // Constant initialized, so safe to use from allocations made before main.
+  static AllocationCounters counters = { {0}, {0}, {0}, {0} };
+  return counters;
+}
+
+// The calling thread's share of the allocation counts.
+struct ThreadAllocationCounters {
+  uint64_t allocations;
+  uint64_t bytes;
+};
+
+inline ThreadAllocationCounters & thread_allocation_counters() {
+  static thread_local ThreadAllocationCounters counters = { 0, 0 };
+  return counters;
+}
+
+#ifdef NO_ALLOCATION_TRACKING
+inline bool allocation_tracking_enabled() {
+  return false;
+}
+#else
+// Defined in memory_usage.cc, next to the allocation functions it reports
+// on, so that a program that forgets to link them fails to link.
+bool allocation_tracking_enabled();
+#endif
+
+// What happened between the opening and closing of an AllocationScope.
+struct AllocationStats {
+  AllocationStats()
+    : available(false), allocations(0), bytes(0), peak_bytes(0),
+      thread_allocations(0), thread_bytes(0) { }
+
+  bool available;
+  uint64_t allocations;   // calls to operator new
+  uint64_t bytes;         // bytes they asked for
+  uint64_t peak_bytes;    // most bytes live at once, above the level at opening
+  uint64_t thread_allocations; // of the allocations, those the scope's thread made
+  uint64_t thread_bytes;
+};
+
+class AllocationScope {
+public:
+  explicit AllocationScope(AllocationStats & stats) : _stats(stats) {
+    AllocationCounters & counters = allocation_counters();
+    _allocations = counters.allocations.load();
+    _bytes = counters.bytes.load();
+    _live = counters.live_bytes.load();
+    counters.peak_bytes.store(_live);
+    _thread_allocations = thread_allocation_counters().allocations;
+    _thread_bytes = thread_allocation_counters().bytes;
+  }
+
+  ~AllocationScope() {
+    AllocationCounters & counters = allocation_counters();
+    _stats.available = allocation_tracking_enabled();
+    _stats.allocations = counters.allocations.load() - _allocations;
+    _stats.bytes = counters.bytes.load() - _bytes;
+    uint64_t peak = counters.peak_bytes.load();
+    _stats.peak_bytes = (peak > _live) ? peak - _live : 0;
+    _stats.thread_allocations = thread_allocation_counters().allocations - _thread_allocations;
+    _stats.thread_bytes = thread_allocation_counters().bytes - _thread_bytes;
+  }
+
+private:
+  AllocationScope(const AllocationScope &);
+  AllocationScope & operator=(const AllocationScope &);
+
+  AllocationStats & _stats;
+  uint64_t _allocations, _bytes, _live;
+  uint64_t _thread_allocations, _thread_bytes;
+};
+
+// Peak resident set size of the process so far, in bytes; 0 where
+// getrusage is not available.
+inline uint64_t peak_rss_bytes() {
+#if defined(__unix__) || defined(__APPLE__)
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+#ifdef __APPLE__
+  return usage.ru_maxrss;
+#else
+  return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#else
+  return 0;
+#endif
+}
+
+// A byte count, printed with a binary unit that suits it.
+inline std::string format_bytes(double bytes) {
+  const char * units[] = { "B", "KiB", "MiB", "GiB", "TiB" };
+  int unit = 0;
+  while (bytes >= 1024 && unit < 4) {
+    bytes /= 1024;
+    unit++;
+  }
+  std::ostringstream out;
+  out << std::setprecision(3) << bytes << " " << units[unit];
+  return out.str();
+}
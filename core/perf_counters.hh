@@ -0,0 +1,205 @@
+///////////////////////////////////////////////////////////////////////////////
+// perf_counters.hh
+//
+// Hardware performance counters for the experiments. Wall-clock time says
+// how long something took but not why; the cycle, instruction, cache-miss
+// and branch-miss counts say whether a loop is waiting on memory or on
+// mispredicted branches.
+//
+// How to use:
+//
+//    PerfCounters counters;
+//    CounterValues values;
+//    {
+//      CounterScope scope(counters, values);
+//      ... code to be measured ...
+//    }
+//    if (values.has(PERF_CACHE_MISSES)) ...
+//
+// The counters come from the Linux perf_event_open system call and count
+// the calling thread in user space only. When a counter cannot be opened -
+// another operating system, a virtual machine without a PMU, or a
+// perf_event_paranoid setting that forbids it - it is simply absent from
+// the values, and the scope costs next to nothing.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+enum PerfCounter {
+  PERF_CYCLES,
+  PERF_INSTRUCTIONS,
+  PERF_CACHE_MISSES,
+  PERF_BRANCH_MISSES,
+  PERF_COUNTER_COUNT
+};
+
+inline const char * perf_counter_name(PerfCounter counter) {
+  static const char * names[PERF_COUNTER_COUNT] = {
+    "cycles", "instructions", "cache misses", "branch misses"
+  };
+  return names[counter];
+}
+
+// Counts read over one measured region. Counts are doubles so that they
+// can be averaged over many calls.
+struct CounterValues {
+  CounterValues() : available(0) {
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+      counts[c] = 0;
+    }
+  }
+
+  bool has(PerfCounter counter) const {
+    return (available >> counter) & 1;
+  }
+
+  // Instructions per cycle, or 0 when either count is missing.
+  double ipc() const {
+    if (!has(PERF_CYCLES) || !has(PERF_INSTRUCTIONS) || counts[PERF_CYCLES] == 0) {
+      return 0;
+    }
+    return counts[PERF_INSTRUCTIONS] / counts[PERF_CYCLES];
+  }
+
+  // The same values with every count divided by divisor.
+  CounterValues per(double divisor) const {
+    CounterValues result(*this);
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+      result.counts[c] /= divisor;
+    }
+    return result;
+  }
+
+  unsigned available;   // one bit per PerfCounter that was counted
+  double counts[PERF_COUNTER_COUNT];
+};
+
+// -------------------------------------------------------------------------
+// One file descriptor per counter, opened disabled for the calling thread.
+// Counters are opened separately rather than as a group, so that a machine
+// that has only some of them still reports those.
+// -------------------------------------------------------------------------
+class PerfCounters {
+public:
+  // With enable false no counter is opened, and every scope reads nothing.
+  explicit PerfCounters(bool enable = true) {
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+      _fds[c] = enable ? open_counter(static_cast<PerfCounter>(c)) : -1;
+    }
+  }
+
+  ~PerfCounters() {
+#ifdef __linux__
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+      if (_fds[c] >= 0) {
+        close(_fds[c]);
+      }
+    }
+#endif
+  }
+
+  PerfCounters(const PerfCounters &) = delete;
+  PerfCounters & operator=(const PerfCounters &) = delete;
+
+  // True when at least one counter could be opened.
+  bool available() const {
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+      if (_fds[c] >= 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void start() {
+#ifdef __linux__
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+      if (_fds[c] >= 0) {
+        ioctl(_fds[c], PERF_EVENT_IOC_RESET, 0);
+        ioctl(_fds[c], PERF_EVENT_IOC_ENABLE, 0);
+      }
+    }
+#endif
+  }
+
+  // Stop counting and read the counts since start(). A counter the kernel
+  // multiplexed with others is scaled up by enabled / running time.
+  CounterValues stop() {
+    CounterValues values;
+#ifdef __linux__
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+      if (_fds[c] >= 0) {
+        ioctl(_fds[c], PERF_EVENT_IOC_DISABLE, 0);
+      }
+    }
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+      uint64_t data[3];   // value, time enabled, time running
+      if (_fds[c] < 0 || read(_fds[c], data, sizeof(data)) != sizeof(data) || data[2] == 0) {
+        continue;
+      }
+      values.counts[c] = static_cast<double>(data[0]) * data[1] / data[2];
+      values.available |= 1u << c;
+    }
+#endif
+    return values;
+  }
+
+private:
+  static int open_counter(PerfCounter counter) {
+#ifdef __linux__
+    static const uint64_t configs[PERF_COUNTER_COUNT] = {
+      PERF_COUNT_HW_CPU_CYCLES,
+      PERF_COUNT_HW_INSTRUCTIONS,
+      PERF_COUNT_HW_CACHE_MISSES,
+      PERF_COUNT_HW_BRANCH_MISSES
+    };
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = configs[counter];
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+#else
+    return -1;
+#endif
+  }
+
+  int _fds[PERF_COUNTER_COUNT];
+};
+
+// -------------------------------------------------------------------------
+// Counts the enclosing block into values.
+// -------------------------------------------------------------------------
+class CounterScope {
+public:
+  CounterScope(PerfCounters & counters, CounterValues & values)
+    : _counters(counters), _values(values) {
+    _counters.start();
+  }
+
+  ~CounterScope() {
+    _values = _counters.stop();
+  }
+
+  CounterScope(const CounterScope &) = delete;
+  CounterScope & operator=(const CounterScope &) = delete;
+
+private:
+  PerfCounters & _counters;
+  CounterValues & _values;
+};
@@ -0,0 +1,177 @@
+///////////////////////////////////////////////////////////////////////////////
+// residues.hh
+//
+// Dense 5-bit codes for amino acid residues, plus a packed sequence type
+// that stores twelve residues in every 64-bit word.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Residue codes follow the row order of blosum62.txt, so that a code can be
+// used directly as a matrix index. The letters BLOSUM62 leaves out (J, O
+// and U) come next. Lower case letters share the code of their upper case
+// letter, and every other character maps to RESIDUE_UNKNOWN.
+const char RESIDUE_ALPHABET[] = "ARNDCQEGHILKMFPSTWYVBZX*JOU";
+
+enum {
+	RESIDUE_BITS = 5,
+	RESIDUE_CODES = 1 << RESIDUE_BITS,
+	RESIDUE_GAP = 23,
+	RESIDUE_UNKNOWN = RESIDUE_CODES - 1
+};
+
+// Character to code translation table, 256 entries.
+const uint8_t * residue_code_table()
+{
+	static const std::vector<uint8_t> table = []() {
+		std::vector<uint8_t> t(256, RESIDUE_UNKNOWN);
+		for (int code = 0; RESIDUE_ALPHABET[code] != '\0'; code++) {
+			unsigned char c = RESIDUE_ALPHABET[code];
+			t[c] = code;
+			if (c >= 'A' && c <= 'Z') {
+				t[c - 'A' + 'a'] = code;
+			}
+		}
+		return t;
+	}();
+	return table.data();
+}
+
+inline uint8_t residue_code(char c)
+{
+	return residue_code_table()[static_cast<unsigned char>(c)];
+}
+
+// Code to character translation; RESIDUE_UNKNOWN decodes as '?'.
+inline char residue_letter(uint8_t code)
+{
+	return (code < sizeof(RESIDUE_ALPHABET) - 1) ? RESIDUE_ALPHABET[code] : '?';
+}
+
+void encode_residues(const char * residues, size_t length, uint8_t * codes)
+{
+	const uint8_t * table = residue_code_table();
+	for (size_t i = 0; i < length; i++) {
+		codes[i] = table[static_cast<unsigned char>(residues[i])];
+	}
+}
+
+// -------------------------------------------------------------------------
+// Packed storage for residue codes. Residue i lives in bits
+// [5 * (i % 12), 5 * (i % 12) + 5) of word i / 12, which keeps every code
+// inside a single word. That costs 5.33 bits per residue instead of 8.
+// -------------------------------------------------------------------------
+class PackedResidues {
+public:
+	enum { PER_WORD = 64 / RESIDUE_BITS };
+
+	PackedResidues() : _length(0) { }
+
+	size_t size() const {
+		return _length;
+	}
+
+	uint8_t operator[](size_t i) const {
+		return (_words[i / PER_WORD] >> (RESIDUE_BITS * (i % PER_WORD))) & RESIDUE_UNKNOWN;
+	}
+
+	void push_back(uint8_t code) {
+		size_t slot = _length % PER_WORD;
+		if (slot == 0) {
+			_words.push_back(0);
+		}
+		_words.back() |= static_cast<uint64_t>(code) << (RESIDUE_BITS * slot);
+		_length++;
+	}
+
+	void append(const char * residues, size_t length) {
+		const uint8_t * table = residue_code_table();
+		_words.reserve((_length + length + PER_WORD - 1) / PER_WORD);
+		for (size_t i = 0; i < length; i++) {
+			push_back(table[static_cast<unsigned char>(residues[i])]);
+		}
+	}
+
+	// Decode codes [first, first + count) into one byte per code.
+	void unpack(size_t first, size_t count, uint8_t * codes) const {
+		size_t word = first / PER_WORD;
+		size_t slot = first % PER_WORD;
+		uint64_t bits = (count > 0) ? _words[word] >> (RESIDUE_BITS * slot) : 0;
+		for (size_t i = 0; i < count; i++) {
+			codes[i] = bits & RESIDUE_UNKNOWN;
+			bits >>= RESIDUE_BITS;
+			if (++slot == PER_WORD && i + 1 < count) {
+				bits = _words[++word];
+				slot = 0;
+			}
+		}
+	}
+
+	void clear() {
+		_words.clear();
+		_length = 0;
+	}
+
+	void shrink_to_fit() {
+		_words.shrink_to_fit();
+	}
+
+	size_t storage_bytes() const {
+		return _words.capacity() * sizeof(uint64_t);
+	}
+
+private:
+	std::vector<uint64_t>	_words;
+	size_t					_length;
+};
+
+// A single protein sequence in packed form.
+class PackedSequence {
+public:
+	PackedSequence() { }
+
+	explicit PackedSequence(const std::string & sequence) {
+		_residues.append(sequence.data(), sequence.size());
+	}
+
+	size_t size() const {
+		return _residues.size();
+	}
+
+	uint8_t operator[](size_t i) const {
+		return _residues[i];
+	}
+
+	void unpack(uint8_t * codes) const {
+		_residues.unpack(0, size(), codes);
+	}
+
+	std::vector<uint8_t> codes() const {
+		std::vector<uint8_t> result(size());
+		unpack(result.data());
+		return result;
+	}
+
+	// Decoded sequence; lower case input comes back in upper case.
+	std::string str() const {
+		std::string result(size(), ' ');
+		for (size_t i = 0; i < size(); i++) {
+			result[i] = residue_letter(_residues[i]);
+		}
+		return result;
+	}
+
+	size_t storage_bytes() const {
+		return _residues.storage_bytes();
+	}
+
+private:
+	PackedResidues _residues;
+};
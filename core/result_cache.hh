@@ -0,0 +1,202 @@
+///////////////////////////////////////////////////////////////////////////////
+// result_cache.hh
+//
+// LRU cache of best-match results, for workloads that repeat the same
+// queries against an unchanged protein database.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Engines whose results may be cached; part of the key.
+enum ResultKind {
+	RESULT_LONGEST_COMMON_SUBSEQUENCE = 1,
+	RESULT_LOCAL_ALIGNMENT = 2
+};
+
+// What a cached lookup is keyed on. matrix identifies the scoring matrix
+// (0 when the engine has none). database and version are the id and
+// version of the SequenceDatabase the query was run against: the id never
+// changes, and the version is new every time its contents are. kind is a
+// ResultKind.
+struct ResultCacheKey {
+	std::string		query;
+	int				kind;
+	uint64_t		matrix;
+	uint64_t		database;
+	uint64_t		version;
+
+	bool operator==(const ResultCacheKey & that) const {
+		return query == that.query && kind == that.kind && matrix == that.matrix &&
+			database == that.database && version == that.version;
+	}
+};
+
+struct ResultCacheKeyHash {
+	size_t operator()(const ResultCacheKey & key) const {
+		size_t h = std::hash<std::string>()(key.query);
+		h = h * 31 + key.kind;
+		h = h * 31 + std::hash<uint64_t>()(key.matrix);
+		h = h * 31 + std::hash<uint64_t>()(key.database);
+		return h * 31 + std::hash<uint64_t>()(key.version);
+	}
+};
+
+// A cached best match: the winning protein's position in the database and,
+// for alignments, the two aligned strings.
+struct CachedMatch {
+	size_t			protein;
+	std::string		matchString1;
+	std::string		matchString2;
+};
+
+class ResultCache {
+public:
+	enum { ENTRY_OVERHEAD = 128 };
+
+	// memory_budget is the most bytes of keys and results to keep; the
+	// least recently used entries are dropped to stay under it.
+	explicit ResultCache(size_t memory_budget = 16 << 20)
+		: _budget(memory_budget), _bytes(0), _hits(0), _misses(0),
+		  _evictions(0), _invalidations(0) { }
+
+	// Look up a result. On a hit the entry becomes the most recently used.
+	bool find(const ResultCacheKey & key, CachedMatch & result) {
+		std::lock_guard<std::mutex> lock(_mutex);
+		check_version(key);
+		auto found = _index.find(key);
+		if (found == _index.end()) {
+			_misses++;
+			return false;
+		}
+		_entries.splice(_entries.begin(), _entries, found->second);
+		result = found->second->second;
+		_hits++;
+		return true;
+	}
+
+	void insert(const ResultCacheKey & key, const CachedMatch & result) {
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (!check_version(key)) {
+			return;
+		}
+		auto found = _index.find(key);
+		if (found != _index.end()) {
+			_bytes -= entry_bytes(found->second->first, found->second->second);
+			_entries.erase(found->second);
+			_index.erase(found);
+		}
+		size_t bytes = entry_bytes(key, result);
+		if (bytes > _budget) {
+			return;
+		}
+		_entries.push_front(Entry(key, result));
+		_index[key] = _entries.begin();
+		_bytes += bytes;
+		while (_bytes > _budget) {
+			const Entry & oldest = _entries.back();
+			_bytes -= entry_bytes(oldest.first, oldest.second);
+			_index.erase(oldest.first);
+			_entries.pop_back();
+			_evictions++;
+		}
+	}
+
+	void clear() {
+		std::lock_guard<std::mutex> lock(_mutex);
+		drop_all();
+	}
+
+	// The statistics are read under the lock, as find and insert change
+	// them from any thread.
+	size_t size() const {
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _entries.size();
+	}
+	size_t bytes() const {
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _bytes;
+	}
+	size_t memory_budget() const { return _budget; }
+	uint64_t hits() const {
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _hits;
+	}
+	uint64_t misses() const {
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _misses;
+	}
+	uint64_t evictions() const {
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _evictions;
+	}
+	uint64_t invalidations() const {
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _invalidations;
+	}
+
+private:
+	typedef std::pair<ResultCacheKey, CachedMatch> Entry;
+
+	static size_t entry_bytes(const ResultCacheKey & key, const CachedMatch & result) {
+		return ENTRY_OVERHEAD + key.query.size() +
+			result.matchString1.size() + result.matchString2.size();
+	}
+
+	// A newer version of key's database means its contents have changed
+	// since the last access, so that database's entries are dropped; the
+	// entries of other databases stay. Returns false when key is for an
+	// older version than one already seen, whose results must not be kept.
+	bool check_version(const ResultCacheKey & key) {
+		auto seen = _versions.find(key.database);
+		if (seen == _versions.end()) {
+			_versions[key.database] = key.version;
+			return true;
+		}
+		if (key.version < seen->second) {
+			return false;
+		}
+		if (key.version > seen->second) {
+			seen->second = key.version;
+			for (auto entry = _entries.begin(); entry != _entries.end(); ) {
+				if (entry->first.database == key.database) {
+					_bytes -= entry_bytes(entry->first, entry->second);
+					_index.erase(entry->first);
+					entry = _entries.erase(entry);
+				}
+				else {
+					++entry;
+				}
+			}
+			_invalidations++;
+		}
+		return true;
+	}
+
+	void drop_all() {
+		_entries.clear();
+		_index.clear();
+		_versions.clear();
+		_bytes = 0;
+	}
+
+	mutable std::mutex	_mutex;
+	std::list<Entry>	_entries;
+	std::unordered_map<ResultCacheKey, std::list<Entry>::iterator, ResultCacheKeyHash> _index;
+	std::unordered_map<uint64_t, uint64_t> _versions;	// newest seen, by database id
+	size_t			_budget;
+	size_t			_bytes;
+	uint64_t		_hits;
+	uint64_t		_misses;
+	uint64_t		_evictions;
+	uint64_t		_invalidations;
+};
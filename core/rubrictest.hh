@@ -0,0 +1,395 @@
+///////////////////////////////////////////////////////////////////////////////
+// rubrictest.hh
+//
+// minimalist C++ unit testing for grading rubric-based programming assignments
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <ctime>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// As an end user, you really only need to pay attention to the
+// Rubric class and TEST_... macros, below.
+
+// A test throws TestFailureException to signal when a test fails.
+class TestFailureException {
+public:
+  // line is source code line, probably from __LINE__;
+  // file is source code filename, probably from __FILE__; and
+  // message is a brief decription of the test case.
+  TestFailureException(int line,
+		       const std::string file,
+		       const std::string& message)
+    : _line(line),
+      _file(file),
+      _message(message) { }
+
+  int line() const { return _line; }
+  const std::string& file() const { return _file; }
+  const std::string& message() const { return _message; }
+
+private:
+  int _line;
+  const std::string _file, _message;
+};
+
+// A RubricCriterion is one criterion (row) in a rubric. It carries a
+// number of points, and has a unit test function. When the function
+// is run and all tests pass (no exceptions), the student earns the
+// full points for the criterion. Otherwise (some test fails and
+// throws an exception), the studen earns zero points for this
+// criterion.
+//
+// A criterion may also be marked concurrent, meaning its test shares no
+// mutable state with any other test and may run on another thread at the
+// same time as them, and may be given a time budget, which it fails when
+// its test takes longer. A criterion that measures the process, such as
+// its timings or allocations, may instead be marked exclusive: nothing
+// else runs while it does. These are set on the value Rubric::criterion
+// returns:
+//
+//   rubric.criterion("big input", 2, [&]() { ... }).concurrent().time_budget(5);
+//   rubric.criterion("allocations", 1, [&]() { ... }).exclusive();
+class RubricCriterion {
+public:
+  // name is a human-readable name;
+  // points is the positive number of points awarded for this criterion; and
+  // test is a function that takes no arguments and returns void, and
+  // should perform a number of unit tests using the TEST_... macros
+  // below.
+  RubricCriterion(const std::string& name,
+		  int points,
+		  std::function<void()> test)
+    : _name(name),
+      _points(points),
+      _test(test),
+      _concurrent(false),
+      _exclusive(false),
+      _time_budget(0)
+  { assert(points > 0); }
+
+  // Allow this criterion to run alongside the others.
+  RubricCriterion& concurrent() {
+    assert(!_exclusive);
+    _concurrent = true;
+    return *this;
+  }
+
+  // Run this criterion alone: concurrent criteria already running are
+  // waited for, and no more start until it is done.
+  RubricCriterion& exclusive() {
+    assert(!_concurrent);
+    _exclusive = true;
+    return *this;
+  }
+
+  // Fail this criterion when its test uses more than seconds of CPU
+  // time. CPU time of the test's own thread is what counts, so that the
+  // verdict does not depend on what else runs at the same time; work the
+  // test hands to other threads is not counted.
+  RubricCriterion& time_budget(double seconds) {
+    assert(seconds > 0);
+    _time_budget = seconds;
+    return *this;
+  }
+
+  // Accessors.
+  const std::string& name() const { return _name; }
+  int points() const { return _points; }
+  const std::function<void()>& test() const { return _test; }
+  bool is_concurrent() const { return _concurrent; }
+  bool is_exclusive() const { return _exclusive; }
+  double budget() const { return _time_budget; }
+  
+private:
+  std::string _name;
+  int _points;
+  std::function<void()> _test;
+  bool _concurrent;
+  bool _exclusive;
+  double _time_budget;  // seconds of CPU time, or 0 for none
+};
+
+// A rubric represents a mult-critera grading scheme. It collects
+// several RubricCriterion objects.
+class Rubric {
+public:
+  // Create an empty rubric with no criteria, which reports to out.
+  Rubric(std::ostream& out = std::cout) : _out(out) { }
+
+  // Add a criterion with the given name, points, and test function.
+  // Returns the criterion, to mark it concurrent or exclusive or give it
+  // a time budget; the reference is good until the next criterion is
+  // added.
+  RubricCriterion& criterion(const std::string& name,
+			     int points,
+			     std::function<void()> test) {
+    _criteria.push_back(RubricCriterion(name, points, test));
+    return _criteria.back();
+  }
+
+  // Worker threads run() uses by default: the RUBRIC_WORKERS environment
+  // variable when set, otherwise one per hardware thread.
+  static unsigned default_workers() {
+    const char* workers = std::getenv("RUBRIC_WORKERS");
+    if (workers != nullptr && std::atoi(workers) > 0) {
+      return std::atoi(workers);
+    }
+    return std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  // The main event: run all the tests, score all the criteria, and
+  // print out the results, including total score. Returns 0 when all
+  // tests pass, or 1 otherwise; this return value is suitable for the
+  // return value of main() in a unit-test program.
+  //
+  // The calling thread runs the criteria in order. With more than one
+  // worker, workers - 1 more threads take concurrent criteria from
+  // the same list, except while the calling thread runs an exclusive
+  // one; results are still printed in order, each as soon as it and all
+  // those before it are done.
+  int run(unsigned workers = 1) {
+
+    assert(workers > 0);
+    _results.clear();
+    _results.resize(_criteria.size());
+    _claimed.reset(new std::atomic<bool>[_criteria.size()]);
+    for (size_t i = 0; i < _criteria.size(); i++) {
+      _claimed[i] = false;
+    }
+    _printed = 0;
+    _exclusive_running = false;
+    _helpers_running = 0;
+
+    std::vector<std::thread> helpers;
+    for (unsigned w = 1; w < workers; w++) {
+      helpers.push_back(std::thread([this]() {
+	for (size_t i = 0; i < _criteria.size(); i++) {
+	  if (_criteria[i].is_concurrent()) {
+	    run_on_helper(i);
+	  }
+	}
+      }));
+    }
+    for (size_t i = 0; i < _criteria.size(); i++) {
+      if (_criteria[i].is_exclusive()) {
+	run_exclusive(i);
+      } else {
+	claim_and_run(i);
+      }
+    }
+    for (auto& helper : helpers) {
+      helper.join();
+    }
+
+    int earned_points(0), total_points(0);
+    bool all_passed(true);
+    for (size_t i = 0; i < _criteria.size(); i++) {
+      if (_results[i].passed) {
+	earned_points += _criteria[i].points();
+      } else {
+	all_passed = false;
+      }
+      total_points += _criteria[i].points();
+    }
+
+    // print summary score
+    _out << "TOTAL SCORE = "
+	 << earned_points << " / " << total_points
+	 << std::endl
+	 << std::endl;
+
+    if (all_passed) {
+      return 0;
+    } else {
+      return 1;
+    }
+  }
+
+  // Seconds of wall-clock time the criterion at index took in the last
+  // run().
+  double seconds(size_t index) const { return _results[index].seconds; }
+
+private:
+  struct Result {
+    Result() : done(false), passed(false), line(0), seconds(0) { }
+
+    bool done, passed;
+    int line;
+    std::string file, message;
+    double seconds;
+  };
+
+  // CPU time used so far by the calling thread.
+  static double thread_cpu_seconds() {
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+  }
+
+  // A helper waits out any exclusive criterion before taking index.
+  void run_on_helper(size_t index) {
+    {
+      std::unique_lock<std::mutex> lock(_gate_mutex);
+      _gate.wait(lock, [this]() { return !_exclusive_running; });
+      _helpers_running++;
+    }
+    claim_and_run(index);
+    {
+      std::lock_guard<std::mutex> lock(_gate_mutex);
+      _helpers_running--;
+    }
+    _gate.notify_all();
+  }
+
+  // Stop the helpers taking criteria, wait for those running, then run
+  // index alone.
+  void run_exclusive(size_t index) {
+    {
+      std::unique_lock<std::mutex> lock(_gate_mutex);
+      _exclusive_running = true;
+      _gate.wait(lock, [this]() { return _helpers_running == 0; });
+    }
+    claim_and_run(index);
+    {
+      std::lock_guard<std::mutex> lock(_gate_mutex);
+      _exclusive_running = false;
+    }
+    _gate.notify_all();
+  }
+
+  void claim_and_run(size_t index) {
+    if (_claimed[index].exchange(true)) {
+      return;
+    }
+    const RubricCriterion& criterion = _criteria[index];
+    Result result;
+    auto start = std::chrono::steady_clock::now();
+    double cpu_start = thread_cpu_seconds();
+    try {
+
+      // run this criterion's test function
+      criterion.test()();
+
+      // if that function call threw an exception, we never reach these lines
+      double cpu = thread_cpu_seconds() - cpu_start;
+      if (criterion.budget() > 0 && cpu > criterion.budget()) {
+	std::ostringstream message;
+	message << "over time budget, " << cpu << " s of CPU > "
+		<< criterion.budget() << " s";
+	throw TestFailureException(__LINE__, __FILE__, message.str());
+      }
+      result.passed = true;
+
+    } catch (TestFailureException e) {
+
+      // test function threw an exception; test failed
+      result.line = e.line();
+      result.file = e.file();
+      result.message = e.message();
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.done = true;
+
+    std::lock_guard<std::mutex> lock(_print_mutex);
+    _results[index] = result;
+    while (_printed < _results.size() && _results[_printed].done) {
+      print(_criteria[_printed], _results[_printed]);
+      _printed++;
+    }
+  }
+
+  void print(const RubricCriterion& criterion, const Result& result) {
+    _out << criterion.name() << ": ";
+    if (result.passed) {
+      _out << "passed, score "
+	   <<  criterion.points() << "/" << criterion.points();
+    } else {
+      _out << std::endl
+	   << "    TEST FAILED: " << std::endl
+	   << "    line " << result.line
+	   << " of file " << result.file
+	   << ", message: " << result.message
+	   << std::endl
+	   << "    score 0/" << criterion.points();
+    }
+    std::ostringstream seconds;
+    seconds << std::fixed << std::setprecision(3) << result.seconds;
+    _out << " (" << seconds.str() << " s)" << std::endl;
+  }
+
+  std::ostream& _out;
+  std::vector<RubricCriterion> _criteria;
+  std::vector<Result> _results;
+  std::unique_ptr<std::atomic<bool>[]> _claimed;
+  size_t _printed;
+  std::mutex _print_mutex;
+  std::mutex _gate_mutex;           // guards the two below
+  std::condition_variable _gate;
+  bool _exclusive_running;
+  unsigned _helpers_running;
+};
+
+// Test macros. The test function passed to Rubric::criterion(...)
+// should invoke these macros to test whether the student code is
+// working. Each macro throws a TestFailureException when a test
+// fails.
+
+// Always signal that a test failed. This macro is intended to be used
+// by the other macros below, and can also be used when the test
+// function reaches a statement that should be unreachable in correct
+// code.
+#define TEST_FAIL(message) \
+  throw TestFailureException(__LINE__, __FILE__, std::string(message))
+
+// Expects the expression (expr) to be false.
+#define TEST_FALSE(message, expr) \
+  { if (expr) { TEST_FAIL(message); } }
+
+// Expects the expression (expr) to be true.
+#define TEST_TRUE(message, expr) \
+  TEST_FALSE(message, ! (expr) )
+
+// Expects (x) == (y).
+#define TEST_EQUAL(message, x, y) \
+  TEST_TRUE(message, (x) == (y))
+
+// Expects (x) != (y).
+#define TEST_NOT_EQUAL(message, x, y) \
+  TEST_TRUE(message, (x) != (y))
+
+// Expects (x) > (y).
+#define TEST_GT(message, x, y) \
+  TEST_TRUE(message, (x) > (y))
+
+// Expects (x) >= (y).
+#define TEST_GE(message, x, y) \
+  TEST_TRUE(message, (x) >= (y))
+
+// Expects (x) < (y).
+#define TEST_LT(message, x, y) \
+  TEST_TRUE(message, (x) < (y))
+
+// Expects (x) <= (y).
+#define TEST_LE(message, x, y) \
+  TEST_TRUE(message, (x) <= (y))
+
+///////////////////////////////////////////////////////////////////////////////
+// rubrictest.hh
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,284 @@
+///////////////////////////////////////////////////////////////////////////////
+// sequence_database.hh
+//
+// Protein records and the database that holds them, shared by the longest
+// common subsequence engines of project 3 and the alignment engines of
+// project 4.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "fasta.hh"
+#include "kmer_index.hh"
+#include "residues.hh"
+
+// Simple structure for a single protein
+struct Protein {
+	Protein() {
+		description = "";
+		sequence = "";
+	}
+	Protein(std::string desc, std::string seq) {
+		description = desc;
+		sequence = seq;
+	}
+	std::string		description;
+	std::string 	sequence;
+};
+
+// Alias for a vector of shared pointers to Protein objects.
+typedef std::vector<std::shared_ptr<Protein>> ProteinVector;
+
+
+// -------------------------------------------------------------------------
+// Load all the proteins from a standard FASTA format file, for the engines
+// that take a ProteinVector. Sequences may be split over several lines. The
+// file is parsed into a SequenceArena first, then each record is copied out
+// into its own Protein; SequenceDatabase::load keeps the arena instead.
+// Returns false on I/O error.
+// -------------------------------------------------------------------------
+bool load_proteins(ProteinVector & proteins, const std::string& path)
+{
+	proteins.clear();
+	SequenceArena arena;
+	if (!load_proteins(arena, path)) {
+		std::cout << "Failed to open [" << path << "]" << std::endl;
+		return false;
+	}
+
+	proteins.reserve(arena.size());
+	for (size_t i = 0; i < arena.size(); i++) {
+		proteins.push_back(std::shared_ptr<Protein>(new Protein(arena.description(i),
+																arena.sequence(i))));
+	}
+
+	return true;
+}
+
+// -------------------------------------------------------------------------
+// Save all the proteins to a FASTA file, one line per sequence, in a form
+// load_proteins reads back unchanged.
+// Returns false on I/O error.
+// -------------------------------------------------------------------------
+bool save_proteins(const ProteinVector & proteins, const std::string& path)
+{
+	std::ofstream ofs(path.c_str(), std::ios::binary);
+	if (!ofs.is_open() || !ofs.good()) {
+		std::cout << "Failed to open [" << path << "]" << std::endl;
+		return false;
+	}
+
+	for (size_t i = 0; i < proteins.size(); i++) {
+		ofs << '>' << proteins[i]->description << '\n'
+			<< proteins[i]->sequence << '\n';
+	}
+
+	ofs.close();
+	return ofs.good();
+}
+
+// -------------------------------------------------------------------------
+// Index every protein by its k-mers; protein i of the vector becomes
+// sequence i of the index.
+// -------------------------------------------------------------------------
+void build_kmer_index(KmerIndex & index, const ProteinVector & proteins)
+{
+	index.clear();
+	for (size_t i = 0; i < proteins.size(); i++) {
+		index.add(proteins[i]->sequence);
+	}
+	index.build();
+}
+
+// Stamps for SequenceDatabase ids and versions, unique over the process and
+// increasing, so that a later version always compares greater.
+uint64_t next_database_stamp()
+{
+	static std::atomic<uint64_t> stamp(0);
+	return ++stamp;
+}
+
+// -------------------------------------------------------------------------
+// A protein database together with the search structures derived from it.
+// The records stay in the SequenceArena they were loaded into; protein i is
+// handed out by position, as its description, sequence or residue codes,
+// and only becomes a Protein object when asked for one. The arena keeps the
+// characters exactly as loaded, for the engines that compare characters
+// and for anything handed back out, and next to them the packed 5-bit codes
+// (see SequenceArena::pack) that the scoring engines decode into their own
+// buffers. The k-mer indexes are built on first use and then shared by
+// every engine that searches the database, instead of each caller indexing
+// the proteins again.
+//
+// Every database has an id of its own and a version that load() and
+// changed() renew, which together key the results a ResultCache holds for
+// it; nothing that happens to another database or a ProteinVector touches
+// them.
+//
+// The indexes are built lazily and without locking: ask for them once
+// before sharing the database between threads.
+// -------------------------------------------------------------------------
+class SequenceDatabase {
+public:
+	SequenceDatabase() : _id(next_database_stamp()) {
+		changed();
+	}
+
+	// Copy the proteins into the arena, in order; one with an empty
+	// sequence is kept, so that protein i of the vector is protein i of the
+	// database.
+	explicit SequenceDatabase(const ProteinVector & proteins) : _id(next_database_stamp()) {
+		for (size_t i = 0; i < proteins.size(); i++) {
+			_arena.add(proteins[i]->description, proteins[i]->sequence);
+		}
+		_arena.shrink_to_fit();
+		_arena.pack(true);
+		changed();
+	}
+
+	// Replace the contents with the proteins of a FASTA file.
+	// Returns false on I/O error.
+	bool load(const std::string & path) {
+		bool loaded = load_proteins(_arena, path);
+		if (!loaded) {
+			std::cout << "Failed to open [" << path << "]" << std::endl;
+		}
+		_arena.pack(true);
+		changed();
+		return loaded;
+	}
+
+	// Write the proteins as load_proteins(ProteinVector &) expects them,
+	// one line per sequence. Returns false on I/O error.
+	bool save(const std::string & path) const {
+		std::ofstream ofs(path.c_str(), std::ios::binary);
+		if (!ofs.is_open() || !ofs.good()) {
+			std::cout << "Failed to open [" << path << "]" << std::endl;
+			return false;
+		}
+		for (size_t i = 0; i < size(); i++) {
+			ofs << '>' << description(i) << '\n' << sequence(i) << '\n';
+		}
+		ofs.close();
+		return ofs.good();
+	}
+
+	size_t size() const {
+		return _arena.size();
+	}
+
+	bool empty() const {
+		return _arena.empty();
+	}
+
+	std::string description(size_t i) const {
+		return _arena.description(i);
+	}
+
+	std::string sequence(size_t i) const {
+		return _arena.sequence(i);
+	}
+
+	// The characters of protein i as loaded, length(i) of them.
+	const char * sequence_data(size_t i) const {
+		return _arena.sequence_data(i);
+	}
+
+	size_t length(size_t i) const {
+		return _arena.sequence_length(i);
+	}
+
+	// Protein i as a Protein of its own, for returning a search result.
+	std::shared_ptr<Protein> protein(size_t i) const {
+		return std::shared_ptr<Protein>(new Protein(description(i), sequence(i)));
+	}
+
+	std::shared_ptr<Protein> operator[](size_t i) const {
+		return protein(i);
+	}
+
+	// Every protein copied out of the arena, for the engines that only
+	// take a ProteinVector. The database itself never holds one.
+	ProteinVector to_protein_vector() const {
+		ProteinVector proteins;
+		proteins.reserve(size());
+		for (size_t i = 0; i < size(); i++) {
+			proteins.push_back(protein(i));
+		}
+		return proteins;
+	}
+
+	// Residue codes of protein i (see residues.hh), length(i) of them,
+	// decoded from the arena into codes.
+	void codes(size_t i, uint8_t * codes) const {
+		_arena.unpack_codes(i, codes);
+	}
+
+	// Position of protein i's first residue among the residues of all the
+	// proteins, which lie back to back in database order.
+	size_t offset(size_t i) const {
+		return _arena.offset(i);
+	}
+
+	size_t residue_count() const {
+		return _arena.residue_count();
+	}
+
+	// Bytes the residues take, as characters and packed codes together.
+	size_t residue_bytes() const {
+		return _arena.residue_bytes();
+	}
+
+	// k-mer index over every protein, built on the first call for each k;
+	// protein i is sequence i of the index.
+	const KmerIndex & kmer_index(int k = 3) {
+		std::unique_ptr<KmerIndex> & index = _indexes[k];
+		if (!index) {
+			index.reset(new KmerIndex(k));
+			std::vector<uint8_t> buffer;
+			for (size_t i = 0; i < size(); i++) {
+				buffer.resize(length(i));
+				codes(i, buffer.data());
+				index->add(buffer.data(), buffer.size());
+			}
+			index->build();
+		}
+		return *index;
+	}
+
+	// Identifies this database for as long as it exists.
+	uint64_t id() const {
+		return _id;
+	}
+
+	// Renewed by every change of contents.
+	uint64_t version() const {
+		return _version;
+	}
+
+	// Drop the k-mer indexes; they are rebuilt on next use. Also renews the
+	// version, so results cached for the old contents no longer match.
+	void changed() {
+		_indexes.clear();
+		_version = next_database_stamp();
+	}
+
+private:
+	uint64_t									_id;
+	uint64_t									_version;
+	SequenceArena								_arena;
+	std::map<int, std::unique_ptr<KmerIndex>>	_indexes;
+};
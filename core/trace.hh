@@ -0,0 +1,214 @@
+///////////////////////////////////////////////////////////////////////////////
+// trace.hh
+//
+// Scoped tracing of the hot paths, for seeing where a whole run spends its
+// time rather than timing one function at a time.
+//
+// How to use:
+//
+//    void fill() {
+//      TRACE_SCOPE("dp fill");
+//      ...
+//    }
+//
+// TRACE_SCOPE compiles to nothing unless ENABLE_TRACE is defined, e.g.
+// with `make trace`. When it is, each scope records its name, start and
+// duration into a ring buffer owned by the current thread. Recording takes
+// no lock: only the owning thread writes its buffer, and it publishes each
+// event with a release store of the buffer's head. A full buffer
+// overwrites its oldest events.
+//
+// At exit the events of every thread are written to the file named by
+// the TRACE_FILE environment variable, or trace.json, in the Chrome
+// trace-event format; load it in chrome://tracing or ui.perfetto.dev.
+// trace_write_json() writes the same thing on demand.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#ifdef ENABLE_TRACE
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#endif
+
+// One finished scope. name must be a string literal, or otherwise outlive
+// the export.
+struct TraceEvent {
+  const char * name;
+  uint64_t start;      // nanoseconds since the first traced scope
+  uint64_t duration;   // nanoseconds
+  unsigned thread;     // order in which threads first traced
+};
+
+// -------------------------------------------------------------------------
+// A single-writer ring of events. The owning thread records; any thread
+// may take a snapshot, which sees every event published before it.
+// -------------------------------------------------------------------------
+class TraceBuffer {
+public:
+  static const size_t CAPACITY = 1 << 16;
+
+  explicit TraceBuffer(unsigned thread)
+    : _events(CAPACITY), _head(0), _thread(thread) { }
+
+  void record(const char * name, uint64_t start, uint64_t duration) {
+    uint64_t head = _head.load(std::memory_order_relaxed);
+    TraceEvent & event = _events[head % CAPACITY];
+    event.name = name;
+    event.start = start;
+    event.duration = duration;
+    event.thread = _thread;
+    _head.store(head + 1, std::memory_order_release);
+  }
+
+  // The most recent events, oldest first. A snapshot taken while the
+  // owner is still recording may see a slot being overwritten; export
+  // after the traced work is done.
+  std::vector<TraceEvent> snapshot() const {
+    uint64_t head = _head.load(std::memory_order_acquire);
+    uint64_t first = (head > CAPACITY) ? head - CAPACITY : 0;
+    std::vector<TraceEvent> events;
+    events.reserve(head - first);
+    for (uint64_t i = first; i < head; i++) {
+      events.push_back(_events[i % CAPACITY]);
+    }
+    return events;
+  }
+
+  void clear() {
+    _head.store(0, std::memory_order_release);
+  }
+
+private:
+  std::vector<TraceEvent> _events;
+  std::atomic<uint64_t> _head;
+  unsigned _thread;
+};
+
+inline void trace_write_json(std::ostream & out);
+
+// -------------------------------------------------------------------------
+// Every thread's buffer, and the clock they share. The mutex is taken only
+// when a thread traces for the first time and when exporting.
+// -------------------------------------------------------------------------
+class TraceRegistry {
+public:
+  static TraceRegistry & instance() {
+    static TraceRegistry registry;
+    return registry;
+  }
+
+  ~TraceRegistry() {
+#ifdef ENABLE_TRACE
+    const char * path = std::getenv("TRACE_FILE");
+    std::ofstream out(path ? path : "trace.json");
+    if (out) {
+      trace_write_json(out);
+    }
+#endif
+  }
+
+  // The calling thread's buffer, registered on first use. The registry
+  // shares ownership, so the events outlive the thread.
+  TraceBuffer & for_thread() {
+    thread_local std::shared_ptr<TraceBuffer> buffer;
+    if (!buffer) {
+      std::lock_guard<std::mutex> lock(_mutex);
+      buffer = std::make_shared<TraceBuffer>(_buffers.size());
+      _buffers.push_back(buffer);
+    }
+    return *buffer;
+  }
+
+  uint64_t now() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - _epoch).count();
+  }
+
+  std::vector<TraceEvent> events() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::vector<TraceEvent> all;
+    for (const auto & buffer : _buffers) {
+      std::vector<TraceEvent> events = buffer->snapshot();
+      all.insert(all.end(), events.begin(), events.end());
+    }
+    return all;
+  }
+
+  void clear() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (const auto & buffer : _buffers) {
+      buffer->clear();
+    }
+  }
+
+private:
+  TraceRegistry() : _epoch(std::chrono::steady_clock::now()) { }
+
+  std::mutex _mutex;
+  std::vector<std::shared_ptr<TraceBuffer>> _buffers;
+  std::chrono::steady_clock::time_point _epoch;
+};
+
+// -------------------------------------------------------------------------
+// Records the enclosing block as one event when it ends.
+// -------------------------------------------------------------------------
+class TraceScope {
+public:
+  explicit TraceScope(const char * name)
+    : _name(name), _start(TraceRegistry::instance().now()) { }
+
+  ~TraceScope() {
+    TraceRegistry & registry = TraceRegistry::instance();
+    registry.for_thread().record(_name, _start, registry.now() - _start);
+  }
+
+  TraceScope(const TraceScope &) = delete;
+  TraceScope & operator=(const TraceScope &) = delete;
+
+private:
+  const char * _name;
+  uint64_t _start;
+};
+
+inline std::vector<TraceEvent> trace_events() {
+  return TraceRegistry::instance().events();
+}
+
+inline void trace_clear() {
+  TraceRegistry::instance().clear();
+}
+
+// -------------------------------------------------------------------------
+// Every recorded event as complete ("X") events of the Chrome trace-event
+// format, which counts in microseconds.
+// -------------------------------------------------------------------------
+inline void trace_write_json(std::ostream & out) {
+  std::vector<TraceEvent> events = trace_events();
+  out << "{\"traceEvents\":[";
+  for (size_t i = 0; i < events.size(); i++) {
+    const TraceEvent & event = events[i];
+    out << (i ? ",\n" : "\n")
+        << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1"
+        << ",\"tid\":" << event.thread
+        << ",\"ts\":" << event.start / 1000 << "." << (event.start % 1000) / 100
+        << ",\"dur\":" << event.duration / 1000 << "." << (event.duration % 1000) / 100
+        << "}";
+  }
+  out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}